@@ -0,0 +1,255 @@
+#include "CAmbientOcclusion.h"
+#include "CObjectManager.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+
+AOQuality CAmbientOcclusion::m_quality = AOQuality::High;
+GLuint CAmbientOcclusion::m_depth = NULL;
+GLuint CAmbientOcclusion::m_depthFramebuffer = NULL;
+GLuint CAmbientOcclusion::m_targets[2] = { NULL, NULL };
+GLuint CAmbientOcclusion::m_framebuffers[2] = { NULL, NULL };
+GLuint CAmbientOcclusion::m_emptyVertexArray = NULL;
+GLuint CAmbientOcclusion::m_queries[QUERY_FRAMES][PASS_COUNT];
+bool CAmbientOcclusion::m_queryIssued[QUERY_FRAMES][PASS_COUNT];
+int CAmbientOcclusion::m_queryFrame = 0;
+std::vector<CShape*> CAmbientOcclusion::m_shapes;
+AOStats CAmbientOcclusion::m_stats;
+
+/// <summary>
+/// Off leaves the result at full visibility, so the lit shaders don't need a variant without it
+/// </summary>
+/// <param name="_quality"></param>
+void CAmbientOcclusion::SetQuality(AOQuality _quality)
+{
+	m_quality = _quality;
+
+	if (m_quality == AOQuality::Off && m_targets[0] != NULL) {
+		ClearResult();
+		m_stats = AOStats();
+	}
+}
+
+/// <summary>
+/// Draw the opaque shapes' depth at half resolution, work out the occlusion from it, and blur it without crossing edges.
+/// Must be called before the lit shapes are drawn (and after the frustum is set), changes the framebuffer and viewport while drawing
+/// </summary>
+/// <param name="_camera"></param>
+void CAmbientOcclusion::Render(CCamera* _camera)
+{
+	if (m_depth == NULL) CreateTargets();
+
+	CGLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, m_targets[0]);
+
+	ReadTimers();
+
+	if (m_quality == AOQuality::Off) return;
+
+	bool blend = CGLState::IsEnabled(GL_BLEND);
+	CGLState::Disable(GL_BLEND);
+
+	_camera->UpdatePerspective();
+	glViewport(0, 0, utils::windowWidth / SCALE_DIVISOR, utils::windowHeight / SCALE_DIVISOR);
+
+	BeginTimer(0);
+	DrawDepth(_camera->GetProjectionViewMat());
+	EndTimer(0);
+
+	//The full screen passes cover every texel, nothing to test against
+	bool depthTest = CGLState::IsEnabled(GL_DEPTH_TEST);
+	CGLState::Disable(GL_DEPTH_TEST);
+	CGLState::BindVertexArray(m_emptyVertexArray);
+	CGLState::BindTexture(DEPTH_UNIT, GL_TEXTURE_2D, m_depth);
+
+	BeginTimer(1);
+	DrawOcclusion(_camera);
+	EndTimer(1);
+
+	BeginTimer(2);
+	DrawBlur();
+	EndTimer(2);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, utils::windowWidth, utils::windowHeight);
+
+	if (depthTest) CGLState::Enable(GL_DEPTH_TEST);
+	if (blend) CGLState::Enable(GL_BLEND);
+
+	m_queryFrame = (m_queryFrame + 1) % QUERY_FRAMES;
+}
+
+/// <summary>
+/// Depth only draw of every visible opaque shape, through the transform ring like the shadow maps
+/// </summary>
+/// <param name="_projectionView"></param>
+void CAmbientOcclusion::DrawDepth(const glm::mat4& _projectionView)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_depthFramebuffer);
+
+	float farDepth = 1.0f;
+	glClearNamedFramebufferfv(m_depthFramebuffer, GL_DEPTH, 0, &farDepth);
+
+	m_shapes.clear();
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+		if (shape->m_orthoProject || shape->GetMesh() == nullptr || shape->GetRenderPass() != RenderPass::Opaque) continue;
+		if (!shape->IsInView()) continue;
+
+		m_shapes.push_back(shape);
+	}
+
+	m_stats.shapes = (int)m_shapes.size();
+	if (m_shapes.empty()) return;
+
+	GLenum depthFunc = CGLState::GetDepthFunc();
+	CGLState::Enable(GL_DEPTH_TEST);
+	CGLState::DepthFunc(GL_LESS);
+	CGLState::UseProgram(ShaderLoader::GetProgram("depthOnly")->m_id);
+
+	for (CShape* _shape : m_shapes) {
+		_shape->UpdateModelMat();
+		glm::mat4 model = _shape->GetModel();
+
+		int index = CTransformRing::Push(model, _projectionView * model);
+		_shape->GetMesh()->Render(index);
+	}
+
+	CGLState::DepthFunc(depthFunc);
+}
+
+/// <summary>
+/// Occlusion of each half resolution texel from the depth around it, into the first target
+/// </summary>
+/// <param name="_camera"></param>
+void CAmbientOcclusion::DrawOcclusion(CCamera* _camera)
+{
+	glm::mat4 projection = _camera->GetCameraProjectionMat();
+	glm::mat4 inverse = glm::inverse(projection);
+
+	GLuint program = ShaderLoader::GetProgram("ssao")->m_id;
+	CGLState::UseProgram(program);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "Projection"), 1, GL_FALSE, &projection[0][0]);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "InverseProjection"), 1, GL_FALSE, &inverse[0][0]);
+	glUniform1i(ShaderLoader::GetUniformLocation(program, "SampleCount"), (m_quality == AOQuality::High ? 16 : 6));
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[0]);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+/// <summary>
+/// Blur across into the second target, then down back into the first (which the lit shaders read).
+/// Texels at a different depth are skipped so the occlusion doesn't leak over edges
+/// </summary>
+void CAmbientOcclusion::DrawBlur()
+{
+	GLuint program = ShaderLoader::GetProgram("ssaoBlur")->m_id;
+	CGLState::UseProgram(program);
+	glUniform1i(ShaderLoader::GetUniformLocation(program, "BlurRadius"), (m_quality == AOQuality::High ? 4 : 2));
+
+	GLint direction = ShaderLoader::GetUniformLocation(program, "Direction");
+
+	CGLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, m_targets[0]);
+	glUniform2i(direction, 1, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[1]);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	CGLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, m_targets[1]);
+	glUniform2i(direction, 0, 1);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[0]);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+/// <summary>
+/// Fully visible everywhere
+/// </summary>
+void CAmbientOcclusion::ClearResult()
+{
+	float visible[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+	glClearTexImage(m_targets[0], 0, GL_RGBA, GL_FLOAT, visible);
+}
+
+/// <summary>
+/// Create the half resolution depth and occlusion targets, their framebuffers, and the timer queries
+/// </summary>
+void CAmbientOcclusion::CreateTargets()
+{
+	GLsizei width = utils::windowWidth / SCALE_DIVISOR;
+	GLsizei height = utils::windowHeight / SCALE_DIVISOR;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+	glTextureStorage2D(m_depth, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTextureParameteri(m_depth, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depth, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depth, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_depth, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateFramebuffers(1, &m_depthFramebuffer);
+	glNamedFramebufferTexture(m_depthFramebuffer, GL_DEPTH_ATTACHMENT, m_depth, 0);
+	glNamedFramebufferDrawBuffer(m_depthFramebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_depthFramebuffer, GL_NONE);
+
+	//Visibility and view depth, the depth lets the blur and the lit shaders' upsample stay on one side of an edge
+	glCreateTextures(GL_TEXTURE_2D, 2, m_targets);
+	glCreateFramebuffers(2, m_framebuffers);
+
+	for (int i = 0; i < 2; i++) {
+		glTextureStorage2D(m_targets[i], 1, GL_RG16F, width, height);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glNamedFramebufferTexture(m_framebuffers[i], GL_COLOR_ATTACHMENT0, m_targets[i], 0);
+
+		if (glCheckNamedFramebufferStatus(m_framebuffers[i], GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR: Ambient occlusion framebuffer is incomplete." << std::endl;
+		}
+	}
+
+	ClearResult();
+
+	glCreateQueries(GL_TIME_ELAPSED, QUERY_FRAMES * PASS_COUNT, &m_queries[0][0]);
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		for (int j = 0; j < PASS_COUNT; j++) m_queryIssued[i][j] = false;
+	}
+
+	//The full screen passes make their triangle from gl_VertexID
+	glCreateVertexArrays(1, &m_emptyVertexArray);
+}
+
+void CAmbientOcclusion::BeginTimer(int _pass)
+{
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[m_queryFrame][_pass]);
+}
+
+void CAmbientOcclusion::EndTimer(int _pass)
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_queryIssued[m_queryFrame][_pass] = true;
+}
+
+/// <summary>
+/// Take the times of the passes made QUERY_FRAMES ago, if the GPU has finished them, before their queries are used again
+/// </summary>
+void CAmbientOcclusion::ReadTimers()
+{
+	float* times[PASS_COUNT] = { &m_stats.depthMs, &m_stats.occlusionMs, &m_stats.blurMs };
+
+	for (int i = 0; i < PASS_COUNT; i++) {
+		if (!m_queryIssued[m_queryFrame][i]) continue;
+
+		GLuint query = m_queries[m_queryFrame][i];
+
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		*times[i] = (float)((double)nanoseconds / 1000000.0);
+
+		m_queryIssued[m_queryFrame][i] = false;
+	}
+}
@@ -0,0 +1,94 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CAmbientOcclusion.h
+// Description : Screen space ambient occlusion at half resolution, darkens the ambient light in creases and under objects
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+
+#include <glew.h>
+#include <glm.hpp>
+
+#include "CShape.h"
+#include "CCamera.h"
+
+enum class AOQuality
+{
+	Off,
+
+	//Fewer samples and a narrower blur
+	Low,
+	High,
+};
+
+/// <summary>
+/// GPU time of each pass, from a frame or two ago (timer results are read once they are ready, so nothing waits on them)
+/// </summary>
+struct AOStats
+{
+	float depthMs = 0.0f;
+	float occlusionMs = 0.0f;
+	float blurMs = 0.0f;
+
+	int shapes = 0;
+};
+
+class CAmbientOcclusion
+{
+private:
+	//Result is bound here for the lit shaders, x = visibility, y = view depth. Must match AmbientOcclusion in Lighting.glsl
+	static const GLuint TEXTURE_UNIT = 16;
+
+	//Inputs of the occlusion and blur passes, must match SSAO.frag and SSAOBlur.frag
+	static const GLuint DEPTH_UNIT = 17;
+	static const GLuint SOURCE_UNIT = 18;
+
+	//Occlusion is worked out at 1 / SCALE_DIVISOR of the window's size, must match AO_SCALE in Lighting.glsl
+	static const int SCALE_DIVISOR = 2;
+
+	static const int PASS_COUNT = 3;
+
+	//Timer queries are read this many frames after they were made
+	static const int QUERY_FRAMES = 2;
+
+	static AOQuality m_quality;
+
+	//Half resolution depth of the opaque shapes, and two targets the occlusion and blur passes ping pong between (the first holds the result)
+	static GLuint m_depth;
+	static GLuint m_depthFramebuffer;
+	static GLuint m_targets[2];
+	static GLuint m_framebuffers[2];
+	static GLuint m_emptyVertexArray;
+
+	static GLuint m_queries[QUERY_FRAMES][PASS_COUNT];
+	static bool m_queryIssued[QUERY_FRAMES][PASS_COUNT];
+	static int m_queryFrame;
+
+	static std::vector<CShape*> m_shapes;
+
+	static AOStats m_stats;
+
+	static void CreateTargets();
+	static void DrawDepth(const glm::mat4& _projectionView);
+	static void DrawOcclusion(CCamera* _camera);
+	static void DrawBlur();
+	static void ClearResult();
+
+	static void BeginTimer(int _pass);
+	static void EndTimer(int _pass);
+	static void ReadTimers();
+
+public:
+	static void SetQuality(AOQuality _quality);
+	static AOQuality GetQuality() { return m_quality; };
+
+	static void Render(CCamera* _camera);
+
+	static AOStats GetStats() { return m_stats; };
+};
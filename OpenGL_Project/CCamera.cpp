@@ -1,6 +1,7 @@
 #include "CCamera.h"
 #include "Utility.h"
 #include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
 
 glm::vec3 CCamera::GetWorldRay()
 {
@@ -58,3 +59,14 @@ void CCamera::UpdateRotation()
 	SetCameraRightDir(glm::normalize(GetCameraRightDir()));
 	SetCameraUpDir(glm::normalize(GetCameraUpDir()));
 }
+
+/// <summary>
+/// Recalculates the perspective projection and the view matrix from the camera vars
+/// </summary>
+void CCamera::UpdatePerspective()
+{
+	SetCameraProjectionMat(glm::perspective(glm::radians(FieldOfView), (float)utils::windowWidth / (float)utils::windowHeight, NearPlane, FarPlane));
+
+	//Calculate the new View matrix using all camera vars
+	SetCameraViewMat(glm::lookAt(GetCameraPos(), GetCameraPos() + GetCameraForwardDir(), GetCameraUpDir()));
+}
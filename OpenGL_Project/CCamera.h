@@ -30,6 +30,11 @@ private:
 
 	float speed = 2.0f;
 
+	//Perspective projection
+	float FieldOfView = 90.0f;
+	float NearPlane = 0.1f;
+	float FarPlane = 4000.0f;
+
 public:
 
 	glm::vec3 GetWorldRay();
@@ -64,6 +69,13 @@ public:
 	void SetSpeed(float _speed) { speed = _speed; };
 	float GetSpeed() { return speed; };
 
+	float GetFieldOfView() { return FieldOfView; };
+	float GetNearPlane() { return NearPlane; };
+	float GetFarPlane() { return FarPlane; };
+
 	void UpdateRotation();
+	void UpdatePerspective();
+
+	glm::mat4 GetProjectionViewMat() { return ProjectionMat * ViewMat; };
 };
 
@@ -0,0 +1,338 @@
+#include "CCascadedShadows.h"
+#include "CObjectManager.h"
+#include "CLightManager.h"
+#include "CFrustumCuller.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+
+int CCascadedShadows::m_cascadeCount = 3;
+int CCascadedShadows::m_resolution = 1024;
+float CCascadedShadows::m_shadowDistance = 80.0f;
+GLuint CCascadedShadows::m_shadowMap = NULL;
+GLuint CCascadedShadows::m_framebuffer = NULL;
+GLuint CCascadedShadows::m_blockBuffer = NULL;
+int CCascadedShadows::m_mapResolution = 0;
+CCascadedShadows::Cascade CCascadedShadows::m_cascades[MAX_CASCADES];
+CCascadedShadows::CascadeBlock CCascadedShadows::m_block;
+glm::vec3 CCascadedShadows::m_lightDirection = glm::vec3(0.0f);
+std::unordered_map<CShape*, CCascadedShadows::CasterState> CCascadedShadows::m_casters;
+std::vector<CShape*> CCascadedShadows::m_casterList;
+int CCascadedShadows::m_generation = -1;
+CascadeStats CCascadedShadows::m_stats;
+
+/// <summary>
+/// Set how many cascades the shadow distance is split into, and the size of each cascade's map
+/// </summary>
+/// <param name="_count"> 1 to 4</param>
+/// <param name="_resolution"> texels along each side</param>
+void CCascadedShadows::SetCascades(int _count, int _resolution)
+{
+	if (_count < 1 || _count > MAX_CASCADES || _resolution < 1) {
+		std::cout << "ERROR: Cascaded shadows need 1 to " << MAX_CASCADES << " cascades and a positive resolution." << std::endl;
+		return;
+	}
+
+	m_cascadeCount = _count;
+	m_resolution = _resolution;
+
+	for (Cascade& _cascade : m_cascades) _cascade.dirty = true;
+}
+
+/// <summary>
+/// How far from the camera the cascades reach
+/// </summary>
+/// <param name="_distance"></param>
+void CCascadedShadows::SetShadowDistance(float _distance)
+{
+	m_shadowDistance = _distance;
+
+	for (Cascade& _cascade : m_cascades) _cascade.dirty = true;
+}
+
+/// <summary>
+/// Fit each cascade to its slice of the camera's frustum, and redraw the ones the camera moved out of,
+/// or that a caster moved in. Must be called before the scene is drawn, changes the framebuffer and viewport while drawing
+/// </summary>
+/// <param name="_camera"></param>
+void CCascadedShadows::Render(CCamera* _camera)
+{
+	if (m_shadowMap == NULL || m_mapResolution != m_resolution) CreateMaps();
+
+	//The light turning moves every cascade
+	glm::vec3 direction = glm::normalize(CLightManager::GetDirectionalLight().Direction);
+	if (direction != m_lightDirection) {
+		m_lightDirection = direction;
+		for (Cascade& _cascade : m_cascades) _cascade.dirty = true;
+	}
+
+	_camera->UpdatePerspective();
+
+	//Slices between logarithmic (even texel density) and even distances
+	float nearPlane = _camera->GetNearPlane();
+	float farPlane = glm::min(m_shadowDistance, _camera->GetFarPlane());
+
+	float sliceNear = nearPlane;
+	for (int i = 0; i < m_cascadeCount; i++) {
+		float part = (float)(i + 1) / (float)m_cascadeCount;
+		float logSplit = nearPlane * glm::pow(farPlane / nearPlane, part);
+		float evenSplit = nearPlane + (farPlane - nearPlane) * part;
+		float sliceFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * evenSplit;
+
+		FitCascade(i, _camera, sliceNear, sliceFar);
+		sliceNear = sliceFar;
+	}
+
+	UpdateCasters();
+
+	bool blockDirty = (m_block.count != m_cascadeCount);
+	bool started = false;
+	bool cull = CGLState::IsEnabled(GL_CULL_FACE);
+
+	for (int i = 0; i < m_cascadeCount; i++) {
+		if (!m_cascades[i].dirty) continue;
+
+		if (!started) {
+			started = true;
+
+			CGLState::UseProgram(ShaderLoader::GetProgram("depthOnly")->m_id);
+			CGLState::Enable(GL_DEPTH_TEST);
+			CGLState::Disable(GL_CULL_FACE);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glViewport(0, 0, m_resolution, m_resolution);
+		}
+
+		DrawCascade(i);
+		m_cascades[i].dirty = false;
+
+		m_block.matrices[i] = m_cascades[i].projectionView;
+		m_block.texelSizes[i] = 2.0f * m_cascades[i].radius / (float)m_resolution;
+		blockDirty = true;
+
+		m_stats.rendered++;
+	}
+
+	if (started) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, utils::windowWidth, utils::windowHeight);
+
+		if (cull) CGLState::Enable(GL_CULL_FACE);
+	}
+
+	if (blockDirty) {
+		m_block.count = m_cascadeCount;
+		glNamedBufferSubData(m_blockBuffer, 0, sizeof(CascadeBlock), &m_block);
+	}
+
+	CGLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, m_shadowMap);
+}
+
+/// <summary>
+/// Create the depth array (one layer per cascade), the framebuffer to draw into it and the uniform block.
+/// Called again if the resolution changes
+/// </summary>
+void CCascadedShadows::CreateMaps()
+{
+	if (m_shadowMap != NULL) CGLState::DeleteTextures(1, &m_shadowMap);
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_shadowMap);
+	glTextureStorage3D(m_shadowMap, 1, GL_DEPTH_COMPONENT32F, m_resolution, m_resolution, MAX_CASCADES);
+
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	//Past the edge of a cascade is lit
+	float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTextureParameterfv(m_shadowMap, GL_TEXTURE_BORDER_COLOR, border);
+
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(m_shadowMap, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	m_mapResolution = m_resolution;
+
+	if (m_framebuffer == NULL) {
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+	}
+
+	if (m_blockBuffer == NULL) {
+		glCreateBuffers(1, &m_blockBuffer);
+		glNamedBufferStorage(m_blockBuffer, sizeof(CascadeBlock), &m_block, GL_DYNAMIC_STORAGE_BIT);
+		CGLState::BindBufferBase(GL_UNIFORM_BUFFER, BLOCK_BINDING, m_blockBuffer);
+	}
+
+	for (Cascade& _cascade : m_cascades) _cascade.dirty = true;
+}
+
+/// <summary>
+/// Find the sphere around a slice of the camera's frustum. If it isn't inside the area the cascade was last drawn for,
+/// the cascade is moved there (grown by the padding) and marked for drawing. The sphere is the same size whichever
+/// way the camera faces, and the light's view is snapped to whole texels, so shadow edges don't shimmer
+/// </summary>
+/// <param name="_index"></param>
+/// <param name="_camera"> perspective must be up to date</param>
+/// <param name="_near"> distance the slice starts</param>
+/// <param name="_far"> distance the slice ends</param>
+void CCascadedShadows::FitCascade(int _index, CCamera* _camera, float _near, float _far)
+{
+	float tanHalf = glm::tan(glm::radians(_camera->GetFieldOfView()) / 2.0f);
+	float aspect = (float)utils::windowWidth / (float)utils::windowHeight;
+	glm::mat4 inverseView = glm::inverse(_camera->GetCameraViewMat());
+
+	glm::vec3 corners[8];
+	glm::vec3 centre = glm::vec3(0.0f);
+
+	for (int i = 0; i < 8; i++) {
+		float distance = (i < 4 ? _near : _far);
+		float x = ((i & 1) ? 1.0f : -1.0f) * distance * tanHalf * aspect;
+		float y = ((i & 2) ? 1.0f : -1.0f) * distance * tanHalf;
+
+		corners[i] = glm::vec3(inverseView * glm::vec4(x, y, -distance, 1.0f));
+		centre += corners[i] / 8.0f;
+	}
+
+	float radius = 0.0f;
+	for (const glm::vec3& _corner : corners) {
+		radius = glm::max(radius, glm::length(_corner - centre));
+	}
+
+	//Round up so the size doesn't flicker with float error
+	radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+	Cascade& cascade = m_cascades[_index];
+	if (!cascade.dirty && glm::length(centre - cascade.centre) + radius <= cascade.radius) return;
+
+	cascade.dirty = true;
+	cascade.centre = centre;
+	cascade.radius = radius * (1.0f + PADDING);
+
+	float size = cascade.radius;
+	glm::vec3 up = (glm::abs(m_lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+
+	glm::mat4 view = glm::lookAt(centre - m_lightDirection * (size + CASTER_DISTANCE), centre, up);
+	glm::mat4 projection = glm::ortho(-size, size, -size, size, 0.0f, 2.0f * size + CASTER_DISTANCE);
+
+	//Move by less than a texel so the world origin lands on a texel corner
+	glm::vec4 origin = projection * view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	origin *= (float)m_resolution / 2.0f;
+
+	glm::vec4 offset = (glm::round(origin) - origin) * (2.0f / (float)m_resolution);
+	projection[3][0] += offset.x;
+	projection[3][1] += offset.y;
+
+	cascade.projectionView = projection * view;
+	CFrustumCuller::ExtractPlanes(cascade.projectionView, cascade.planes);
+}
+
+/// <summary>
+/// Collect this frame's casters (opaque world space shapes), and mark cascades that see a caster that appeared, moved or went away
+/// </summary>
+void CCascadedShadows::UpdateCasters()
+{
+	//Shapes were added or removed, old pointers may have been reused, start again
+	if (m_generation != CObjectManager::GetGeneration()) {
+		m_generation = CObjectManager::GetGeneration();
+		m_casters.clear();
+
+		for (Cascade& _cascade : m_cascades) _cascade.dirty = true;
+	}
+
+	m_casterList.clear();
+
+	for (std::pair<CShape* const, CasterState>& _caster : m_casters) {
+		_caster.second.seen = false;
+	}
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+		if (shape->m_orthoProject || shape->GetMesh() == nullptr || shape->GetRenderPass() != RenderPass::Opaque) continue;
+
+		m_casterList.push_back(shape);
+
+		glm::vec3 centre = shape->GetBoundsCentre();
+		glm::vec3 extents = shape->GetBoundsExtents();
+
+		std::unordered_map<CShape*, CasterState>::iterator found = m_casters.find(shape);
+		if (found == m_casters.end()) {
+			CasterState state;
+			state.centre = centre;
+			state.extents = extents;
+			found = m_casters.insert(std::make_pair(shape, state)).first;
+
+			MarkCascades(centre, extents);
+		}
+
+		CasterState& state = found->second;
+		state.seen = true;
+
+		bool moved = glm::any(glm::greaterThan(glm::abs(centre - state.centre), glm::vec3(MOVE_THRESHOLD)))
+			|| glm::any(glm::greaterThan(glm::abs(extents - state.extents), glm::vec3(MOVE_THRESHOLD)));
+
+		if (!moved) continue;
+
+		MarkCascades(state.centre, state.extents);
+		MarkCascades(centre, extents);
+
+		state.centre = centre;
+		state.extents = extents;
+	}
+
+	//Casters that stopped casting
+	for (std::unordered_map<CShape*, CasterState>::iterator it = m_casters.begin(); it != m_casters.end(); ) {
+		if (it->second.seen) {
+			it++;
+			continue;
+		}
+
+		MarkCascades(it->second.centre, it->second.extents);
+		it = m_casters.erase(it);
+	}
+}
+
+void CCascadedShadows::MarkCascades(const glm::vec3& _centre, const glm::vec3& _extents)
+{
+	for (int i = 0; i < m_cascadeCount; i++) {
+		if (Overlaps(m_cascades[i], _centre, _extents)) m_cascades[i].dirty = true;
+	}
+}
+
+bool CCascadedShadows::Overlaps(const Cascade& _cascade, const glm::vec3& _centre, const glm::vec3& _extents)
+{
+	for (int p = 0; p < 6; p++) {
+		glm::vec3 normal = glm::vec3(_cascade.planes[p]);
+		if (glm::dot(normal, _centre) + _cascade.planes[p].w + glm::dot(glm::abs(normal), _extents) < 0.0f) return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Clear a cascade's layer and draw every caster inside its box. The framebuffer must already be bound
+/// </summary>
+/// <param name="_index"></param>
+void CCascadedShadows::DrawCascade(int _index)
+{
+	glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, m_shadowMap, 0, _index);
+
+	float farDepth = 1.0f;
+	glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+
+	const Cascade& cascade = m_cascades[_index];
+
+	for (CShape* _shape : m_casterList) {
+		if (!Overlaps(cascade, _shape->GetBoundsCentre(), _shape->GetBoundsExtents())) continue;
+
+		_shape->UpdateModelMat();
+		glm::mat4 model = _shape->GetModel();
+
+		int index = CTransformRing::Push(model, cascade.projectionView * model);
+		_shape->GetMesh()->Render(index);
+
+		m_stats.casters++;
+	}
+}
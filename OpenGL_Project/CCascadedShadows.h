@@ -0,0 +1,125 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CCascadedShadows.h
+// Description : Cascaded shadow maps for the directional light, fitted to slices of the camera's frustum
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+#include <glew.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "CShape.h"
+#include "CCamera.h"
+
+/// <summary>
+/// Cascades redrawn this frame
+/// </summary>
+struct CascadeStats
+{
+	int rendered = 0;
+	int casters = 0;
+};
+
+class CCascadedShadows
+{
+private:
+	//Must match the shaders (MAX_CASCADES, the Cascades block and the CascadeShadows binding)
+	static const int MAX_CASCADES = 4;
+	static const GLuint BLOCK_BINDING = 2;
+	static const GLuint TEXTURE_UNIT = 11;
+
+	//How much bigger than its slice a cascade is drawn, the camera can move this far before it is redrawn
+	static constexpr float PADDING = 0.15f;
+
+	//How far behind a cascade casters are still drawn (towards the light)
+	static constexpr float CASTER_DISTANCE = 100.0f;
+
+	//Split between logarithmic (1) and even (0) slice distances
+	static constexpr float SPLIT_LAMBDA = 0.75f;
+
+	static constexpr float MOVE_THRESHOLD = 0.001f;
+
+	/// <summary>
+	/// Uniform block read by the lit shaders (std140)
+	/// </summary>
+	struct CascadeBlock
+	{
+		glm::mat4 matrices[MAX_CASCADES];
+
+		//World size of one texel in each cascade, for normal offset bias
+		glm::vec4 texelSizes = glm::vec4(0.0f);
+
+		int count = 0;
+		int padding[3] = { 0, 0, 0 };
+	};
+
+	/// <summary>
+	/// Area a cascade was last drawn for
+	/// </summary>
+	struct Cascade
+	{
+		bool dirty = true;
+
+		glm::vec3 centre = glm::vec3(0.0f);
+		float radius = 0.0f;
+
+		glm::mat4 projectionView = glm::mat4();
+		glm::vec4 planes[6];
+	};
+
+	/// <summary>
+	/// A caster's bounds when the cascades last saw it
+	/// </summary>
+	struct CasterState
+	{
+		glm::vec3 centre = glm::vec3(0.0f);
+		glm::vec3 extents = glm::vec3(0.0f);
+		bool seen = false;
+	};
+
+	static int m_cascadeCount;
+	static int m_resolution;
+	static float m_shadowDistance;
+
+	static GLuint m_shadowMap;
+	static GLuint m_framebuffer;
+	static GLuint m_blockBuffer;
+	static int m_mapResolution;
+
+	static Cascade m_cascades[MAX_CASCADES];
+	static CascadeBlock m_block;
+	static glm::vec3 m_lightDirection;
+
+	static std::unordered_map<CShape*, CasterState> m_casters;
+	static std::vector<CShape*> m_casterList;
+	static int m_generation;
+
+	static CascadeStats m_stats;
+
+	static void CreateMaps();
+	static void UpdateCasters();
+	static void MarkCascades(const glm::vec3& _centre, const glm::vec3& _extents);
+	static bool Overlaps(const Cascade& _cascade, const glm::vec3& _centre, const glm::vec3& _extents);
+	static void FitCascade(int _index, CCamera* _camera, float _near, float _far);
+	static void DrawCascade(int _index);
+
+public:
+	static void Render(CCamera* _camera);
+
+	static void SetCascades(int _count, int _resolution);
+	static void SetShadowDistance(float _distance);
+
+	static GLuint GetShadowMap() { return m_shadowMap; };
+
+	static void NewFrame() { m_stats = CascadeStats(); };
+	static CascadeStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,156 @@
+#include "CDeferredRenderer.h"
+#include "CLightManager.h"
+#include "CMesh.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+#include "CPostProcess.h"
+
+bool CDeferredRenderer::m_enabled = false;
+GLuint CDeferredRenderer::m_framebuffer = NULL;
+GLuint CDeferredRenderer::m_targets[TARGET_COUNT] = { NULL, NULL, NULL };
+GLuint CDeferredRenderer::m_depth = NULL;
+GLuint CDeferredRenderer::m_emptyVertexArray = NULL;
+bool CDeferredRenderer::m_restoreBlend = false;
+DeferredStats CDeferredRenderer::m_stats;
+
+/// <summary>
+/// Start drawing opaque shapes into the G-buffer, they must use the G-buffer programs.
+/// Blending is off until EndGeometry, the albedo's alpha holds reflectivity
+/// </summary>
+void CDeferredRenderer::BeginGeometry()
+{
+	if (m_framebuffer == NULL) CreateTargets();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	float clearColour[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < TARGET_COUNT; i++) {
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, i, clearColour);
+	}
+	glClearNamedFramebufferfi(m_framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+	m_restoreBlend = CGLState::IsEnabled(GL_BLEND);
+	CGLState::Disable(GL_BLEND);
+}
+
+/// <summary>
+/// Shade the G-buffer into the scene: one full screen pass for the directional light and reflection,
+/// then one volume per point light. The G-buffer's depth is written to the scene so forward shapes can be drawn after
+/// </summary>
+/// <param name="_camera"></param>
+void CDeferredRenderer::EndGeometry(CCamera* _camera)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, CPostProcess::GetSceneFramebuffer());
+
+	_camera->UpdatePerspective();
+	glm::mat4 projectionView = _camera->GetProjectionViewMat();
+	glm::mat4 inverse = glm::inverse(projectionView);
+
+	BindTargets();
+
+	GLenum depthFunc = CGLState::GetDepthFunc();
+
+	GLuint program = ShaderLoader::GetProgram("deferredLight")->m_id;
+	CGLState::UseProgram(program);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "InverseProjectionView"), 1, GL_FALSE, &inverse[0][0]);
+
+	//Every covered pixel writes its depth
+	CGLState::Enable(GL_DEPTH_TEST);
+	CGLState::DepthFunc(GL_ALWAYS);
+
+	CGLState::BindVertexArray(m_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	m_stats.lightingPasses++;
+
+	DrawLightVolumes(projectionView, inverse);
+
+	CGLState::DepthFunc(depthFunc);
+	if (m_restoreBlend) CGLState::Enable(GL_BLEND);
+}
+
+/// <summary>
+/// Add every point light to the pixels inside its range, with one instanced draw of a sphere per light.
+/// Back faces are drawn where they are behind the scene, so it works with the camera inside a light
+/// </summary>
+/// <param name="_projectionView"></param>
+/// <param name="_inverse"></param>
+void CDeferredRenderer::DrawLightVolumes(const glm::mat4& _projectionView, const glm::mat4& _inverse)
+{
+	int count = CLightManager::GetPointLightCount();
+	if (count == 0) return;
+
+	bool exists = false;
+	CMesh* sphere = CMesh::GetMesh("sphere", &exists);
+	if (!exists || sphere == nullptr || sphere->GetSphereRadius() <= 0.0f) return;
+
+	GLuint program = ShaderLoader::GetProgram("deferredPointLight")->m_id;
+	CGLState::UseProgram(program);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "ProjectionView"), 1, GL_FALSE, &_projectionView[0][0]);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "InverseProjectionView"), 1, GL_FALSE, &_inverse[0][0]);
+	glUniform1f(ShaderLoader::GetUniformLocation(program, "VolumeScale"), VOLUME_PADDING / sphere->GetSphereRadius());
+
+	bool cull = CGLState::IsEnabled(GL_CULL_FACE);
+	GLenum cullFace = CGLState::GetCullFace();
+	GLenum blendSource = CGLState::GetBlendSource();
+	GLenum blendDestination = CGLState::GetBlendDestination();
+
+	CGLState::Enable(GL_BLEND);
+	CGLState::BlendFunc(GL_ONE, GL_ONE);
+	CGLState::Enable(GL_CULL_FACE);
+	CGLState::CullFace(GL_FRONT);
+	CGLState::DepthFunc(GL_GEQUAL);
+	GLboolean depthMask = CGLState::GetDepthMask();
+	CGLState::DepthMask(GL_FALSE);
+
+	sphere->RenderInstanced(count, 0);
+	m_stats.lightVolumes += count;
+
+	CGLState::DepthMask(depthMask);
+	CGLState::CullFace(cullFace);
+	if (!cull) CGLState::Disable(GL_CULL_FACE);
+	CGLState::BlendFunc(blendSource, blendDestination);
+	CGLState::Disable(GL_BLEND);
+}
+
+/// <summary>
+/// Create the G-buffer: albedo + reflectivity, normal + rim exponent, rim colour, and depth/stencil
+/// </summary>
+void CDeferredRenderer::CreateTargets()
+{
+	static const GLenum formats[TARGET_COUNT] = { GL_RGBA8, GL_RGBA16F, GL_RGBA8 };
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glCreateTextures(GL_TEXTURE_2D, TARGET_COUNT, m_targets);
+
+	GLenum drawBuffers[TARGET_COUNT];
+	for (int i = 0; i < TARGET_COUNT; i++) {
+		glTextureStorage2D(m_targets[i], 1, formats[i], utils::windowWidth, utils::windowHeight);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_targets[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0 + i, m_targets[i], 0);
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	glNamedFramebufferDrawBuffers(m_framebuffer, TARGET_COUNT, drawBuffers);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+	glTextureStorage2D(m_depth, 1, GL_DEPTH24_STENCIL8, utils::windowWidth, utils::windowHeight);
+	glTextureParameteri(m_depth, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depth, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depth, 0);
+
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR: G-buffer framebuffer is incomplete." << std::endl;
+	}
+
+	//The full screen pass makes its triangle from gl_VertexID
+	glCreateVertexArrays(1, &m_emptyVertexArray);
+}
+
+void CDeferredRenderer::BindTargets()
+{
+	for (int i = 0; i < TARGET_COUNT; i++) {
+		CGLState::BindTexture(GBUFFER_UNIT + i, GL_TEXTURE_2D, m_targets[i]);
+	}
+	CGLState::BindTexture(GBUFFER_UNIT + TARGET_COUNT, GL_TEXTURE_2D, m_depth);
+}
@@ -0,0 +1,62 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CDeferredRenderer.h
+// Description : Optional deferred path, opaque lit shapes write a G-buffer that is then shaded once per pixel
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <glew.h>
+#include <glm.hpp>
+
+#include "CCamera.h"
+
+/// <summary>
+/// Work done by the lighting passes this frame
+/// </summary>
+struct DeferredStats
+{
+	int lightingPasses = 0;
+	int lightVolumes = 0;
+};
+
+class CDeferredRenderer
+{
+private:
+	//G-buffer textures are bound to GBUFFER_UNIT onwards (albedo, normal, params, depth), must match GBuffer.glsl
+	static const GLuint GBUFFER_UNIT = 12;
+	static const int TARGET_COUNT = 3;
+
+	//Light volumes are drawn a little bigger than the range, so the sphere mesh's flat faces still cover it
+	static constexpr float VOLUME_PADDING = 1.05f;
+
+	static bool m_enabled;
+
+	static GLuint m_framebuffer;
+	static GLuint m_targets[TARGET_COUNT];
+	static GLuint m_depth;
+	static GLuint m_emptyVertexArray;
+
+	//Whether blending was on before the G-buffer pass turned it off
+	static bool m_restoreBlend;
+
+	static DeferredStats m_stats;
+
+	static void CreateTargets();
+	static void BindTargets();
+	static void DrawLightVolumes(const glm::mat4& _projectionView, const glm::mat4& _inverse);
+
+public:
+	static void SetEnabled(bool _enabled) { m_enabled = _enabled; };
+	static bool IsEnabled() { return m_enabled; };
+
+	static void BeginGeometry();
+	static void EndGeometry(CCamera* _camera);
+
+	static void NewFrame() { m_stats = DeferredStats(); };
+	static DeferredStats GetStats() { return m_stats; };
+};
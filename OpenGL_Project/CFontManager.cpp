@@ -0,0 +1,865 @@
+#include "CFontManager.h"
+#include "CGLState.h"
+
+#include <cstring>
+
+FT_Library CFontManager::m_library = nullptr;
+std::map<std::string, CFontManager::MappedFile> CFontManager::m_files;
+std::map<std::pair<std::string, std::pair<int, int>>, CFont*> CFontManager::m_fonts[2];
+std::string CFontManager::m_cacheDirectory;
+unsigned int CFont::m_frame = 1;
+
+//Changes whenever the glyph cache file layout changes, so old files are ignored
+static const int GLYPH_CACHE_VERSION = 5;
+static const char GLYPH_CACHE_MAGIC[4] = { 'K', 'G', 'L', 'Y' };
+
+/// <summary>
+/// Returns the font at a pixel size, loading and rasterizing it the first time it is asked for
+/// </summary>
+/// <param name="_file"> path to the font file</param>
+/// <param name="_pixelSize"> leave x blank to do auto width, ignored for SDF (scale the glyphs instead)</param>
+/// <param name="_mode"></param>
+/// <returns> nullptr if the font could not be loaded</returns>
+CFont* CFontManager::GetFont(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode)
+{
+	//Every size shares one distance field
+	if (_mode == FontMode::SDF) _pixelSize = glm::ivec2(0, SDF_PIXEL_SIZE);
+
+	std::map<std::pair<std::string, std::pair<int, int>>, CFont*>& fonts = m_fonts[(int)_mode];
+	std::pair<std::string, std::pair<int, int>> key(_file, std::pair<int, int>(_pixelSize.x, _pixelSize.y));
+
+	std::map<std::pair<std::string, std::pair<int, int>>, CFont*>::iterator it = fonts.find(key);
+	if (it != fonts.end()) {
+		return it->second;
+	}
+
+	//Init the freetype library
+	if (m_library == nullptr && FT_Init_FreeType(&m_library) != 0) {
+		std::cout << "FreeType Error: Could not init FreeType Library" << std::endl;
+		m_library = nullptr;
+		return nullptr;
+	}
+
+	const MappedFile* mapped = MapFile(_file);
+	if (mapped == nullptr) {
+		return nullptr;
+	}
+
+	//Load font from the mapped memory
+	FT_Face face = nullptr;
+	if (FT_New_Memory_Face(m_library, mapped->data, (FT_Long)mapped->size, 0, &face) != 0) {
+		std::cout << "FreeType Error: Failed to Load Font" << std::endl;
+		return nullptr;
+	}
+
+	//Set pixel size
+	FT_Set_Pixel_Sizes(face, _pixelSize.x, _pixelSize.y);
+
+	CFont* font = new CFont(_file, _pixelSize, _mode, face);
+
+	//Start with the glyphs used last run if they were saved for this exact file, otherwise glyphs are added as they are used
+	std::string cachePath = GetCachePath(_file, _pixelSize, _mode);
+	if (!cachePath.empty()) {
+		font->LoadCache(cachePath, mapped->size, mapped->hash);
+	}
+
+	fonts[key] = font;
+	return font;
+}
+
+/// <summary>
+/// Save the glyphs each font used to a folder on shutdown, and start with them on later runs
+/// </summary>
+/// <param name="_directory"> empty to turn the disk cache off</param>
+void CFontManager::SetDiskCache(const std::string& _directory)
+{
+	m_cacheDirectory = _directory;
+
+	if (!m_cacheDirectory.empty()) {
+		if (m_cacheDirectory.back() != '/' && m_cacheDirectory.back() != '\\') m_cacheDirectory += '/';
+		CreateDirectoryA(m_cacheDirectory.c_str(), NULL);
+	}
+}
+
+/// <summary>
+/// Save each font's glyphs to the disk cache (if on), free every font and unmap the font files
+/// </summary>
+void CFontManager::Shutdown()
+{
+	for (std::map<std::pair<std::string, std::pair<int, int>>, CFont*>& _fonts : m_fonts) {
+		for (std::pair<const std::pair<std::string, std::pair<int, int>>, CFont*>& _font : _fonts) {
+			CFont* font = _font.second;
+
+			std::string cachePath = GetCachePath(font->GetFile(), font->GetPixelSize(), font->GetMode());
+			if (!cachePath.empty()) {
+				const MappedFile& mapped = m_files[font->GetFile()];
+				font->SaveCache(cachePath, mapped.size, mapped.hash);
+			}
+
+			delete font;
+		}
+		_fonts.clear();
+	}
+
+	for (std::pair<const std::string, MappedFile>& _file : m_files) {
+		UnmapViewOfFile(_file.second.data);
+		CloseHandle(_file.second.mapping);
+		CloseHandle(_file.second.file);
+	}
+	m_files.clear();
+
+	if (m_library) {
+		FT_Done_FreeType(m_library);
+		m_library = nullptr;
+	}
+}
+
+/// <summary>
+/// Map a font file into memory, once per file
+/// </summary>
+/// <param name="_file"></param>
+/// <returns> nullptr if it could not be opened</returns>
+const CFontManager::MappedFile* CFontManager::MapFile(const std::string& _file)
+{
+	std::map<std::string, MappedFile>::iterator it = m_files.find(_file);
+	if (it != m_files.end()) {
+		return &it->second;
+	}
+
+	MappedFile mapped;
+	mapped.file = CreateFileA(_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapped.file == INVALID_HANDLE_VALUE) {
+		std::cout << "ERROR: Could not open font file " << _file << "." << std::endl;
+		return nullptr;
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(mapped.file, &size);
+	mapped.size = size.QuadPart;
+
+	mapped.mapping = CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapped.mapping != NULL) {
+		mapped.data = (const FT_Byte*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if (mapped.data == nullptr) {
+		std::cout << "ERROR: Could not map font file " << _file << "." << std::endl;
+		if (mapped.mapping != NULL) CloseHandle(mapped.mapping);
+		CloseHandle(mapped.file);
+		return nullptr;
+	}
+
+	//FNV-1a over the whole file, it is already in memory
+	mapped.hash = 14695981039346656037ull;
+	for (long long i = 0; i < mapped.size; i++) {
+		mapped.hash = (mapped.hash ^ mapped.data[i]) * 1099511628211ull;
+	}
+
+	m_files[_file] = mapped;
+	return &m_files[_file];
+}
+
+/// <summary>
+/// Where the glyph set of a font at a size is saved
+/// </summary>
+/// <param name="_file"></param>
+/// <param name="_pixelSize"></param>
+/// <param name="_mode"></param>
+/// <returns> empty if the disk cache is off</returns>
+std::string CFontManager::GetCachePath(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode)
+{
+	if (m_cacheDirectory.empty()) return "";
+
+	size_t slash = _file.find_last_of("/\\");
+	std::string name = (slash == std::string::npos ? _file : _file.substr(slash + 1));
+
+	return m_cacheDirectory + name + "_" + std::to_string(_pixelSize.x) + "x" + std::to_string(_pixelSize.y) + (_mode == FontMode::SDF ? "_sdf" : "") + ".glyphs";
+}
+
+CFont::CFont(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode, FT_Face _face) :
+	m_file(_file),
+	m_pixelSize(_pixelSize),
+	m_mode(_mode),
+	m_face(_face)
+{
+	for (int i = 0; i < DIRECT_LIMIT; i++) m_direct[i] = -1;
+
+	m_lineHeight = (int)(m_face->size->metrics.height / 64);
+	m_hasKerning = (FT_HAS_KERNING(m_face) != 0);
+
+	m_pixels.assign(m_atlasSize.x * m_atlasSize.y, 0);
+	RebuildSkyline();
+}
+
+CFont::~CFont()
+{
+	CGLState::DeleteTextures(1, &m_atlas);
+	FT_Done_Face(m_face);
+}
+
+/// <summary>
+/// Make sure every codepoint is in the atlas, rasterizing the missing ones together
+/// (so SDF glyphs can be generated in parallel)
+/// </summary>
+/// <param name="_codepoints"></param>
+void CFont::Request(const std::vector<uint32_t>& _codepoints)
+{
+	std::vector<GlyphImage> images;
+
+	for (uint32_t _codepoint : _codepoints) {
+		int index = Find(_codepoint);
+		if (index >= 0) {
+			m_glyphs[index].lastUsed = m_frame;
+			continue;
+		}
+
+		//Repeated in the same request
+		bool queued = false;
+		for (const GlyphImage& _image : images) {
+			if (_image.codepoint == _codepoint) {
+				queued = true;
+				break;
+			}
+		}
+		if (queued) continue;
+
+		//A face can only be used by one thread, so FreeType renders every bitmap first
+		GlyphImage image;
+		image.codepoint = _codepoint;
+		image.index = FT_Get_Char_Index(m_face, _codepoint);
+
+		if (FT_Load_Char(m_face, _codepoint, FT_LOAD_RENDER)) {
+			//Still added (empty) so it is not tried again every lookup
+			std::cout << "FreeType Error: Failed to Load Glyph " << _codepoint << std::endl;
+		}
+		else {
+			FT_Bitmap& bitmap = m_face->glyph->bitmap;
+
+			image.size = glm::ivec2(bitmap.width, bitmap.rows);
+			image.bearing = glm::ivec2(m_face->glyph->bitmap_left, m_face->glyph->bitmap_top);
+			image.advance = (GLuint)m_face->glyph->advance.x / 64;
+			image.pixels.resize(bitmap.width * bitmap.rows);
+
+			for (unsigned int row = 0; row < bitmap.rows; row++) {
+				std::memcpy(&image.pixels[row * bitmap.width], &bitmap.buffer[row * bitmap.pitch], bitmap.width);
+			}
+		}
+
+		images.push_back(std::move(image));
+	}
+
+	if (images.empty()) return;
+
+	if (m_mode == FontMode::SDF) {
+		MakeDistanceFields(images.data(), (int)images.size());
+	}
+
+	//Tallest first keeps the skyline flatter
+	std::sort(images.begin(), images.end(), [](const GlyphImage& _a, const GlyphImage& _b) { return _a.size.y > _b.size.y; });
+
+	unsigned int version = m_version;
+	int top = m_atlasSize.y;
+	int bottom = 0;
+
+	for (GlyphImage& _image : images) {
+		if (!Pack(_image)) continue;
+
+		const CachedGlyph& cached = m_glyphs.back();
+		if (cached.offset.y < top) top = cached.offset.y;
+		if (cached.offset.y + cached.glyph.size.y > bottom) bottom = cached.offset.y + cached.glyph.size.y;
+	}
+
+	//Growing or evicting changes the whole atlas, otherwise only upload the rows with new glyphs
+	if (m_atlas == NULL || m_version != version) {
+		CreateAtlas();
+	}
+	else if (bottom > top) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(m_atlas, 0, 0, top, m_atlasSize.x, bottom - top, GL_RED, GL_UNSIGNED_BYTE, &m_pixels[top * m_atlasSize.x]);
+	}
+}
+
+/// <summary>
+/// Mark glyphs as used this frame, for labels drawing a layout made on an earlier frame
+/// </summary>
+/// <param name="_glyphs"> from GetGlyphIndex, -1 is skipped</param>
+void CFont::Touch(const std::vector<int>& _glyphs)
+{
+	for (int _glyph : _glyphs) {
+		if (_glyph >= 0 && _glyph < (int)m_glyphs.size()) m_glyphs[_glyph].lastUsed = m_frame;
+	}
+}
+
+/// <summary>
+/// Metrics and texture coordinates of a character, rasterizing it if it is not in the atlas yet.
+/// Texture coordinates stay valid until GetVersion changes
+/// </summary>
+/// <param name="_codepoint"></param>
+/// <returns> empty if the glyph could not be added</returns>
+FontGlyph CFont::GetGlyph(uint32_t _codepoint)
+{
+	int index = Find(_codepoint);
+	if (index < 0) {
+		Request(std::vector<uint32_t>(1, _codepoint));
+
+		index = Find(_codepoint);
+		if (index < 0) return FontGlyph();
+	}
+
+	CachedGlyph& cached = m_glyphs[index];
+	cached.lastUsed = m_frame;
+
+	FontGlyph glyph = cached.glyph;
+	glyph.uvMin = glm::vec2(cached.offset) / glm::vec2(m_atlasSize);
+	glyph.uvMax = glm::vec2(cached.offset + glyph.size) / glm::vec2(m_atlasSize);
+
+	return glyph;
+}
+
+/// <summary>
+/// Extra space between two glyphs (usually negative, e.g. "AV")
+/// </summary>
+/// <param name="_leftIndex"> FreeType glyph index (FontGlyph::index)</param>
+/// <param name="_rightIndex"></param>
+/// <returns> pixels at the font's size</returns>
+int CFont::GetKerning(GLuint _leftIndex, GLuint _rightIndex) const
+{
+	if (!m_hasKerning || _leftIndex == 0 || _rightIndex == 0) return 0;
+
+	FT_Vector delta;
+	if (FT_Get_Kerning(m_face, _leftIndex, _rightIndex, FT_KERNING_DEFAULT, &delta) != 0) return 0;
+
+	return (int)(delta.x / 64);
+}
+
+/// <summary>
+/// Index of a glyph in m_glyphs
+/// </summary>
+/// <param name="_codepoint"></param>
+/// <returns> -1 if not in the atlas</returns>
+int CFont::Find(uint32_t _codepoint) const
+{
+	if (_codepoint < DIRECT_LIMIT) return m_direct[_codepoint];
+	if (m_table.empty()) return -1;
+
+	size_t mask = m_table.size() - 1;
+	for (size_t i = (_codepoint * 2654435761u) & mask; ; i = (i + 1) & mask) {
+		if (m_table[i].first == _codepoint) return m_table[i].second;
+		if (m_table[i].first == EMPTY_CODEPOINT) return -1;
+	}
+}
+
+/// <summary>
+/// Add a glyph to the lookup
+/// </summary>
+/// <param name="_codepoint"></param>
+/// <param name="_glyph"> index in m_glyphs</param>
+void CFont::Insert(uint32_t _codepoint, int _glyph)
+{
+	if (_codepoint < DIRECT_LIMIT) {
+		m_direct[_codepoint] = _glyph;
+		return;
+	}
+
+	//Keep the table at most half full, rebuilding picks up the new glyph from m_glyphs
+	if ((m_tableCount + 1) * 2 > (int)m_table.size()) {
+		RebuildLookup();
+		return;
+	}
+
+	size_t mask = m_table.size() - 1;
+	size_t i = (_codepoint * 2654435761u) & mask;
+	while (m_table[i].first != EMPTY_CODEPOINT) i = (i + 1) & mask;
+
+	m_table[i] = std::pair<uint32_t, int>(_codepoint, _glyph);
+	m_tableCount++;
+}
+
+/// <summary>
+/// Rebuild the lookup from m_glyphs (after glyphs were evicted or the table filled)
+/// </summary>
+void CFont::RebuildLookup()
+{
+	for (int i = 0; i < DIRECT_LIMIT; i++) m_direct[i] = -1;
+
+	int count = 0;
+	for (const CachedGlyph& _glyph : m_glyphs) {
+		if (_glyph.codepoint >= DIRECT_LIMIT) count++;
+	}
+
+	size_t size = 16;
+	while (size < (size_t)count * 4) size *= 2;
+
+	m_table.assign(size, std::pair<uint32_t, int>(EMPTY_CODEPOINT, -1));
+	m_tableCount = 0;
+
+	for (size_t i = 0; i < m_glyphs.size(); i++) {
+		Insert(m_glyphs[i].codepoint, (int)i);
+	}
+}
+
+/// <summary>
+/// Find room for a glyph and copy it into the atlas, growing the atlas or evicting old glyphs if it is full
+/// </summary>
+/// <param name="_image"></param>
+/// <returns> false if there was no room even after evicting</returns>
+bool CFont::Pack(GlyphImage& _image)
+{
+	CachedGlyph cached;
+	cached.codepoint = _image.codepoint;
+	cached.lastUsed = m_frame;
+	cached.glyph.size = _image.size;
+	cached.glyph.bearing = _image.bearing;
+	cached.glyph.advance = _image.advance;
+	cached.glyph.index = _image.index;
+
+	//Spaces etc. take no room
+	if (_image.size.x > 0 && _image.size.y > 0) {
+		bool evicted = false;
+
+		while (!FindSpace(_image.size + glm::ivec2(ATLAS_PADDING), cached.offset)) {
+			//Only throw glyphs out once the atlas can't grow
+			if (Grow()) continue;
+
+			if (!evicted) {
+				Evict();
+				evicted = true;
+				continue;
+			}
+
+			std::cout << "ERROR: Font atlas for " << m_file << " is full, glyph " << _image.codepoint << " not added." << std::endl;
+			return false;
+		}
+
+		for (int row = 0; row < _image.size.y; row++) {
+			std::memcpy(&m_pixels[(cached.offset.y + row) * m_atlasSize.x + cached.offset.x], &_image.pixels[row * _image.size.x], _image.size.x);
+		}
+	}
+
+	m_glyphs.push_back(cached);
+	Insert(cached.codepoint, (int)m_glyphs.size() - 1);
+
+	return true;
+}
+
+/// <summary>
+/// Place a rectangle on the skyline, lowest bottom edge first (then narrowest gap)
+/// </summary>
+/// <param name="_size"> including padding</param>
+/// <param name="_offset"> top left of the space found</param>
+/// <returns> false if it doesn't fit</returns>
+bool CFont::FindSpace(glm::ivec2 _size, glm::ivec2& _offset)
+{
+	int bestNode = -1;
+	int bestBottom = INT_MAX;
+	int bestWidth = INT_MAX;
+
+	for (int i = 0; i < (int)m_skyline.size(); i++) {
+		int y = FitSkyline(i, _size);
+		if (y < 0) continue;
+
+		int bottom = y + _size.y;
+		if (bottom < bestBottom || (bottom == bestBottom && m_skyline[i].width < bestWidth)) {
+			bestNode = i;
+			bestBottom = bottom;
+			bestWidth = m_skyline[i].width;
+			_offset = glm::ivec2(m_skyline[i].x, y);
+		}
+	}
+
+	if (bestNode < 0) return false;
+
+	//Raise the skyline over the new rectangle
+	SkylineNode node;
+	node.x = _offset.x;
+	node.y = _offset.y + _size.y;
+	node.width = _size.x;
+	m_skyline.insert(m_skyline.begin() + bestNode, node);
+
+	//Trim the nodes it now covers
+	for (size_t i = bestNode + 1; i < m_skyline.size(); ) {
+		int overlap = m_skyline[i - 1].x + m_skyline[i - 1].width - m_skyline[i].x;
+		if (overlap <= 0) break;
+
+		m_skyline[i].x += overlap;
+		m_skyline[i].width -= overlap;
+
+		if (m_skyline[i].width > 0) break;
+		m_skyline.erase(m_skyline.begin() + i);
+	}
+
+	//Merge neighbours at the same height
+	for (size_t i = 0; i + 1 < m_skyline.size(); ) {
+		if (m_skyline[i].y == m_skyline[i + 1].y) {
+			m_skyline[i].width += m_skyline[i + 1].width;
+			m_skyline.erase(m_skyline.begin() + i + 1);
+		}
+		else {
+			i++;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Lowest a rectangle can sit with its left edge on a skyline node
+/// </summary>
+/// <param name="_node"></param>
+/// <param name="_size"></param>
+/// <returns> top edge, -1 if it doesn't fit</returns>
+int CFont::FitSkyline(int _node, glm::ivec2 _size) const
+{
+	if (m_skyline[_node].x + _size.x > m_atlasSize.x) return -1;
+
+	int y = 0;
+	int widthLeft = _size.x;
+
+	for (int i = _node; widthLeft > 0; i++) {
+		if (i >= (int)m_skyline.size()) return -1;
+
+		if (m_skyline[i].y > y) y = m_skyline[i].y;
+		widthLeft -= m_skyline[i].width;
+	}
+
+	if (y + _size.y > m_atlasSize.y) return -1;
+	return y;
+}
+
+/// <summary>
+/// Build the skyline from the glyphs in the atlas (empty atlas if there are none)
+/// </summary>
+void CFont::RebuildSkyline()
+{
+	std::vector<int> heights(m_atlasSize.x, ATLAS_PADDING);
+
+	for (const CachedGlyph& _glyph : m_glyphs) {
+		if (_glyph.glyph.size.x <= 0 || _glyph.glyph.size.y <= 0) continue;
+
+		int bottom = _glyph.offset.y + _glyph.glyph.size.y + ATLAS_PADDING;
+		int right = _glyph.offset.x + _glyph.glyph.size.x + ATLAS_PADDING;
+		if (right > m_atlasSize.x) right = m_atlasSize.x;
+
+		for (int x = _glyph.offset.x; x < right; x++) {
+			if (bottom > heights[x]) heights[x] = bottom;
+		}
+	}
+
+	m_skyline.clear();
+	for (int x = ATLAS_PADDING; x < m_atlasSize.x; x++) {
+		if (!m_skyline.empty() && m_skyline.back().y == heights[x]) {
+			m_skyline.back().width++;
+			continue;
+		}
+
+		SkylineNode node;
+		node.x = x;
+		node.y = heights[x];
+		node.width = 1;
+		m_skyline.push_back(node);
+	}
+}
+
+/// <summary>
+/// Double the atlas height, glyphs keep their texels but their texture coordinates change
+/// </summary>
+/// <returns> false if already at the max size</returns>
+bool CFont::Grow()
+{
+	if (m_atlasSize.y >= ATLAS_MAX_HEIGHT) return false;
+
+	m_atlasSize.y *= 2;
+	m_pixels.resize(m_atlasSize.x * m_atlasSize.y, 0);
+	m_version++;
+
+	return true;
+}
+
+/// <summary>
+/// Throw out the least recently used half of the glyphs (never ones used this frame) and repack the rest
+/// </summary>
+void CFont::Evict()
+{
+	std::vector<CachedGlyph> glyphs;
+	glyphs.swap(m_glyphs);
+
+	std::sort(glyphs.begin(), glyphs.end(), [](const CachedGlyph& _a, const CachedGlyph& _b) { return _a.lastUsed > _b.lastUsed; });
+
+	size_t keep = 0;
+	while (keep < glyphs.size() && glyphs[keep].lastUsed == m_frame) keep++;
+	keep += (glyphs.size() - keep) / 2;
+
+	//Repack tallest first into an empty atlas
+	std::sort(glyphs.begin(), glyphs.begin() + keep, [](const CachedGlyph& _a, const CachedGlyph& _b) { return _a.glyph.size.y > _b.glyph.size.y; });
+
+	std::vector<unsigned char> pixels(m_atlasSize.x * m_atlasSize.y, 0);
+	pixels.swap(m_pixels);
+	RebuildSkyline();
+
+	for (size_t i = 0; i < keep; i++) {
+		CachedGlyph glyph = glyphs[i];
+		glm::ivec2 size = glyph.glyph.size;
+
+		if (size.x > 0 && size.y > 0) {
+			glm::ivec2 from = glyph.offset;
+			if (!FindSpace(size + glm::ivec2(ATLAS_PADDING), glyph.offset)) continue;
+
+			for (int row = 0; row < size.y; row++) {
+				std::memcpy(&m_pixels[(glyph.offset.y + row) * m_atlasSize.x + glyph.offset.x], &pixels[(from.y + row) * m_atlasSize.x + from.x], size.x);
+			}
+		}
+
+		m_glyphs.push_back(glyph);
+	}
+
+	RebuildLookup();
+	m_version++;
+}
+
+/// <summary>
+/// Turn coverage bitmaps into signed distance fields, split across threads.
+/// Each glyph grows by SDF_SPREAD on every side so the field has room to fall off
+/// </summary>
+/// <param name="_images"></param>
+/// <param name="_count"></param>
+void CFont::MakeDistanceFields(GlyphImage* _images, int _count)
+{
+	std::atomic<int> next(0);
+
+	auto worker = [&]() {
+		for (int i = next++; i < _count; i = next++) {
+			MakeDistanceField(_images[i]);
+		}
+	};
+
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	if (threadCount > (unsigned int)_count) threadCount = (unsigned int)_count;
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < threadCount; i++) {
+		threads.push_back(std::thread(worker));
+	}
+
+	//This thread helps too
+	worker();
+
+	for (std::thread& _thread : threads) {
+		_thread.join();
+	}
+}
+
+/// <summary>
+/// Replace a glyph's coverage with its signed distance field, 0.5 (128) on the outline
+/// </summary>
+/// <param name="_image"></param>
+void CFont::MakeDistanceField(GlyphImage& _image)
+{
+	if (_image.size.x <= 0 || _image.size.y <= 0) return;
+
+	glm::ivec2 size = _image.size + glm::ivec2(SDF_SPREAD * 2);
+	int count = size.x * size.y;
+
+	//Squared distance to the nearest texel inside, and to the nearest texel outside
+	std::vector<float> toInside(count, DISTANCE_INFINITY);
+	std::vector<float> toOutside(count, 0.0f);
+
+	for (int y = 0; y < _image.size.y; y++) {
+		for (int x = 0; x < _image.size.x; x++) {
+			if (_image.pixels[y * _image.size.x + x] < 128) continue;
+
+			int index = (y + SDF_SPREAD) * size.x + x + SDF_SPREAD;
+			toInside[index] = 0.0f;
+			toOutside[index] = DISTANCE_INFINITY;
+		}
+	}
+
+	DistanceTransform(toInside, size);
+	DistanceTransform(toOutside, size);
+
+	_image.pixels.resize(count);
+	for (int i = 0; i < count; i++) {
+		float distance = std::sqrt(toOutside[i]) - std::sqrt(toInside[i]);
+		float value = 0.5f + distance / (2.0f * SDF_SPREAD);
+
+		_image.pixels[i] = (unsigned char)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	_image.size = size;
+	_image.bearing += glm::ivec2(-SDF_SPREAD, SDF_SPREAD);
+}
+
+/// <summary>
+/// Exact squared euclidean distance transform (Felzenszwalb and Huttenlocher), columns then rows
+/// </summary>
+/// <param name="_grid"> 0 on features, DISTANCE_INFINITY elsewhere. Replaced with squared distances</param>
+/// <param name="_size"></param>
+void CFont::DistanceTransform(std::vector<float>& _grid, glm::ivec2 _size)
+{
+	int length = (_size.x > _size.y ? _size.x : _size.y);
+
+	std::vector<float> line(length);
+	std::vector<float> result(length);
+	std::vector<int> parabolas(length);
+	std::vector<float> bounds(length + 1);
+
+	for (int x = 0; x < _size.x; x++) {
+		for (int y = 0; y < _size.y; y++) line[y] = _grid[y * _size.x + x];
+		DistanceTransform(line.data(), result.data(), _size.y, parabolas.data(), bounds.data());
+		for (int y = 0; y < _size.y; y++) _grid[y * _size.x + x] = result[y];
+	}
+
+	for (int y = 0; y < _size.y; y++) {
+		DistanceTransform(&_grid[y * _size.x], result.data(), _size.x, parabolas.data(), bounds.data());
+		std::memcpy(&_grid[y * _size.x], result.data(), _size.x * sizeof(float));
+	}
+}
+
+/// <summary>
+/// One dimensional pass, lower envelope of parabolas rooted at each sample
+/// </summary>
+/// <param name="_values"> input samples</param>
+/// <param name="_distances"> output squared distances</param>
+/// <param name="_count"></param>
+/// <param name="_parabolas"> scratch, _count big</param>
+/// <param name="_bounds"> scratch, _count + 1 big</param>
+void CFont::DistanceTransform(const float* _values, float* _distances, int _count, int* _parabolas, float* _bounds)
+{
+	int k = 0;
+	_parabolas[0] = 0;
+	_bounds[0] = -DISTANCE_INFINITY;
+	_bounds[1] = DISTANCE_INFINITY;
+
+	for (int q = 1; q < _count; q++) {
+		float s = 0.0f;
+		while (true) {
+			int v = _parabolas[k];
+			s = ((_values[q] + q * q) - (_values[v] + v * v)) / (2.0f * q - 2.0f * v);
+			if (s > _bounds[k] || k == 0) break;
+			k--;
+		}
+
+		k++;
+		_parabolas[k] = q;
+		_bounds[k] = s;
+		_bounds[k + 1] = DISTANCE_INFINITY;
+	}
+
+	k = 0;
+	for (int q = 0; q < _count; q++) {
+		while (_bounds[k + 1] < q) k++;
+
+		int v = _parabolas[k];
+		_distances[q] = (float)((q - v) * (q - v)) + _values[v];
+	}
+}
+
+/// <summary>
+/// Replace the atlas texture with the CPU copy
+/// </summary>
+void CFont::CreateAtlas()
+{
+	CGLState::DeleteTextures(1, &m_atlas);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_atlas);
+	glTextureStorage2D(m_atlas, 1, GL_R8, m_atlasSize.x, m_atlasSize.y);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(m_atlas, 0, 0, 0, m_atlasSize.x, m_atlasSize.y, GL_RED, GL_UNSIGNED_BYTE, m_pixels.data());
+
+	glTextureParameteri(m_atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/// <summary>
+/// Load the glyphs saved by SaveCache on a previous run
+/// </summary>
+/// <param name="_path"></param>
+/// <param name="_sourceSize"> size of the font file, the cache is stale if it changed</param>
+/// <param name="_sourceHash"> hash of the font file's contents, the cache is stale if it changed</param>
+/// <returns> false if there is no usable cache, the font is left empty</returns>
+bool CFont::LoadCache(const std::string& _path, long long _sourceSize, uint64_t _sourceHash)
+{
+	std::ifstream file(_path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4] = { 0 };
+	int version = 0;
+	long long sourceSize = 0;
+	uint64_t sourceHash = 0;
+	glm::ivec2 pixelSize;
+	int mode = 0;
+	glm::ivec2 atlasSize;
+	int glyphCount = 0;
+
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&sourceSize, sizeof(sourceSize));
+	file.read((char*)&sourceHash, sizeof(sourceHash));
+	file.read((char*)&pixelSize, sizeof(pixelSize));
+	file.read((char*)&mode, sizeof(mode));
+	file.read((char*)&atlasSize, sizeof(atlasSize));
+	file.read((char*)&glyphCount, sizeof(glyphCount));
+
+	if (!file || std::memcmp(magic, GLYPH_CACHE_MAGIC, sizeof(magic)) != 0 || version != GLYPH_CACHE_VERSION) return false;
+	if (sourceSize != _sourceSize || sourceHash != _sourceHash || pixelSize != m_pixelSize || mode != (int)m_mode) return false;
+	if (atlasSize.x != ATLAS_WIDTH || atlasSize.y < ATLAS_START_HEIGHT || atlasSize.y > ATLAS_MAX_HEIGHT) return false;
+	if (glyphCount < 0 || glyphCount > atlasSize.x * atlasSize.y) return false;
+
+	std::vector<CachedGlyph> glyphs(glyphCount);
+	std::vector<unsigned char> pixels(atlasSize.x * atlasSize.y);
+
+	file.read((char*)glyphs.data(), glyphs.size() * sizeof(CachedGlyph));
+	file.read((char*)pixels.data(), pixels.size());
+	if (!file) return false;
+
+	for (CachedGlyph& _glyph : glyphs) {
+		glm::ivec2 end = _glyph.offset + _glyph.glyph.size;
+		if (_glyph.offset.x < 0 || _glyph.offset.y < 0 || end.x > atlasSize.x || end.y > atlasSize.y) return false;
+
+		_glyph.lastUsed = 0;
+	}
+
+	m_glyphs.swap(glyphs);
+	m_pixels.swap(pixels);
+	m_atlasSize = atlasSize;
+
+	RebuildSkyline();
+	RebuildLookup();
+	CreateAtlas();
+
+	return true;
+}
+
+/// <summary>
+/// Save the glyphs in the atlas so later runs start with them
+/// </summary>
+/// <param name="_path"></param>
+/// <param name="_sourceSize"> size of the font file</param>
+/// <param name="_sourceHash"> hash of the font file's contents</param>
+void CFont::SaveCache(const std::string& _path, long long _sourceSize, uint64_t _sourceHash)
+{
+	if (m_glyphs.empty()) return;
+
+	std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cout << "ERROR: Could not write glyph cache " << _path << "." << std::endl;
+		return;
+	}
+
+	int mode = (int)m_mode;
+	int glyphCount = (int)m_glyphs.size();
+
+	file.write(GLYPH_CACHE_MAGIC, sizeof(GLYPH_CACHE_MAGIC));
+	file.write((const char*)&GLYPH_CACHE_VERSION, sizeof(GLYPH_CACHE_VERSION));
+	file.write((const char*)&_sourceSize, sizeof(_sourceSize));
+	file.write((const char*)&_sourceHash, sizeof(_sourceHash));
+	file.write((const char*)&m_pixelSize, sizeof(m_pixelSize));
+	file.write((const char*)&mode, sizeof(mode));
+	file.write((const char*)&m_atlasSize, sizeof(m_atlasSize));
+	file.write((const char*)&glyphCount, sizeof(glyphCount));
+	file.write((const char*)m_glyphs.data(), m_glyphs.size() * sizeof(CachedGlyph));
+	file.write((const char*)m_pixels.data(), m_pixels.size());
+}
@@ -0,0 +1,232 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CFontManager.h
+// Description : Loads each font file once and shares rasterized glyph atlases between text labels
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+
+#include <glew.h>
+#include <glm.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <Windows.h>
+
+/// <summary>
+/// How glyphs are stored in the atlas
+/// </summary>
+enum class FontMode
+{
+	//Coverage at the pixel size asked for
+	Bitmap,
+
+	//Signed distance to the outline, one atlas stays sharp at any scale
+	SDF,
+};
+
+/// <summary>
+/// Metrics and atlas position of one character
+/// </summary>
+struct FontGlyph
+{
+	//Where the glyph is in the atlas (texture coordinates)
+	glm::vec2 uvMin = glm::vec2(0.0f, 0.0f);
+	glm::vec2 uvMax = glm::vec2(0.0f, 0.0f);
+	glm::ivec2 size = glm::ivec2(0, 0);
+	glm::ivec2 bearing = glm::ivec2(0, 0);
+	GLuint advance = 0;
+
+	//FreeType's index for the glyph, for kerning
+	GLuint index = 0;
+};
+
+/// <summary>
+/// One font file at one pixel size. Glyphs are rasterized the first time they are asked for,
+/// and the least recently used are evicted when the atlas is full
+/// </summary>
+class CFont
+{
+public:
+	CFont(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode, FT_Face _face);
+	~CFont();
+
+	void Request(const std::vector<uint32_t>& _codepoints);
+	FontGlyph GetGlyph(uint32_t _codepoint);
+
+	//Where a glyph is kept, for Touch. Stays valid until GetVersion changes
+	int GetGlyphIndex(uint32_t _codepoint) const { return Find(_codepoint); };
+	void Touch(const std::vector<int>& _glyphs);
+	int GetKerning(GLuint _leftIndex, GLuint _rightIndex) const;
+	int GetLineHeight() const { return m_lineHeight; };
+
+	GLuint GetAtlas() const { return m_atlas; };
+	glm::ivec2 GetPixelSize() const { return m_pixelSize; };
+	FontMode GetMode() const { return m_mode; };
+	FT_Face GetFace() const { return m_face; };
+	const std::string& GetFile() const { return m_file; };
+	int GetGlyphCount() const { return (int)m_glyphs.size(); };
+
+	//Changes whenever glyphs already handed out move (atlas grew or glyphs were evicted)
+	unsigned int GetVersion() const { return m_version; };
+
+	bool LoadCache(const std::string& _path, long long _sourceSize, uint64_t _sourceHash);
+	void SaveCache(const std::string& _path, long long _sourceSize, uint64_t _sourceHash);
+
+	static void NewFrame() { m_frame++; };
+
+private:
+	/// <summary>
+	/// One rendered glyph before it is packed
+	/// </summary>
+	struct GlyphImage
+	{
+		uint32_t codepoint = 0;
+		std::vector<unsigned char> pixels;
+		glm::ivec2 size = glm::ivec2(0, 0);
+		glm::ivec2 bearing = glm::ivec2(0, 0);
+		GLuint advance = 0;
+		GLuint index = 0;
+	};
+
+	/// <summary>
+	/// A glyph in the atlas
+	/// </summary>
+	struct CachedGlyph
+	{
+		uint32_t codepoint = 0;
+		FontGlyph glyph;
+
+		//Top left texel in the atlas
+		glm::ivec2 offset = glm::ivec2(0, 0);
+
+		//Frame the glyph was last asked for or drawn
+		unsigned int lastUsed = 0;
+	};
+
+	/// <summary>
+	/// Top edge of the packed area over a run of columns
+	/// </summary>
+	struct SkylineNode
+	{
+		int x = 0;
+		int y = 0;
+		int width = 0;
+	};
+
+	//Width of the glyph atlas, height grows to fit up to the max
+	static const int ATLAS_WIDTH = 512;
+	static const int ATLAS_START_HEIGHT = 128;
+	static const int ATLAS_MAX_HEIGHT = 2048;
+
+	//Gap between glyphs so linear filtering doesn't bleed
+	static const int ATLAS_PADDING = 1;
+
+	//Codepoints with a direct lookup, the rest go through the hash table
+	static const int DIRECT_LIMIT = 128;
+	static const uint32_t EMPTY_CODEPOINT = 0xFFFFFFFF;
+
+	//Texels the distance field reaches past the outline
+	static const int SDF_SPREAD = 8;
+
+	//Starting distance for texels with no feature yet
+	static constexpr float DISTANCE_INFINITY = 1e20f;
+
+	std::string m_file;
+	glm::ivec2 m_pixelSize;
+	FontMode m_mode = FontMode::Bitmap;
+	FT_Face m_face = nullptr;
+
+	//Distance between baselines, and if the face has kerning pairs
+	int m_lineHeight = 0;
+	bool m_hasKerning = false;
+
+	//Atlas texture and a CPU copy of it, for repacking and the disk cache
+	GLuint m_atlas = NULL;
+	glm::ivec2 m_atlasSize = glm::ivec2(ATLAS_WIDTH, ATLAS_START_HEIGHT);
+	std::vector<unsigned char> m_pixels;
+	std::vector<SkylineNode> m_skyline;
+
+	std::vector<CachedGlyph> m_glyphs;
+
+	//Index into m_glyphs, -1 if not in the atlas
+	int m_direct[DIRECT_LIMIT];
+
+	//Open addressing (linear probing) table for codepoints past DIRECT_LIMIT, power of two size
+	std::vector<std::pair<uint32_t, int>> m_table;
+	int m_tableCount = 0;
+
+	unsigned int m_version = 0;
+	static unsigned int m_frame;
+
+	int Find(uint32_t _codepoint) const;
+	void Insert(uint32_t _codepoint, int _glyph);
+	void RebuildLookup();
+
+	bool Pack(GlyphImage& _image);
+	bool FindSpace(glm::ivec2 _size, glm::ivec2& _offset);
+	int FitSkyline(int _node, glm::ivec2 _size) const;
+	void RebuildSkyline();
+	bool Grow();
+	void Evict();
+	void CreateAtlas();
+
+	static void MakeDistanceFields(GlyphImage* _images, int _count);
+	static void MakeDistanceField(GlyphImage& _image);
+	static void DistanceTransform(std::vector<float>& _grid, glm::ivec2 _size);
+	static void DistanceTransform(const float* _values, float* _distances, int _count, int* _parabolas, float* _bounds);
+};
+
+class CFontManager
+{
+private:
+	/// <summary>
+	/// A font file mapped into memory, shared by every size of that font
+	/// </summary>
+	struct MappedFile
+	{
+		HANDLE file = NULL;
+		HANDLE mapping = NULL;
+		const FT_Byte* data = nullptr;
+		long long size = 0;
+
+		//Of the contents, so the glyph cache notices a replaced file of the same size
+		uint64_t hash = 0;
+	};
+
+	static FT_Library m_library;
+	static std::map<std::string, MappedFile> m_files;
+	static std::map<std::pair<std::string, std::pair<int, int>>, CFont*> m_fonts[2];
+
+	//Folder rasterized glyph sets are saved to, empty to not use the disk cache
+	static std::string m_cacheDirectory;
+
+	static const MappedFile* MapFile(const std::string& _file);
+	static std::string GetCachePath(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode);
+
+public:
+	//Pixel size SDF glyphs are generated at, whatever size the label asks for
+	static const int SDF_PIXEL_SIZE = 48;
+
+	static CFont* GetFont(const std::string& _file, glm::ivec2 _pixelSize, FontMode _mode = FontMode::Bitmap);
+	static void SetDiskCache(const std::string& _directory);
+	static void Shutdown();
+	static void NewFrame() { CFont::NewFrame(); };
+
+	static int GetFontCount() { return (int)(m_fonts[0].size() + m_fonts[1].size()); };
+};
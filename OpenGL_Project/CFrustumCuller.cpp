@@ -0,0 +1,171 @@
+#include "CFrustumCuller.h"
+
+#include <xmmintrin.h>
+
+glm::vec4 CFrustumCuller::m_planes[6];
+glm::vec3 CFrustumCuller::m_absNormals[6];
+std::vector<float> CFrustumCuller::m_centreX;
+std::vector<float> CFrustumCuller::m_centreY;
+std::vector<float> CFrustumCuller::m_centreZ;
+std::vector<float> CFrustumCuller::m_extentX;
+std::vector<float> CFrustumCuller::m_extentY;
+std::vector<float> CFrustumCuller::m_extentZ;
+std::vector<unsigned char> CFrustumCuller::m_visible;
+CullStats CFrustumCuller::m_stats;
+
+/// <summary>
+/// Use the frustum of a projection * view matrix for the following tests.
+/// Until this is called every box is visible
+/// </summary>
+/// <param name="_projectionView"></param>
+void CFrustumCuller::SetFrustum(const glm::mat4& _projectionView)
+{
+	ExtractPlanes(_projectionView, m_planes);
+
+	for (int i = 0; i < 6; i++) {
+		m_absNormals[i] = glm::abs(glm::vec3(m_planes[i]));
+	}
+}
+
+/// <summary>
+/// Pull the six normalized frustum planes out of a projection * view matrix (Gribb/Hartmann)
+/// </summary>
+/// <param name="_projectionView"></param>
+/// <param name="_planes"> left, right, bottom, top, near, far, normals point inwards</param>
+void CFrustumCuller::ExtractPlanes(const glm::mat4& _projectionView, glm::vec4 _planes[6])
+{
+	//glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(_projectionView[0][i], _projectionView[1][i], _projectionView[2][i], _projectionView[3][i]);
+	}
+
+	_planes[0] = rows[3] + rows[0];
+	_planes[1] = rows[3] - rows[0];
+	_planes[2] = rows[3] + rows[1];
+	_planes[3] = rows[3] - rows[1];
+	_planes[4] = rows[3] + rows[2];
+	_planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(_planes[i]));
+		if (length > 0.0f) _planes[i] /= length;
+	}
+}
+
+/// <summary>
+/// Remove all added boxes, keeps the memory for the next frame
+/// </summary>
+void CFrustumCuller::Clear()
+{
+	m_centreX.clear();
+	m_centreY.clear();
+	m_centreZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+}
+
+/// <summary>
+/// Add a world space box to be tested on the next Cull
+/// </summary>
+/// <param name="_centre"></param>
+/// <param name="_extents"> half size on each axis</param>
+/// <returns> index to check with IsVisible</returns>
+int CFrustumCuller::Add(const glm::vec3& _centre, const glm::vec3& _extents)
+{
+	m_centreX.push_back(_centre.x);
+	m_centreY.push_back(_centre.y);
+	m_centreZ.push_back(_centre.z);
+	m_extentX.push_back(_extents.x);
+	m_extentY.push_back(_extents.y);
+	m_extentZ.push_back(_extents.z);
+
+	return (int)m_centreX.size() - 1;
+}
+
+/// <summary>
+/// Test every added box against the frustum with SSE, four boxes per plane test.
+/// A box is outside if it is fully behind any one plane
+/// </summary>
+void CFrustumCuller::Cull()
+{
+	size_t count = m_centreX.size();
+
+	//Pad to a multiple of four, the padding results are ignored
+	size_t padded = (count + 3) & ~(size_t)3;
+	m_centreX.resize(padded, 0.0f);
+	m_centreY.resize(padded, 0.0f);
+	m_centreZ.resize(padded, 0.0f);
+	m_extentX.resize(padded, 0.0f);
+	m_extentY.resize(padded, 0.0f);
+	m_extentZ.resize(padded, 0.0f);
+	m_visible.resize(padded);
+
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = 0; i < padded; i += 4) {
+		__m128 centreX = _mm_loadu_ps(&m_centreX[i]);
+		__m128 centreY = _mm_loadu_ps(&m_centreY[i]);
+		__m128 centreZ = _mm_loadu_ps(&m_centreZ[i]);
+		__m128 extentX = _mm_loadu_ps(&m_extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&m_extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&m_extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+
+		for (int p = 0; p < 6; p++) {
+			//Signed distance from the plane to each centre
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[p].x), centreX), _mm_mul_ps(_mm_set1_ps(m_planes[p].y), centreY)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[p].z), centreZ), _mm_set1_ps(m_planes[p].w)));
+
+			//How far each box reaches along the normal
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_absNormals[p].x), extentX), _mm_mul_ps(_mm_set1_ps(m_absNormals[p].y), extentY)),
+				_mm_mul_ps(_mm_set1_ps(m_absNormals[p].z), extentZ));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; j++) {
+			m_visible[i + j] = (((mask >> j) & 1) == 0 ? 1 : 0);
+		}
+	}
+
+	//Drop the padding so Add carries on from the real count
+	m_centreX.resize(count);
+	m_centreY.resize(count);
+	m_centreZ.resize(count);
+	m_extentX.resize(count);
+	m_extentY.resize(count);
+	m_extentZ.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		if (m_visible[i]) m_stats.visible++;
+		else m_stats.culled++;
+	}
+}
+
+/// <summary>
+/// Test one box straight away, for shapes drawn outside of the render queue
+/// </summary>
+/// <param name="_centre"></param>
+/// <param name="_extents"> half size on each axis</param>
+/// <returns></returns>
+bool CFrustumCuller::TestBox(const glm::vec3& _centre, const glm::vec3& _extents)
+{
+	for (int p = 0; p < 6; p++) {
+		float distance = glm::dot(glm::vec3(m_planes[p]), _centre) + m_planes[p].w;
+		float radius = glm::dot(m_absNormals[p], _extents);
+
+		if (distance + radius < 0.0f) {
+			m_stats.culled++;
+			return false;
+		}
+	}
+
+	m_stats.visible++;
+	return true;
+}
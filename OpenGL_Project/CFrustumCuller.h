@@ -0,0 +1,64 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CFrustumCuller.h
+// Description : Tests world space bounding boxes against the camera's view frustum, four at a time
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <cmath>
+
+#include <glm.hpp>
+
+/// <summary>
+/// Counts of boxes tested against the frustum this frame
+/// </summary>
+struct CullStats
+{
+	int visible = 0;
+	int culled = 0;
+
+	int GetTested() { return visible + culled; };
+};
+
+class CFrustumCuller
+{
+private:
+	//Left, right, bottom, top, near, far (xyz = normal pointing in, w = distance)
+	static glm::vec4 m_planes[6];
+
+	//Absolute plane normals, for projecting box extents onto the normal
+	static glm::vec3 m_absNormals[6];
+
+	//Packed bounds, one array per component so four boxes are tested at once
+	static std::vector<float> m_centreX;
+	static std::vector<float> m_centreY;
+	static std::vector<float> m_centreZ;
+	static std::vector<float> m_extentX;
+	static std::vector<float> m_extentY;
+	static std::vector<float> m_extentZ;
+
+	//Result of the last Cull, per added box
+	static std::vector<unsigned char> m_visible;
+
+	static CullStats m_stats;
+
+public:
+	static void SetFrustum(const glm::mat4& _projectionView);
+	static void ExtractPlanes(const glm::mat4& _projectionView, glm::vec4 _planes[6]);
+
+	static void Clear();
+	static int Add(const glm::vec3& _centre, const glm::vec3& _extents);
+	static void Cull();
+	static bool IsVisible(int _index) { return m_visible[_index] != 0; };
+
+	static bool TestBox(const glm::vec3& _centre, const glm::vec3& _extents);
+
+	static void NewFrame() { m_stats = CullStats(); };
+	static CullStats GetStats() { return m_stats; };
+};
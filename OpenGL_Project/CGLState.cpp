@@ -0,0 +1,376 @@
+#include "CGLState.h"
+
+//Start with OpenGL's default state
+GLuint CGLState::m_program = 0;
+GLuint CGLState::m_vertexArray = 0;
+std::map<GLenum, GLuint> CGLState::m_buffers;
+std::map<std::pair<GLenum, GLuint>, CGLState::IndexedBuffer> CGLState::m_indexedBuffers;
+GLuint CGLState::m_activeTexture = 0;
+GLuint CGLState::m_textures[MAX_TEXTURE_UNITS][TARGET_COUNT] = { 0 };
+std::map<GLenum, bool> CGLState::m_capabilities = { { GL_DITHER, true }, { GL_MULTISAMPLE, true } };
+GLenum CGLState::m_polygonMode = GL_FILL;
+GLenum CGLState::m_blendSource = GL_ONE;
+GLenum CGLState::m_blendDestination = GL_ZERO;
+GLenum CGLState::m_depthFunc = GL_LESS;
+GLenum CGLState::m_cullFace = GL_BACK;
+GLboolean CGLState::m_depthMask = GL_TRUE;
+GLboolean CGLState::m_colorMask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+GLStateStats CGLState::m_stats;
+
+/// <summary>
+/// Bind a program if it is not already in use
+/// </summary>
+/// <param name="_program"></param>
+void CGLState::UseProgram(GLuint _program)
+{
+	m_stats.calls++;
+	if (_program == m_program) {
+		m_stats.skippedPrograms++;
+		return;
+	}
+
+	glUseProgram(_program);
+	m_program = _program;
+}
+
+/// <summary>
+/// Bind a VAO if it is not already bound
+/// </summary>
+/// <param name="_vertexArray"></param>
+void CGLState::BindVertexArray(GLuint _vertexArray)
+{
+	m_stats.calls++;
+	if (_vertexArray == m_vertexArray) {
+		m_stats.skippedVertexArrays++;
+		return;
+	}
+
+	glBindVertexArray(_vertexArray);
+	m_vertexArray = _vertexArray;
+}
+
+/// <summary>
+/// Bind a buffer to a target if it is not already bound there.
+/// The element array binding belongs to the bound VAO, so it is always passed through
+/// </summary>
+/// <param name="_target"></param>
+/// <param name="_buffer"></param>
+void CGLState::BindBuffer(GLenum _target, GLuint _buffer)
+{
+	m_stats.calls++;
+	if (_target == GL_ELEMENT_ARRAY_BUFFER) {
+		glBindBuffer(_target, _buffer);
+		return;
+	}
+
+	std::map<GLenum, GLuint>::iterator it = m_buffers.find(_target);
+	if (it != m_buffers.end() && it->second == _buffer) {
+		m_stats.skippedBuffers++;
+		return;
+	}
+
+	glBindBuffer(_target, _buffer);
+	m_buffers[_target] = _buffer;
+}
+
+/// <summary>
+/// Attach a buffer (or part of one) to an indexed binding point if it is not already attached there.
+/// Like OpenGL, this also binds it to the target itself
+/// </summary>
+/// <param name="_target"> GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER</param>
+/// <param name="_index"></param>
+/// <param name="_buffer"></param>
+/// <param name="_offset"></param>
+/// <param name="_size"> 0 for the whole buffer</param>
+void CGLState::BindBufferRange(GLenum _target, GLuint _index, GLuint _buffer, GLintptr _offset, GLsizeiptr _size)
+{
+	m_stats.calls++;
+
+	std::map<std::pair<GLenum, GLuint>, IndexedBuffer>::iterator it = m_indexedBuffers.find(std::make_pair(_target, _index));
+	if (it != m_indexedBuffers.end() && it->second.buffer == _buffer && it->second.offset == _offset && it->second.size == _size) {
+		m_stats.skippedBuffers++;
+		return;
+	}
+
+	if (_size == 0) glBindBufferBase(_target, _index, _buffer);
+	else glBindBufferRange(_target, _index, _buffer, _offset, _size);
+
+	IndexedBuffer binding;
+	binding.buffer = _buffer;
+	binding.offset = _offset;
+	binding.size = _size;
+	m_indexedBuffers[std::make_pair(_target, _index)] = binding;
+	m_buffers[_target] = _buffer;
+}
+
+/// <summary>
+/// Delete buffers, forgetting every binding of them so a new buffer given the same name is bound again
+/// </summary>
+/// <param name="_count"></param>
+/// <param name="_buffers"></param>
+void CGLState::DeleteBuffers(GLsizei _count, const GLuint* _buffers)
+{
+	for (GLsizei i = 0; i < _count; i++) {
+		if (_buffers[i] == 0) continue;
+
+		for (std::map<GLenum, GLuint>::iterator it = m_buffers.begin(); it != m_buffers.end(); it++) {
+			if (it->second == _buffers[i]) it->second = 0;
+		}
+
+		for (std::map<std::pair<GLenum, GLuint>, IndexedBuffer>::iterator it = m_indexedBuffers.begin(); it != m_indexedBuffers.end();) {
+			if (it->second.buffer == _buffers[i]) it = m_indexedBuffers.erase(it);
+			else it++;
+		}
+	}
+
+	glDeleteBuffers(_count, _buffers);
+}
+
+/// <summary>
+/// Change the active texture unit
+/// </summary>
+/// <param name="_unit"> unit number (not GL_TEXTURE0 + unit)</param>
+void CGLState::ActiveTexture(GLuint _unit)
+{
+	m_stats.calls++;
+	if (_unit == m_activeTexture) {
+		m_stats.skippedTextures++;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + _unit);
+	m_activeTexture = _unit;
+}
+
+/// <summary>
+/// Bind a texture to the active unit
+/// </summary>
+/// <param name="_target"></param>
+/// <param name="_texture"></param>
+void CGLState::BindTexture(GLenum _target, GLuint _texture)
+{
+	m_stats.calls++;
+
+	int target = GetTargetIndex(_target);
+	if (target < 0 || m_activeTexture >= MAX_TEXTURE_UNITS) {
+		glBindTexture(_target, _texture);
+		return;
+	}
+
+	if (m_textures[m_activeTexture][target] == _texture) {
+		m_stats.skippedTextures++;
+		return;
+	}
+
+	glBindTexture(_target, _texture);
+	m_textures[m_activeTexture][target] = _texture;
+}
+
+/// <summary>
+/// Bind a texture to a unit, only switching the active unit if the texture is not already there
+/// </summary>
+/// <param name="_unit"> unit number (not GL_TEXTURE0 + unit)</param>
+/// <param name="_target"></param>
+/// <param name="_texture"></param>
+void CGLState::BindTexture(GLuint _unit, GLenum _target, GLuint _texture)
+{
+	int target = GetTargetIndex(_target);
+	if (target >= 0 && _unit < MAX_TEXTURE_UNITS && m_textures[_unit][target] == _texture) {
+		m_stats.calls++;
+		m_stats.skippedTextures++;
+		return;
+	}
+
+	ActiveTexture(_unit);
+	BindTexture(_target, _texture);
+}
+
+/// <summary>
+/// Delete textures, forgetting every unit they are bound to so a new texture given the same name is bound again
+/// </summary>
+/// <param name="_count"></param>
+/// <param name="_textures"></param>
+void CGLState::DeleteTextures(GLsizei _count, const GLuint* _textures)
+{
+	for (GLsizei i = 0; i < _count; i++) {
+		if (_textures[i] == 0) continue;
+
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < TARGET_COUNT; target++) {
+				if (m_textures[unit][target] == _textures[i]) m_textures[unit][target] = 0;
+			}
+		}
+	}
+
+	glDeleteTextures(_count, _textures);
+}
+
+/// <summary>
+/// Is a capability (GL_DEPTH_TEST etc.) enabled, only asks the driver the first time an untracked capability is checked
+/// </summary>
+/// <param name="_cap"></param>
+/// <returns></returns>
+bool CGLState::IsEnabled(GLenum _cap)
+{
+	std::map<GLenum, bool>::iterator it = m_capabilities.find(_cap);
+	if (it != m_capabilities.end()) {
+		m_stats.queries++;
+		return it->second;
+	}
+
+	bool enabled = (glIsEnabled(_cap) == GL_TRUE);
+	m_capabilities[_cap] = enabled;
+	return enabled;
+}
+
+/// <summary>
+/// Enable or disable a capability if it is not already
+/// </summary>
+/// <param name="_cap"></param>
+/// <param name="_enabled"></param>
+void CGLState::SetCapability(GLenum _cap, bool _enabled)
+{
+	m_stats.calls++;
+
+	std::map<GLenum, bool>::iterator it = m_capabilities.find(_cap);
+	if (it != m_capabilities.end() && it->second == _enabled) {
+		m_stats.skippedCapabilities++;
+		return;
+	}
+
+	if (_enabled) glEnable(_cap);
+	else glDisable(_cap);
+
+	m_capabilities[_cap] = _enabled;
+}
+
+/// <summary>
+/// Set fill mode for front and back faces
+/// </summary>
+/// <param name="_mode"> GL_FILL, GL_LINE or GL_POINT</param>
+void CGLState::PolygonMode(GLenum _mode)
+{
+	m_stats.calls++;
+	if (_mode == m_polygonMode) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glPolygonMode(GL_FRONT_AND_BACK, _mode);
+	m_polygonMode = _mode;
+}
+
+/// <summary>
+/// Current fill mode, without asking the driver
+/// </summary>
+/// <returns></returns>
+GLenum CGLState::GetPolygonMode()
+{
+	m_stats.queries++;
+	return m_polygonMode;
+}
+
+/// <summary>
+/// Set blend factors if they are not already
+/// </summary>
+/// <param name="_source"></param>
+/// <param name="_destination"></param>
+void CGLState::BlendFunc(GLenum _source, GLenum _destination)
+{
+	m_stats.calls++;
+	if (_source == m_blendSource && _destination == m_blendDestination) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glBlendFunc(_source, _destination);
+	m_blendSource = _source;
+	m_blendDestination = _destination;
+}
+
+/// <summary>
+/// Set depth comparison if it is not already
+/// </summary>
+/// <param name="_func"></param>
+void CGLState::DepthFunc(GLenum _func)
+{
+	m_stats.calls++;
+	if (_func == m_depthFunc) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glDepthFunc(_func);
+	m_depthFunc = _func;
+}
+
+/// <summary>
+/// Set which faces get culled if it is not already
+/// </summary>
+/// <param name="_mode"></param>
+void CGLState::CullFace(GLenum _mode)
+{
+	m_stats.calls++;
+	if (_mode == m_cullFace) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glCullFace(_mode);
+	m_cullFace = _mode;
+}
+
+/// <summary>
+/// Turn depth writes on or off if they are not already
+/// </summary>
+/// <param name="_flag"></param>
+void CGLState::DepthMask(GLboolean _flag)
+{
+	m_stats.calls++;
+	if (_flag == m_depthMask) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glDepthMask(_flag);
+	m_depthMask = _flag;
+}
+
+/// <summary>
+/// Set which colour channels are written if they are not already
+/// </summary>
+/// <param name="_red"></param>
+/// <param name="_green"></param>
+/// <param name="_blue"></param>
+/// <param name="_alpha"></param>
+void CGLState::ColorMask(GLboolean _red, GLboolean _green, GLboolean _blue, GLboolean _alpha)
+{
+	m_stats.calls++;
+	if (_red == m_colorMask[0] && _green == m_colorMask[1] && _blue == m_colorMask[2] && _alpha == m_colorMask[3]) {
+		m_stats.skippedOther++;
+		return;
+	}
+
+	glColorMask(_red, _green, _blue, _alpha);
+	m_colorMask[0] = _red;
+	m_colorMask[1] = _green;
+	m_colorMask[2] = _blue;
+	m_colorMask[3] = _alpha;
+}
+
+/// <summary>
+/// Slot for a texture target in the per unit table
+/// </summary>
+/// <param name="_target"></param>
+/// <returns> -1 if the target is not tracked</returns>
+int CGLState::GetTargetIndex(GLenum _target)
+{
+	switch (_target)
+	{
+	case GL_TEXTURE_2D: return Target_2D;
+	case GL_TEXTURE_CUBE_MAP: return Target_CubeMap;
+	case GL_TEXTURE_2D_ARRAY: return Target_2DArray;
+	case GL_TEXTURE_CUBE_MAP_ARRAY: return Target_CubeMapArray;
+	default: return -1;
+	}
+}
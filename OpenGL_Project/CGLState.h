@@ -0,0 +1,122 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CGLState.h
+// Description : CPU side copy of the OpenGL state, skips binds that are already current and answers state queries without the driver
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <map>
+#include <utility>
+
+#include <glew.h>
+
+/// <summary>
+/// Counts of state calls for the current frame, "skipped" calls were already current and never reached the driver
+/// </summary>
+struct GLStateStats
+{
+	int calls = 0;
+
+	int skippedPrograms = 0;
+	int skippedVertexArrays = 0;
+	int skippedBuffers = 0;
+	int skippedTextures = 0;
+	int skippedCapabilities = 0;
+	int skippedOther = 0;
+
+	//glIsEnabled/glGetIntegerv calls answered from the cache
+	int queries = 0;
+
+	int GetSkipped() { return skippedPrograms + skippedVertexArrays + skippedBuffers + skippedTextures + skippedCapabilities + skippedOther; };
+};
+
+class CGLState
+{
+private:
+	//Texture units tracked, higher units are passed straight to the driver
+	static const int MAX_TEXTURE_UNITS = 96;
+
+	//Texture targets tracked per unit
+	enum TextureTarget
+	{
+		Target_2D,
+		Target_CubeMap,
+		Target_2DArray,
+		Target_CubeMapArray,
+		TARGET_COUNT
+	};
+
+	/// <summary>
+	/// What is attached to one indexed binding point (uniform/storage blocks), a size of 0 is the whole buffer
+	/// </summary>
+	struct IndexedBuffer
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	static GLuint m_program;
+	static GLuint m_vertexArray;
+	static std::map<GLenum, GLuint> m_buffers;
+	static std::map<std::pair<GLenum, GLuint>, IndexedBuffer> m_indexedBuffers;
+
+	static GLuint m_activeTexture;
+	static GLuint m_textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+
+	static std::map<GLenum, bool> m_capabilities;
+
+	static GLenum m_polygonMode;
+	static GLenum m_blendSource;
+	static GLenum m_blendDestination;
+	static GLenum m_depthFunc;
+	static GLenum m_cullFace;
+	static GLboolean m_depthMask;
+	static GLboolean m_colorMask[4];
+
+	static GLStateStats m_stats;
+
+	static int GetTargetIndex(GLenum _target);
+	static void SetCapability(GLenum _cap, bool _enabled);
+
+public:
+	static void UseProgram(GLuint _program);
+	static void BindVertexArray(GLuint _vertexArray);
+	static void BindBuffer(GLenum _target, GLuint _buffer);
+	static void BindBufferBase(GLenum _target, GLuint _index, GLuint _buffer) { BindBufferRange(_target, _index, _buffer, 0, 0); };
+	static void BindBufferRange(GLenum _target, GLuint _index, GLuint _buffer, GLintptr _offset, GLsizeiptr _size);
+	static void DeleteBuffers(GLsizei _count, const GLuint* _buffers);
+
+	static void ActiveTexture(GLuint _unit);
+	static void BindTexture(GLenum _target, GLuint _texture);
+	static void BindTexture(GLuint _unit, GLenum _target, GLuint _texture);
+	static void DeleteTextures(GLsizei _count, const GLuint* _textures);
+
+	static void Enable(GLenum _cap) { SetCapability(_cap, true); };
+	static void Disable(GLenum _cap) { SetCapability(_cap, false); };
+	static bool IsEnabled(GLenum _cap);
+
+	static void PolygonMode(GLenum _mode);
+	static GLenum GetPolygonMode();
+	static void BlendFunc(GLenum _source, GLenum _destination);
+	static void DepthFunc(GLenum _func);
+	static void CullFace(GLenum _mode);
+	static void DepthMask(GLboolean _flag);
+	static void ColorMask(GLboolean _red, GLboolean _green, GLboolean _blue, GLboolean _alpha);
+
+	static GLuint GetProgram() { return m_program; };
+	static GLuint GetVertexArray() { return m_vertexArray; };
+	static GLenum GetBlendSource() { return m_blendSource; };
+	static GLenum GetBlendDestination() { return m_blendDestination; };
+	static GLenum GetDepthFunc() { return m_depthFunc; };
+	static GLenum GetCullFace() { return m_cullFace; };
+	static GLboolean GetDepthMask() { return m_depthMask; };
+
+	static void NewFrame() { m_stats = GLStateStats(); };
+	static GLStateStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,147 @@
+#include "CGeometryArena.h"
+#include "CGLState.h"
+
+std::map<VertType, CGeometryArena::Pool> CGeometryArena::m_pools;
+ArenaStats CGeometryArena::m_stats;
+
+/// <summary>
+/// Copies vertex and index data into the shared buffers for its format
+/// </summary>
+/// <param name="_type"> vertex format</param>
+/// <param name="_vertices"></param>
+/// <param name="_indices"> indices relative to the mesh's first vertex</param>
+/// <returns> base vertex and first index to draw with</returns>
+ArenaAllocation CGeometryArena::Allocate(VertType _type, const std::vector<float>& _vertices, const std::vector<int>& _indices)
+{
+	Pool& pool = GetPool(_type);
+
+	GLsizeiptr vertexBytes = _vertices.size() * sizeof(float);
+	GLsizeiptr indexBytes = _indices.size() * sizeof(int);
+
+	//Make room if needed
+	if (pool.vertexUsed + vertexBytes > pool.vertexCapacity) {
+		Grow(pool.vbo, pool.vertexCapacity, pool.vertexUsed, pool.vertexUsed + vertexBytes);
+		glVertexArrayVertexBuffer(pool.vao, 0, pool.vbo, 0, pool.stride);
+	}
+	if (pool.indexUsed + indexBytes > pool.indexCapacity) {
+		Grow(pool.ebo, pool.indexCapacity, pool.indexUsed, pool.indexUsed + indexBytes);
+		glVertexArrayElementBuffer(pool.vao, pool.ebo);
+	}
+
+	ArenaAllocation allocation;
+	allocation.baseVertex = (GLint)(pool.vertexUsed / pool.stride);
+	allocation.firstIndex = (GLuint)(pool.indexUsed / sizeof(int));
+	allocation.indexCount = (GLsizei)_indices.size();
+
+	glNamedBufferSubData(pool.vbo, pool.vertexUsed, vertexBytes, _vertices.data());
+	glNamedBufferSubData(pool.ebo, pool.indexUsed, indexBytes, _indices.data());
+
+	pool.vertexUsed += vertexBytes;
+	pool.indexUsed += indexBytes;
+
+	return allocation;
+}
+
+/// <summary>
+/// Returns pool for a format, creating it the first time
+/// </summary>
+/// <param name="_type"></param>
+/// <returns></returns>
+CGeometryArena::Pool& CGeometryArena::GetPool(VertType _type)
+{
+	std::map<VertType, Pool>::iterator it = m_pools.find(_type);
+	if (it != m_pools.end()) {
+		return it->second;
+	}
+
+	Pool& pool = m_pools[_type];
+
+	glCreateVertexArrays(1, &pool.vao);
+
+	glCreateBuffers(1, &pool.vbo);
+	glNamedBufferData(pool.vbo, INITIAL_VERTEX_BYTES, NULL, GL_STATIC_DRAW);
+	pool.vertexCapacity = INITIAL_VERTEX_BYTES;
+
+	glCreateBuffers(1, &pool.ebo);
+	glNamedBufferData(pool.ebo, INITIAL_INDEX_BYTES, NULL, GL_STATIC_DRAW);
+	pool.indexCapacity = INITIAL_INDEX_BYTES;
+
+	m_stats.capacity += INITIAL_VERTEX_BYTES + INITIAL_INDEX_BYTES;
+
+	SetupAttributes(pool, _type);
+
+	return pool;
+}
+
+/// <summary>
+/// Describe the vertex format to the VAO (how to interperet Vertex Data)
+/// </summary>
+/// <param name="_pool"></param>
+/// <param name="_type"></param>
+void CGeometryArena::SetupAttributes(Pool& _pool, VertType _type)
+{
+	GLuint vao = _pool.vao;
+
+	switch (_type)
+	{
+	case VertType::Pos_Col_Tex:
+		_pool.stride = 8 * sizeof(GLfloat);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat));
+		glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat));
+		break;
+
+	case VertType::Pos_Tex_Norm:
+		_pool.stride = 8 * sizeof(GLfloat);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat));
+		glVertexArrayAttribFormat(vao, 2, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat));
+		break;
+
+	case VertType::Pos:
+		_pool.stride = 3 * sizeof(GLfloat);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		break;
+
+	default:
+		break;
+	}
+
+	int attributeCount = (_type == VertType::Pos ? 1 : 3);
+	for (int i = 0; i < attributeCount; i++) {
+		glVertexArrayAttribBinding(vao, i, 0);
+		glEnableVertexArrayAttrib(vao, i);
+	}
+
+	glVertexArrayVertexBuffer(vao, 0, _pool.vbo, 0, _pool.stride);
+	glVertexArrayElementBuffer(vao, _pool.ebo);
+}
+
+/// <summary>
+/// Replaces a buffer with one at least twice as big, keeping its contents
+/// </summary>
+/// <param name="_buffer"> replaced with the new buffer</param>
+/// <param name="_capacity"> updated to the new size</param>
+/// <param name="_used"> bytes to keep</param>
+/// <param name="_needed"> minimum new size</param>
+void CGeometryArena::Grow(GLuint& _buffer, GLsizeiptr& _capacity, GLsizeiptr _used, GLsizeiptr _needed)
+{
+	GLsizeiptr newCapacity = _capacity * 2;
+	while (newCapacity < _needed) newCapacity *= 2;
+
+	GLuint newBuffer = NULL;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferData(newBuffer, newCapacity, NULL, GL_STATIC_DRAW);
+
+	if (_used > 0) {
+		glCopyNamedBufferSubData(_buffer, newBuffer, 0, 0, _used);
+	}
+
+	CGLState::DeleteBuffers(1, &_buffer);
+
+	m_stats.grows++;
+	m_stats.capacity += newCapacity - _capacity;
+
+	_buffer = newBuffer;
+	_capacity = newCapacity;
+}
@@ -0,0 +1,81 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CGeometryArena.h
+// Description : Shared vertex/index buffers that all meshes of the same vertex format are suballocated from
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <map>
+#include <vector>
+#include <iostream>
+
+#include <glew.h>
+
+#include "CMesh.h"
+
+/// <summary>
+/// Where a mesh's data ended up in the arena
+/// </summary>
+struct ArenaAllocation
+{
+	GLint baseVertex = 0;
+	GLuint firstIndex = 0;
+	GLsizei indexCount = 0;
+};
+
+/// <summary>
+/// Totals since startup, the arena only changes when meshes are loaded
+/// </summary>
+struct ArenaStats
+{
+	//Times a buffer had to be replaced with a bigger one
+	int grows = 0;
+
+	//Bytes reserved across every pool's buffers
+	long long capacity = 0;
+};
+
+class CGeometryArena
+{
+private:
+	/// <summary>
+	/// One VAO + VBO + EBO per vertex format
+	/// </summary>
+	struct Pool
+	{
+		GLuint vao = NULL;
+		GLuint vbo = NULL;
+		GLuint ebo = NULL;
+
+		GLsizei stride = 0;
+
+		GLsizeiptr vertexCapacity = 0;
+		GLsizeiptr vertexUsed = 0;
+		GLsizeiptr indexCapacity = 0;
+		GLsizeiptr indexUsed = 0;
+	};
+
+	static const GLsizeiptr INITIAL_VERTEX_BYTES = 1024 * 1024;
+	static const GLsizeiptr INITIAL_INDEX_BYTES = 256 * 1024;
+
+	static std::map<VertType, Pool> m_pools;
+	static ArenaStats m_stats;
+
+	static Pool& GetPool(VertType _type);
+	static void SetupAttributes(Pool& _pool, VertType _type);
+	static void Grow(GLuint& _buffer, GLsizeiptr& _capacity, GLsizeiptr _used, GLsizeiptr _needed);
+
+public:
+	static ArenaAllocation Allocate(VertType _type, const std::vector<float>& _vertices, const std::vector<int>& _indices);
+
+	static GLuint GetVAO(VertType _type) { return GetPool(_type).vao; };
+	static GLuint GetVBO(VertType _type) { return GetPool(_type).vbo; };
+	static GLuint GetEBO(VertType _type) { return GetPool(_type).ebo; };
+
+	static ArenaStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,243 @@
+#include "CLightClusters.h"
+#include "CLightManager.h"
+#include "CGLState.h"
+
+#include <xmmintrin.h>
+
+std::vector<float> CLightClusters::m_minX;
+std::vector<float> CLightClusters::m_minY;
+std::vector<float> CLightClusters::m_minZ;
+std::vector<float> CLightClusters::m_maxX;
+std::vector<float> CLightClusters::m_maxY;
+std::vector<float> CLightClusters::m_maxZ;
+glm::mat4 CLightClusters::m_gridProjection = glm::mat4(0.0f);
+float CLightClusters::m_near = 0.1f;
+float CLightClusters::m_far = 1.0f;
+float CLightClusters::m_tanHalfX = 1.0f;
+float CLightClusters::m_tanHalfY = 1.0f;
+glm::mat4 CLightClusters::m_builtView = glm::mat4(0.0f);
+int CLightClusters::m_builtVersion = -1;
+std::vector<glm::uvec2> CLightClusters::m_pairs;
+std::vector<glm::uvec2> CLightClusters::m_clusters;
+std::vector<GLuint> CLightClusters::m_indices;
+GLuint CLightClusters::m_clusterBuffer = NULL;
+GLsizeiptr CLightClusters::m_clusterCapacity = 0;
+GLuint CLightClusters::m_viewBuffer = NULL;
+CLightClusters::ClusterView CLightClusters::m_view;
+ClusterStats CLightClusters::m_stats;
+
+/// <summary>
+/// List the point lights reaching each cluster of the camera's view and upload the lists for the lit shaders.
+/// Nothing is rebuilt while the camera and lights stay still. The camera's perspective must be up to date
+/// </summary>
+/// <param name="_camera"></param>
+void CLightClusters::Build(CCamera* _camera)
+{
+	if (m_viewBuffer == NULL) {
+		glCreateBuffers(1, &m_viewBuffer);
+		glNamedBufferStorage(m_viewBuffer, sizeof(ClusterView), &m_view, GL_DYNAMIC_STORAGE_BIT);
+		CGLState::BindBufferBase(GL_UNIFORM_BUFFER, VIEW_BINDING, m_viewBuffer);
+	}
+
+	if (_camera->GetCameraProjectionMat() != m_gridProjection) {
+		BuildGrid(_camera);
+		m_builtVersion = -1;
+	}
+
+	glm::mat4 view = _camera->GetCameraViewMat();
+	if (view == m_builtView && CLightManager::GetVersion() == m_builtVersion) return;
+
+	m_builtView = view;
+	m_builtVersion = CLightManager::GetVersion();
+	m_stats = ClusterStats();
+
+	glm::vec3 forward = glm::normalize(_camera->GetCameraForwardDir());
+	m_view.forward = glm::vec4(forward, glm::dot(forward, _camera->GetCameraPos()));
+	glNamedBufferSubData(m_viewBuffer, 0, sizeof(ClusterView), &m_view);
+
+	//Every cluster each light touches, depth made positive in front of the camera
+	m_pairs.clear();
+
+	const std::vector<PointLight>& lights = CLightManager::GetPointLights();
+	for (int i = 0; i < (int)lights.size(); i++) {
+		glm::vec4 viewPos = view * glm::vec4(lights[i].Position, 1.0f);
+		AssignLight(i, glm::vec3(viewPos.x, viewPos.y, -viewPos.z), lights[i].Range);
+	}
+
+	//Count per cluster (y), then give each cluster its start (x), then fill using y as the cursor
+	m_clusters.assign(CLUSTER_COUNT, glm::uvec2(0));
+
+	for (const glm::uvec2& _pair : m_pairs) {
+		m_clusters[_pair.x].y++;
+	}
+
+	GLuint offset = 0;
+	for (glm::uvec2& _cluster : m_clusters) {
+		if ((int)_cluster.y > m_stats.busiest) m_stats.busiest = (int)_cluster.y;
+
+		_cluster.x = offset;
+		offset += _cluster.y;
+		_cluster.y = 0;
+	}
+
+	m_indices.resize(m_pairs.size());
+	for (const glm::uvec2& _pair : m_pairs) {
+		glm::uvec2& cluster = m_clusters[_pair.x];
+		m_indices[cluster.x + cluster.y] = _pair.y;
+		cluster.y++;
+	}
+
+	m_stats.assignments = (int)m_pairs.size();
+
+	Upload();
+}
+
+/// <summary>
+/// Work out the view space bounds of every cluster for the camera's projection.
+/// Tiles split the screen evenly, slices split depth logarithmically so clusters stay roughly cube shaped
+/// </summary>
+/// <param name="_camera"></param>
+void CLightClusters::BuildGrid(CCamera* _camera)
+{
+	m_gridProjection = _camera->GetCameraProjectionMat();
+	m_near = _camera->GetNearPlane();
+	m_far = _camera->GetFarPlane();
+	m_tanHalfY = glm::tan(glm::radians(_camera->GetFieldOfView()) / 2.0f);
+	m_tanHalfX = m_tanHalfY * (float)utils::windowWidth / (float)utils::windowHeight;
+
+	float logRange = glm::log(m_far / m_near);
+	m_view.scale = glm::vec4(
+		(float)GRID_X / (float)utils::windowWidth,
+		(float)GRID_Y / (float)utils::windowHeight,
+		(float)GRID_Z / logRange,
+		-(float)GRID_Z * glm::log(m_near) / logRange);
+
+	m_minX.resize(CLUSTER_COUNT);
+	m_minY.resize(CLUSTER_COUNT);
+	m_minZ.resize(CLUSTER_COUNT);
+	m_maxX.resize(CLUSTER_COUNT);
+	m_maxY.resize(CLUSTER_COUNT);
+	m_maxZ.resize(CLUSTER_COUNT);
+
+	for (int k = 0; k < GRID_Z; k++) {
+		float sliceNear = m_near * glm::pow(m_far / m_near, (float)k / (float)GRID_Z);
+		float sliceFar = m_near * glm::pow(m_far / m_near, (float)(k + 1) / (float)GRID_Z);
+
+		for (int j = 0; j < GRID_Y; j++) {
+			float bottom = (-1.0f + 2.0f * (float)j / (float)GRID_Y) * m_tanHalfY;
+			float top = (-1.0f + 2.0f * (float)(j + 1) / (float)GRID_Y) * m_tanHalfY;
+
+			for (int i = 0; i < GRID_X; i++) {
+				float left = (-1.0f + 2.0f * (float)i / (float)GRID_X) * m_tanHalfX;
+				float right = (-1.0f + 2.0f * (float)(i + 1) / (float)GRID_X) * m_tanHalfX;
+
+				//The slice of the tile's frustum widens with depth, the box holds both ends
+				int index = (k * GRID_Y + j) * GRID_X + i;
+				m_minX[index] = glm::min(left * sliceNear, left * sliceFar);
+				m_maxX[index] = glm::max(right * sliceNear, right * sliceFar);
+				m_minY[index] = glm::min(bottom * sliceNear, bottom * sliceFar);
+				m_maxY[index] = glm::max(top * sliceNear, top * sliceFar);
+				m_minZ[index] = sliceNear;
+				m_maxZ[index] = sliceFar;
+			}
+		}
+	}
+}
+
+int CLightClusters::GetSlice(float _depth)
+{
+	int slice = (int)glm::floor(glm::log(_depth) * m_view.scale.z + m_view.scale.w);
+	return (slice < 0 ? 0 : (slice >= GRID_Z ? GRID_Z - 1 : slice));
+}
+
+/// <summary>
+/// Add a light to every cluster its sphere touches. The tiles and slices its bounds cover are found first,
+/// then the clusters in that range are tested against the sphere with SSE, four tiles at a time
+/// </summary>
+/// <param name="_light"> index into the point lights</param>
+/// <param name="_viewPos"> view space position, z is depth in front of the camera</param>
+/// <param name="_range"></param>
+void CLightClusters::AssignLight(int _light, const glm::vec3& _viewPos, float _range)
+{
+	if (_range <= 0.0f || _viewPos.z + _range < m_near || _viewPos.z - _range > m_far) return;
+
+	float nearDepth = glm::max(_viewPos.z - _range, m_near);
+	float farDepth = glm::min(_viewPos.z + _range, m_far);
+
+	//x / depth is largest and smallest at the corners of the light's box
+	float ndcX[4] = {
+		(_viewPos.x - _range) / (nearDepth * m_tanHalfX), (_viewPos.x - _range) / (farDepth * m_tanHalfX),
+		(_viewPos.x + _range) / (nearDepth * m_tanHalfX), (_viewPos.x + _range) / (farDepth * m_tanHalfX) };
+	float ndcY[4] = {
+		(_viewPos.y - _range) / (nearDepth * m_tanHalfY), (_viewPos.y - _range) / (farDepth * m_tanHalfY),
+		(_viewPos.y + _range) / (nearDepth * m_tanHalfY), (_viewPos.y + _range) / (farDepth * m_tanHalfY) };
+
+	float minX = glm::min(glm::min(ndcX[0], ndcX[1]), glm::min(ndcX[2], ndcX[3]));
+	float maxX = glm::max(glm::max(ndcX[0], ndcX[1]), glm::max(ndcX[2], ndcX[3]));
+	float minY = glm::min(glm::min(ndcY[0], ndcY[1]), glm::min(ndcY[2], ndcY[3]));
+	float maxY = glm::max(glm::max(ndcY[0], ndcY[1]), glm::max(ndcY[2], ndcY[3]));
+
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) return;
+
+	m_stats.lights++;
+
+	int firstX = glm::clamp((int)glm::floor((minX + 1.0f) * 0.5f * GRID_X), 0, GRID_X - 1);
+	int lastX = glm::clamp((int)glm::floor((maxX + 1.0f) * 0.5f * GRID_X), 0, GRID_X - 1);
+	int firstY = glm::clamp((int)glm::floor((minY + 1.0f) * 0.5f * GRID_Y), 0, GRID_Y - 1);
+	int lastY = glm::clamp((int)glm::floor((maxY + 1.0f) * 0.5f * GRID_Y), 0, GRID_Y - 1);
+	int firstZ = GetSlice(nearDepth);
+	int lastZ = GetSlice(farDepth);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 centreX = _mm_set1_ps(_viewPos.x);
+	const __m128 centreY = _mm_set1_ps(_viewPos.y);
+	const __m128 centreZ = _mm_set1_ps(_viewPos.z);
+	const __m128 rangeSquared = _mm_set1_ps(_range * _range);
+
+	for (int k = firstZ; k <= lastZ; k++) {
+		for (int j = firstY; j <= lastY; j++) {
+			int row = (k * GRID_Y + j) * GRID_X;
+
+			for (int i = firstX & ~3; i <= lastX; i += 4) {
+				int index = row + i;
+
+				//Distance from the centre to each box, 0 on an axis the centre is inside
+				__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[index]), centreX), _mm_sub_ps(centreX, _mm_loadu_ps(&m_maxX[index]))));
+				__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[index]), centreY), _mm_sub_ps(centreY, _mm_loadu_ps(&m_maxY[index]))));
+				__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minZ[index]), centreZ), _mm_sub_ps(centreZ, _mm_loadu_ps(&m_maxZ[index]))));
+
+				__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, rangeSquared));
+
+				for (int b = 0; b < 4; b++) {
+					if (((mask >> b) & 1) == 0 || i + b < firstX || i + b > lastX) continue;
+
+					m_pairs.push_back(glm::uvec2((GLuint)(index + b), (GLuint)_light));
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Copy the cluster table and light lists to the storage buffer, growing it if needed.
+/// The table is always a full grid, the lists follow it
+/// </summary>
+void CLightClusters::Upload()
+{
+	GLsizeiptr tableSize = CLUSTER_COUNT * sizeof(glm::uvec2);
+	GLsizeiptr indexSize = m_indices.size() * sizeof(GLuint);
+
+	if (m_clusterBuffer == NULL) {
+		glCreateBuffers(1, &m_clusterBuffer);
+	}
+
+	if (tableSize + indexSize > m_clusterCapacity) {
+		m_clusterCapacity = (tableSize + indexSize) * 2;
+		glNamedBufferData(m_clusterBuffer, m_clusterCapacity, NULL, GL_DYNAMIC_DRAW);
+		CGLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, m_clusterBuffer);
+	}
+
+	glNamedBufferSubData(m_clusterBuffer, 0, tableSize, m_clusters.data());
+	if (indexSize > 0) glNamedBufferSubData(m_clusterBuffer, tableSize, indexSize, m_indices.data());
+}
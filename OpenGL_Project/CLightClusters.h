@@ -0,0 +1,99 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CLightClusters.h
+// Description : Splits the camera's view into a grid of clusters and lists the point lights that reach each one
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+
+#include <glew.h>
+#include <glm.hpp>
+
+#include "CCamera.h"
+
+/// <summary>
+/// Light assignment of the last build
+/// </summary>
+struct ClusterStats
+{
+	//Point lights inside the grid, and how many clusters they were added to in total
+	int lights = 0;
+	int assignments = 0;
+
+	//Most lights any one cluster has
+	int busiest = 0;
+};
+
+class CLightClusters
+{
+private:
+	//Grid size, must match the shaders (CLUSTER_X, CLUSTER_Y, CLUSTER_Z). X is a multiple of 4 for the SSE tests
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	//Binding points, must match the shaders
+	static const GLuint VIEW_BINDING = 1;
+	static const GLuint CLUSTER_BINDING = 7;
+
+	/// <summary>
+	/// Uniform block for finding a fragment's cluster (std140)
+	/// </summary>
+	struct ClusterView
+	{
+		//x, y = tiles per pixel, z, w = scale and bias from log(depth) to slice
+		glm::vec4 scale = glm::vec4(0.0f);
+
+		//xyz = camera forward, w = forward dot camera position, so depth = dot(forward, pos) - w
+		glm::vec4 forward = glm::vec4(0.0f);
+	};
+
+	//View space bounds of every cluster, one array per component so four clusters are tested at once.
+	//Depth is positive in front of the camera
+	static std::vector<float> m_minX;
+	static std::vector<float> m_minY;
+	static std::vector<float> m_minZ;
+	static std::vector<float> m_maxX;
+	static std::vector<float> m_maxY;
+	static std::vector<float> m_maxZ;
+
+	//Projection the bounds were made for
+	static glm::mat4 m_gridProjection;
+	static float m_near;
+	static float m_far;
+	static float m_tanHalfX;
+	static float m_tanHalfY;
+
+	//What the lists were last built from, nothing is rebuilt while these stay the same
+	static glm::mat4 m_builtView;
+	static int m_builtVersion;
+
+	//(cluster, light) pairs, then per cluster (first index, count) and the light indices they point into
+	static std::vector<glm::uvec2> m_pairs;
+	static std::vector<glm::uvec2> m_clusters;
+	static std::vector<GLuint> m_indices;
+
+	static GLuint m_clusterBuffer;
+	static GLsizeiptr m_clusterCapacity;
+	static GLuint m_viewBuffer;
+	static ClusterView m_view;
+
+	static ClusterStats m_stats;
+
+	static void BuildGrid(CCamera* _camera);
+	static int GetSlice(float _depth);
+	static void AssignLight(int _light, const glm::vec3& _viewPos, float _range);
+	static void Upload();
+
+public:
+	static void Build(CCamera* _camera);
+
+	static ClusterStats GetStats() { return m_stats; };
+};
@@ -1,18 +1,21 @@
 #include "CLightManager.h"
+#include "CGLState.h"
 
-const int CLightManager::MAX_POINT_LIGHTS;
-PointLight CLightManager::PointLights[MAX_POINT_LIGHTS];
+std::vector<PointLight> CLightManager::PointLights;
 
-const int CLightManager::MAX_SPHERES;
 
 DirectionalLight CLightManager::directionalLight = {
 	glm::vec3(-1,-1,-1),
-	glm::vec3(1,1,1),
 	0.1f,
+	glm::vec3(1,1,1),
 	0.5f
 };
 
-int CLightManager::currentLightNum = 0;
+GLuint CLightManager::m_lightBuffer = NULL;
+GLuint CLightManager::m_pointLightBuffer = NULL;
+GLsizeiptr CLightManager::m_pointLightCapacity = 0;
+bool CLightManager::m_lightsDirty = true;
+int CLightManager::m_version = 0;
 
 /// <summary>
 /// Add a light to the scene
@@ -21,65 +24,73 @@ int CLightManager::currentLightNum = 0;
 /// <param name="_col"></param>
 /// <param name="_ambientStrength"></param>
 /// <param name="_specularStrength"></param>
-/// <param name="_attenDist"></param>
+/// <param name="_attenDist"> bigger reaches further, the light's range is where its attenuation reaches RANGE_ATTENUATION</param>
 void CLightManager::AddLight(glm::vec3 _pos, glm::vec3 _col, float _ambientStrength, float _specularStrength, float _attenDist)
 {
-	if (currentLightNum < MAX_POINT_LIGHTS) {
-		PointLight _tempLight;
-		_tempLight.Position = _pos;
-		_tempLight.Colour = _col;
-		_tempLight.AmbientStrength = _ambientStrength;
-		_tempLight.SpecularStrength = _specularStrength;
-
-		_tempLight.AttenuationConstant = 1.0f;
-		_tempLight.AttenuationLinear = glm::pow(1.1f, -_attenDist + 3.0f);
-		_tempLight.AttenuationExponent = glm::pow(1.17f, -_attenDist + 10.0f);
-
-		PointLights[currentLightNum] = _tempLight;
-		currentLightNum++;
-	}
-	else {
-		std::cout << "ERROR: Too many lights being added";
-	}
+	PointLight _tempLight;
+	_tempLight.Position = _pos;
+	_tempLight.Colour = _col;
+	_tempLight.AmbientStrength = _ambientStrength;
+	_tempLight.SpecularStrength = _specularStrength;
+
+	_tempLight.AttenuationConstant = 1.0f;
+	_tempLight.AttenuationLinear = glm::pow(1.1f, -_attenDist + 3.0f);
+	_tempLight.AttenuationExponent = glm::pow(1.17f, -_attenDist + 10.0f);
+
+	//Solve constant + linear * d + exponent * d^2 = RANGE_ATTENUATION for d
+	float a = _tempLight.AttenuationExponent;
+	float b = _tempLight.AttenuationLinear;
+	float c = _tempLight.AttenuationConstant - RANGE_ATTENUATION;
+	_tempLight.Range = (-b + glm::sqrt(b * b - 4.0f * a * c)) / (2.0f * a);
+
+	PointLights.push_back(_tempLight);
+
+	m_lightsDirty = true;
+	m_version++;
 }
 
 /// <summary>
-/// Update all of the light uniforms
+/// Upload any light data that changed since last frame, and rebuild the shadow casters' tree if they moved.
+/// The blocks are shared by every lit program
 /// </summary>
-/// <param name="_program"></param>
-void CLightManager::UpdateUniforms(GLuint _program)
+void CLightManager::Update()
 {
-	glUseProgram(_program);
-
-	//Update all point lights
-	for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
-		std::string str = std::to_string(i);
-		const char* num = str.c_str();
-		glUniform3fv(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].Position")).c_str()), 1, glm::value_ptr(PointLights[i].Position));
-		glUniform3fv(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].Colour")).c_str()), 1, glm::value_ptr(PointLights[i].Colour));
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].AmbientStrength")).c_str()), PointLights[i].AmbientStrength);
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].SpecularStrength")).c_str()), PointLights[i].SpecularStrength);
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].AttenuationConstant")).c_str()), PointLights[i].AttenuationConstant);
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].AttenuationLinear")).c_str()), PointLights[i].AttenuationLinear);
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("PointLights[" + std::to_string(i) + "].AttenuationExponent")).c_str()), PointLights[i].AttenuationExponent);
+	if (m_lightBuffer == NULL) CreateBuffers();
+
+	if (m_lightsDirty) {
+		glNamedBufferSubData(m_lightBuffer, 0, sizeof(DirectionalLight), &directionalLight);
+		UploadPointLights();
+		m_lightsDirty = false;
 	}
 
-	//Update dir light
-	glUniform3fv(glGetUniformLocation(_program, "DirLight.Direction"), 1, glm::value_ptr(directionalLight.Direction));
-	glUniform3fv(glGetUniformLocation(_program, "DirLight.Colour"), 1, glm::value_ptr(directionalLight.Colour));
-	glUniform1f(glGetUniformLocation(_program, "DirLight.AmbientStrength"), directionalLight.AmbientStrength);
-	glUniform1f(glGetUniformLocation(_program, "DirLight.SpecularStrength"), directionalLight.SpecularStrength);
+	COccluderBVH::Update();
+}
 
-	//Update all sphere positions
-	for (int i = 0; i < MAX_SPHERES; i++) {
-		if (CObjectManager::GetShape("sphere" + std::to_string(i), false) == nullptr) continue;
+/// <summary>
+/// Create the directional light's uniform buffer and the point lights' storage buffer, and attach them to their binding points
+/// </summary>
+void CLightManager::CreateBuffers()
+{
+	glCreateBuffers(1, &m_lightBuffer);
+	glNamedBufferStorage(m_lightBuffer, sizeof(DirectionalLight), NULL, GL_DYNAMIC_STORAGE_BIT);
+	CGLState::BindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, m_lightBuffer);
 
-		glm::vec3 pos = CObjectManager::GetShape("sphere" + std::to_string(i))->GetPosition();
-		float rad = CObjectManager::GetShape("sphere" + std::to_string(i))->GetScale().x / 2;
+	glCreateBuffers(1, &m_pointLightBuffer);
+}
+
+/// <summary>
+/// Copy every point light to the storage buffer, growing it if there are more than it holds
+/// </summary>
+void CLightManager::UploadPointLights()
+{
+	GLsizeiptr size = PointLights.size() * sizeof(PointLight);
 
-		glUniform3fv(glGetUniformLocation(_program, ((std::string)("Spheres[" + std::to_string(i) + "].Position")).c_str()), 1, glm::value_ptr(pos));
-		glUniform1f(glGetUniformLocation(_program, ((std::string)("Spheres[" + std::to_string(i) + "].rad")).c_str()), rad);
+	if (size > m_pointLightCapacity || m_pointLightCapacity == 0) {
+		//Storage must not be empty, even with no lights
+		m_pointLightCapacity = (size * 2 > (GLsizeiptr)sizeof(PointLight) * 16 ? size * 2 : (GLsizeiptr)sizeof(PointLight) * 16);
+		glNamedBufferData(m_pointLightBuffer, m_pointLightCapacity, NULL, GL_DYNAMIC_DRAW);
+		CGLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_BINDING, m_pointLightBuffer);
 	}
 
-	glUseProgram(0);
+	if (size > 0) glNamedBufferSubData(m_pointLightBuffer, 0, size, PointLights.data());
 }
@@ -12,6 +12,7 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <glew.h>
 
@@ -19,47 +20,69 @@
 #include <gtc/type_ptr.hpp>
 
 #include "CObjectManager.h"
+#include "COccluderBVH.h"
+
+//Light data is uploaded as is, point lights to a std430 storage buffer and the directional light to a std140 uniform block.
+//Each vec3 is followed by a float to fill its 16 bytes, and the layouts must match the blocks in 3DLight_BlinnPhong.frag
 
 struct PointLight 
 {
 	glm::vec3 Position = glm::vec3();
-	glm::vec3 Colour = glm::vec3();
 	float AmbientStrength = 0;
+	glm::vec3 Colour = glm::vec3();
 	float SpecularStrength = 0;
 
 	float AttenuationConstant = 0;
 	float AttenuationLinear = 0;
 	float AttenuationExponent = 0;
+
+	//Distance where the light fades out, lights are only added to the clusters this reaches
+	float Range = 0;
 };
 
 struct DirectionalLight {
 	glm::vec3 Direction = glm::vec3();
-	glm::vec3 Colour = glm::vec3();
 	float AmbientStrength = 0;
+	glm::vec3 Colour = glm::vec3();
 	float SpecularStrength = 0;
 };
 
+static_assert(sizeof(PointLight) == 48, "PointLight must match std430 layout");
+static_assert(sizeof(DirectionalLight) == 32, "DirectionalLight must match std140 layout");
+
 class CLightManager
 {
 private:
-	static const int MAX_POINT_LIGHTS = 4;
+	//Attenuation at the edge of a light's range (it has faded to 1/256th)
+	static constexpr float RANGE_ATTENUATION = 256.0f;
 
-	static PointLight PointLights[MAX_POINT_LIGHTS];
+	static std::vector<PointLight> PointLights;
 
 	static DirectionalLight directionalLight;
 
-	static int currentLightNum;
+	//Binding points, must match the shaders
+	static const GLuint LIGHT_BINDING = 0;
+	static const GLuint POINT_LIGHT_BINDING = 6;
 
+	static GLuint m_lightBuffer;
+	static GLuint m_pointLightBuffer;
+	static GLsizeiptr m_pointLightCapacity;
 
-	static const int MAX_SPHERES = 20;
+	//Lights only get uploaded after they change, the version goes up with every change
+	static bool m_lightsDirty;
+	static int m_version;
+
+	static void CreateBuffers();
+	static void UploadPointLights();
 
 public:
 	static void AddLight(glm::vec3 _pos, glm::vec3 _col, float _ambientStrength, float _specularStrength, float _attenDist);
-	static void UpdateUniforms(GLuint _program);
+	static void Update();
 
-	static int GetMaxPointLights() { return MAX_POINT_LIGHTS; };
+	static int GetPointLightCount() { return (int)PointLights.size(); };
+	static int GetVersion() { return m_version; };
 
-	static PointLight* GetPointLights() { return PointLights; };
+	static const std::vector<PointLight>& GetPointLights() { return PointLights; };
 	static PointLight GetPointLight(int i) { return PointLights[i]; };
+	static DirectionalLight GetDirectionalLight() { return directionalLight; };
 };
-
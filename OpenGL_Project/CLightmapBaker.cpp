@@ -0,0 +1,624 @@
+#include "CLightmapBaker.h"
+#include "CObjectManager.h"
+#include "CLightManager.h"
+#include "CGLState.h"
+
+#include <cstring>
+#include <algorithm>
+
+std::string CLightmapBaker::m_cacheDirectory;
+std::map<std::string, CLightmapBaker::Lightmap> CLightmapBaker::m_lightmaps;
+GLuint CLightmapBaker::m_atlas = NULL;
+std::vector<CLightmapBaker::BakeTarget> CLightmapBaker::m_targets;
+std::vector<Sphere> CLightmapBaker::m_occluders;
+uint64_t CLightmapBaker::m_sceneHash = 0;
+uint64_t CLightmapBaker::m_lightHash = 0;
+bool CLightmapBaker::m_baked = false;
+LightmapStats CLightmapBaker::m_stats;
+
+//Changes whenever the bake or the lightmap cache file layout changes, so old files are ignored
+static const int LIGHTMAP_CACHE_VERSION = 2;
+static const char LIGHTMAP_CACHE_MAGIC[4] = { 'K', 'L', 'M', 'P' };
+
+/// <summary>
+/// FNV-1a, adds the bytes to a running hash
+/// </summary>
+/// <param name="_hash"></param>
+/// <param name="_data"></param>
+/// <param name="_size"></param>
+/// <returns></returns>
+static uint64_t HashBytes(uint64_t _hash, const void* _data, size_t _size)
+{
+	const unsigned char* bytes = (const unsigned char*)_data;
+	for (size_t i = 0; i < _size; i++) {
+		_hash ^= bytes[i];
+		_hash *= 1099511628211ull;
+	}
+	return _hash;
+}
+
+static const uint64_t HASH_START = 14695981039346656037ull;
+
+/// <summary>
+/// Keep baked lightmaps in a folder, named by the scene and light hashes, so later runs load them instead of baking
+/// </summary>
+/// <param name="_directory"> empty to turn the disk cache off</param>
+void CLightmapBaker::SetDiskCache(const std::string& _directory)
+{
+	m_cacheDirectory = _directory;
+
+	if (!m_cacheDirectory.empty()) {
+		if (m_cacheDirectory.back() != '/' && m_cacheDirectory.back() != '\\') m_cacheDirectory += '/';
+		CreateDirectoryA(m_cacheDirectory.c_str(), NULL);
+	}
+}
+
+/// <summary>
+/// Can the shape be given a lightmap: static, opaque, and a mesh with texture coords and normals.
+/// The mesh's texture coords (scaled to fit 0-1) must not overlap, each point on the surface gets its own texel
+/// </summary>
+/// <param name="_shape"></param>
+/// <returns></returns>
+bool CLightmapBaker::CanBake(CShape* _shape)
+{
+	return _shape != nullptr && _shape->IsStatic() && !_shape->m_orthoProject && _shape->GetRenderPass() == RenderPass::Opaque
+		&& _shape->GetMesh() != nullptr && _shape->GetMesh()->GetType() == VertType::Pos_Tex_Norm;
+}
+
+/// <summary>
+/// Find the static shapes, and bake (or load from the disk cache) their lightmaps if the shapes, static shadow casters or lights changed.
+/// Moving casters never cause a bake, their shadows come from the shadow maps
+/// </summary>
+void CLightmapBaker::Update()
+{
+	m_targets.clear();
+	m_occluders.clear();
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+
+		if (shape->IsStatic() && shape->IsShadowCaster() && shape->GetMesh() != nullptr) {
+			glm::vec4 bounds = shape->GetBoundingSphere();
+
+			Sphere sphere;
+			sphere.Position = glm::vec3(bounds);
+			sphere.rad = bounds.w;
+			m_occluders.push_back(sphere);
+		}
+
+		if (!CanBake(shape)) continue;
+
+		BakeTarget target;
+		target.name = &it->first;
+		target.shape = it->second;
+		m_targets.push_back(target);
+	}
+
+	uint64_t sceneHash = HashScene();
+	uint64_t lightHash = HashLights();
+
+	if (!m_baked || sceneHash != m_sceneHash || lightHash != m_lightHash) {
+		m_sceneHash = sceneHash;
+		m_lightHash = lightHash;
+		m_baked = true;
+
+		CGLState::DeleteTextures(1, &m_atlas);
+		m_atlas = NULL;
+		m_lightmaps.clear();
+
+		std::string path = GetCachePath();
+		if (path.empty() || !LoadCache(path)) {
+			Bake();
+			if (!path.empty()) SaveCache(path);
+		}
+
+		CreateAtlas();
+	}
+
+	//Shapes may have been remade since the bake, only values that changed are sent
+	ApplyUniforms();
+}
+
+/// <summary>
+/// Hash of everything the bake sees besides the lights: each static shape's name, transform and mesh, and the static casters' spheres
+/// </summary>
+/// <returns></returns>
+uint64_t CLightmapBaker::HashScene()
+{
+	uint64_t hash = HASH_START;
+
+	for (const BakeTarget& _target : m_targets) {
+		CShape* shape = _target.shape;
+		CMesh* mesh = shape->GetMesh();
+
+		shape->UpdateModelMat();
+		glm::mat4 model = shape->GetModel();
+
+		hash = HashBytes(hash, _target.name->data(), _target.name->size());
+		hash = HashBytes(hash, &model, sizeof(model));
+		hash = HashBytes(hash, mesh->GetVertices().data(), mesh->GetVertices().size() * sizeof(float));
+		hash = HashBytes(hash, mesh->GetIndices().data(), mesh->GetIndices().size() * sizeof(int));
+	}
+
+	hash = HashBytes(hash, m_occluders.data(), m_occluders.size() * sizeof(Sphere));
+
+	return hash;
+}
+
+/// <summary>
+/// Hash of the directional light and every point light
+/// </summary>
+/// <returns></returns>
+uint64_t CLightmapBaker::HashLights()
+{
+	DirectionalLight dirLight = CLightManager::GetDirectionalLight();
+	const std::vector<PointLight>& pointLights = CLightManager::GetPointLights();
+
+	uint64_t hash = HASH_START;
+	hash = HashBytes(hash, &dirLight, sizeof(DirectionalLight));
+	hash = HashBytes(hash, pointLights.data(), pointLights.size() * sizeof(PointLight));
+
+	return hash;
+}
+
+std::string CLightmapBaker::GetCachePath()
+{
+	if (m_cacheDirectory.empty() || m_targets.empty()) return "";
+
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx_%016llx.lightmap", (unsigned long long)m_sceneHash, (unsigned long long)m_lightHash);
+
+	return m_cacheDirectory + name;
+}
+
+/// <summary>
+/// Bake a lightmap for every static shape
+/// </summary>
+void CLightmapBaker::Bake()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	m_stats = LightmapStats();
+
+	for (const BakeTarget& _target : m_targets) {
+		Lightmap& lightmap = m_lightmaps[*_target.name];
+		BakeShape(_target.shape, lightmap);
+
+		m_stats.shapes++;
+		m_stats.texels += lightmap.resolution * lightmap.resolution;
+	}
+
+	m_stats.bakeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// <summary>
+/// Find the surface under every texel, then light them split across threads, and grow the charts to hide their edges
+/// </summary>
+/// <param name="_shape"></param>
+/// <param name="_lightmap"></param>
+void CLightmapBaker::BakeShape(CShape* _shape, Lightmap& _lightmap)
+{
+	std::vector<TexelSample> samples;
+	Rasterize(_shape, _lightmap, samples);
+
+	int resolution = _lightmap.resolution;
+	_lightmap.texels.assign(resolution * resolution, glm::vec4(0.0f));
+
+	std::atomic<int> next(0);
+
+	auto worker = [&]() {
+		for (int row = next++; row < resolution; row = next++) {
+			for (int x = 0; x < resolution; x++) {
+				int index = row * resolution + x;
+				if (!samples[index].covered) continue;
+
+				_lightmap.texels[index] = CalcLighting(samples[index].position, samples[index].normal);
+			}
+		}
+	};
+
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	if (threadCount > (unsigned int)resolution) threadCount = (unsigned int)resolution;
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < threadCount; i++) {
+		threads.push_back(std::thread(worker));
+	}
+
+	//This thread helps too
+	worker();
+
+	for (std::thread& _thread : threads) {
+		_thread.join();
+	}
+
+	Dilate(_lightmap, samples);
+}
+
+/// <summary>
+/// Pick the lightmap's resolution from the shape's world area and its transform from the mesh's texture coords,
+/// then rasterize each triangle in lightmap space to find the world position and normal at every texel centre
+/// </summary>
+/// <param name="_shape"></param>
+/// <param name="_lightmap"></param>
+/// <param name="_samples"></param>
+void CLightmapBaker::Rasterize(CShape* _shape, Lightmap& _lightmap, std::vector<TexelSample>& _samples)
+{
+	CMesh* mesh = _shape->GetMesh();
+	const std::vector<float>& vertices = mesh->GetVertices();
+	const std::vector<int>& indices = mesh->GetIndices();
+	size_t stride = (size_t)mesh->GetStride();
+
+	_shape->UpdateModelMat();
+	glm::mat4 model = _shape->GetModel();
+	glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
+
+	//Layout is position (3), texture coords (2), normal (3)
+	auto position = [&](int _vertex) { size_t i = _vertex * stride; return glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]); };
+	auto texCoords = [&](int _vertex) { size_t i = _vertex * stride + 3; return glm::vec2(vertices[i], vertices[i + 1]); };
+	auto normal = [&](int _vertex) { size_t i = _vertex * stride + 5; return glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]); };
+
+	//Texture coords may tile (the floor's go to 50), so they are scaled to fit the lightmap
+	glm::vec2 uvMin = glm::vec2(FLT_MAX);
+	glm::vec2 uvMax = glm::vec2(-FLT_MAX);
+	for (size_t i = 0; i + stride <= vertices.size(); i += stride) {
+		glm::vec2 uv = glm::vec2(vertices[i + 3], vertices[i + 4]);
+		uvMin = glm::min(uvMin, uv);
+		uvMax = glm::max(uvMax, uv);
+	}
+
+	glm::vec2 uvSize = uvMax - uvMin;
+	glm::vec2 scale = glm::vec2(uvSize.x > 0.0f ? 1.0f / uvSize.x : 1.0f, uvSize.y > 0.0f ? 1.0f / uvSize.y : 1.0f);
+	_lightmap.transform = glm::vec4(scale, -uvMin * scale);
+
+	float area = 0.0f;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		glm::vec3 a = glm::vec3(model * glm::vec4(position(indices[i]), 1.0f));
+		glm::vec3 b = glm::vec3(model * glm::vec4(position(indices[i + 1]), 1.0f));
+		glm::vec3 c = glm::vec3(model * glm::vec4(position(indices[i + 2]), 1.0f));
+		area += glm::length(glm::cross(b - a, c - a)) * 0.5f;
+	}
+
+	int resolution = MIN_RESOLUTION;
+	while (resolution < MAX_RESOLUTION && (float)resolution < glm::sqrt(area) * TEXELS_PER_UNIT) {
+		resolution *= 2;
+	}
+	_lightmap.resolution = resolution;
+
+	_samples.assign(resolution * resolution, TexelSample());
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		int corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+		glm::vec2 t[3];
+		for (int j = 0; j < 3; j++) {
+			glm::vec2 uv = texCoords(corners[j]);
+			t[j] = (uv * glm::vec2(_lightmap.transform) + glm::vec2(_lightmap.transform.z, _lightmap.transform.w)) * (float)resolution;
+		}
+
+		float triangleArea = (t[1].x - t[0].x) * (t[2].y - t[0].y) - (t[2].x - t[0].x) * (t[1].y - t[0].y);
+		if (glm::abs(triangleArea) < 1e-8f) continue;
+
+		glm::vec2 min = glm::min(t[0], glm::min(t[1], t[2]));
+		glm::vec2 max = glm::max(t[0], glm::max(t[1], t[2]));
+		int startX = glm::clamp((int)glm::floor(min.x), 0, resolution - 1);
+		int startY = glm::clamp((int)glm::floor(min.y), 0, resolution - 1);
+		int endX = glm::clamp((int)glm::ceil(max.x), 0, resolution - 1);
+		int endY = glm::clamp((int)glm::ceil(max.y), 0, resolution - 1);
+
+		for (int y = startY; y <= endY; y++) {
+			for (int x = startX; x <= endX; x++) {
+				glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f);
+
+				//Barycentric weights of the texel centre, all positive inside (either winding)
+				float w0 = ((t[1].x - p.x) * (t[2].y - p.y) - (t[2].x - p.x) * (t[1].y - p.y)) / triangleArea;
+				float w1 = ((t[2].x - p.x) * (t[0].y - p.y) - (t[0].x - p.x) * (t[2].y - p.y)) / triangleArea;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < -1e-4f || w1 < -1e-4f || w2 < -1e-4f) continue;
+
+				glm::vec3 local = position(corners[0]) * w0 + position(corners[1]) * w1 + position(corners[2]) * w2;
+				glm::vec3 localNormal = normal(corners[0]) * w0 + normal(corners[1]) * w1 + normal(corners[2]) * w2;
+
+				TexelSample& sample = _samples[y * resolution + x];
+				sample.position = glm::vec3(model * glm::vec4(local, 1.0f));
+				sample.normal = glm::normalize(normalMat * localNormal);
+				sample.covered = true;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Fill empty texels next to covered ones with the average of their covered neighbours, one ring per pass
+/// </summary>
+/// <param name="_lightmap"></param>
+/// <param name="_samples"></param>
+void CLightmapBaker::Dilate(Lightmap& _lightmap, std::vector<TexelSample>& _samples)
+{
+	int resolution = _lightmap.resolution;
+	std::vector<bool> covered(_samples.size());
+
+	for (int pass = 0; pass < DILATE_PASSES; pass++) {
+		for (size_t i = 0; i < _samples.size(); i++) {
+			covered[i] = _samples[i].covered;
+		}
+
+		for (int y = 0; y < resolution; y++) {
+			for (int x = 0; x < resolution; x++) {
+				int index = y * resolution + x;
+				if (covered[index]) continue;
+
+				glm::vec4 sum = glm::vec4(0.0f);
+				int count = 0;
+
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						int nx = x + dx;
+						int ny = y + dy;
+						if (nx < 0 || ny < 0 || nx >= resolution || ny >= resolution) continue;
+						if (!covered[ny * resolution + nx]) continue;
+
+						sum += _lightmap.texels[ny * resolution + nx];
+						count++;
+					}
+				}
+
+				if (count == 0) continue;
+
+				_lightmap.texels[index] = sum / (float)count;
+				_samples[index].covered = true;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// The view independent part of CalcDirLight and CalcPointLight (Lighting.glsl): ambient, and diffuse with sphere shadows.
+/// Specular depends on the view so it is left out, alpha holds the directional light's visibility so the shader can still add its highlight.
+/// Every point light is shadowed here, not just the ones with cube maps
+/// </summary>
+/// <param name="_position"></param>
+/// <param name="_normal"></param>
+/// <returns></returns>
+glm::vec4 CLightmapBaker::CalcLighting(const glm::vec3& _position, const glm::vec3& _normal)
+{
+	glm::vec3 origin = _position + _normal * RAY_OFFSET;
+
+	DirectionalLight dirLight = CLightManager::GetDirectionalLight();
+	glm::vec3 lightDir = glm::normalize(dirLight.Direction);
+
+	float visibility = TraceOccluders(origin, -lightDir, 1000.0f, true);
+	float diffuseStrength = glm::max(glm::dot(_normal, -lightDir), 0.0f);
+
+	glm::vec3 light = dirLight.AmbientStrength * dirLight.Colour + diffuseStrength * dirLight.Colour * visibility;
+
+	for (const PointLight& _light : CLightManager::GetPointLights()) {
+		glm::vec3 toLight = _light.Position - _position;
+		float distance = glm::length(toLight);
+
+		//Faded out, or too close to the light (the shader drops those too)
+		if (distance >= _light.Range || distance <= 0.0f) continue;
+
+		float attenuation = _light.AttenuationConstant + _light.AttenuationLinear * distance + _light.AttenuationExponent * distance * distance;
+		if (attenuation < 1.0f) continue;
+
+		glm::vec3 dir = toLight / distance;
+		float pointDiffuse = glm::max(glm::dot(_normal, dir), 0.0f);
+		float shadow = (pointDiffuse > 0.0f ? TraceOccluders(origin, dir, distance, false) : 1.0f);
+
+		glm::vec3 output = (_light.AmbientStrength * _light.Colour + pointDiffuse * _light.Colour * shadow) / attenuation;
+
+		float rangeFade = glm::clamp(1.0f - glm::pow(distance / _light.Range, 4.0f), 0.0f, 1.0f);
+		light += output * rangeFade * rangeFade;
+	}
+
+	return glm::vec4(light, visibility);
+}
+
+/// <summary>
+/// Same sphere test as TraceOccluders in Lighting.glsl, over the static casters only (there are few, so no tree).
+/// How much light gets from _origin along _dir (normalized) without passing through a sphere, within _maxDistance
+/// </summary>
+/// <param name="_origin"></param>
+/// <param name="_dir"></param>
+/// <param name="_maxDistance"></param>
+/// <param name="_soft"> darken less the further the sphere is, instead of fully dark</param>
+/// <returns></returns>
+float CLightmapBaker::TraceOccluders(const glm::vec3& _origin, const glm::vec3& _dir, float _maxDistance, bool _soft)
+{
+	float visibility = 1.0f;
+
+	for (const Sphere& _sphere : m_occluders) {
+		glm::vec3 toSphere = _sphere.Position - _origin;
+
+		//Closest point of the ray to the sphere's centre must be ahead, and within the radius
+		float along = glm::dot(toSphere, _dir);
+		if (along <= 0.0f || along > _maxDistance) continue;
+		if (glm::length(toSphere - _dir * along) >= _sphere.rad) continue;
+
+		if (!_soft) return 0.0f;
+		visibility *= glm::min(glm::length(toSphere) / 30.0f, 1.0f);
+	}
+
+	return visibility;
+}
+
+/// <summary>
+/// Load the lightmaps saved by SaveCache, the file name already matches the scene and lights
+/// </summary>
+/// <param name="_path"></param>
+/// <returns> false if there is no usable cache, nothing is changed</returns>
+bool CLightmapBaker::LoadCache(const std::string& _path)
+{
+	std::ifstream file(_path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4] = { 0 };
+	int version = 0;
+	uint64_t sceneHash = 0;
+	uint64_t lightHash = 0;
+	int count = 0;
+
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&sceneHash, sizeof(sceneHash));
+	file.read((char*)&lightHash, sizeof(lightHash));
+	file.read((char*)&count, sizeof(count));
+
+	if (!file || std::memcmp(magic, LIGHTMAP_CACHE_MAGIC, sizeof(magic)) != 0 || version != LIGHTMAP_CACHE_VERSION) return false;
+	if (sceneHash != m_sceneHash || lightHash != m_lightHash || count != (int)m_targets.size()) return false;
+
+	std::map<std::string, Lightmap> lightmaps;
+	LightmapStats stats;
+	stats.fromCache = true;
+
+	for (int i = 0; i < count; i++) {
+		int nameLength = 0;
+		file.read((char*)&nameLength, sizeof(nameLength));
+		if (!file || nameLength <= 0 || nameLength > 256) return false;
+
+		std::string name(nameLength, '\0');
+		file.read(&name[0], nameLength);
+
+		Lightmap& lightmap = lightmaps[name];
+		file.read((char*)&lightmap.resolution, sizeof(lightmap.resolution));
+		file.read((char*)&lightmap.transform, sizeof(lightmap.transform));
+		if (!file || lightmap.resolution < MIN_RESOLUTION || lightmap.resolution > MAX_RESOLUTION) return false;
+
+		lightmap.texels.resize(lightmap.resolution * lightmap.resolution);
+		file.read((char*)lightmap.texels.data(), lightmap.texels.size() * sizeof(glm::vec4));
+		if (!file) return false;
+
+		stats.shapes++;
+		stats.texels += lightmap.resolution * lightmap.resolution;
+	}
+
+	m_lightmaps.swap(lightmaps);
+	m_stats = stats;
+	return true;
+}
+
+/// <summary>
+/// Save every lightmap so later runs with the same scene and lights skip the bake
+/// </summary>
+/// <param name="_path"></param>
+void CLightmapBaker::SaveCache(const std::string& _path)
+{
+	std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cout << "ERROR: Could not write lightmap cache " << _path << "." << std::endl;
+		return;
+	}
+
+	int count = (int)m_lightmaps.size();
+
+	file.write(LIGHTMAP_CACHE_MAGIC, sizeof(LIGHTMAP_CACHE_MAGIC));
+	file.write((const char*)&LIGHTMAP_CACHE_VERSION, sizeof(LIGHTMAP_CACHE_VERSION));
+	file.write((const char*)&m_sceneHash, sizeof(m_sceneHash));
+	file.write((const char*)&m_lightHash, sizeof(m_lightHash));
+	file.write((const char*)&count, sizeof(count));
+
+	for (std::map<std::string, Lightmap>::iterator it = m_lightmaps.begin(); it != m_lightmaps.end(); it++) {
+		const Lightmap& lightmap = it->second;
+		int nameLength = (int)it->first.size();
+
+		file.write((const char*)&nameLength, sizeof(nameLength));
+		file.write(it->first.data(), nameLength);
+		file.write((const char*)&lightmap.resolution, sizeof(lightmap.resolution));
+		file.write((const char*)&lightmap.transform, sizeof(lightmap.transform));
+		file.write((const char*)lightmap.texels.data(), lightmap.texels.size() * sizeof(glm::vec4));
+	}
+}
+
+/// <summary>
+/// Pack every lightmap into one texture (half floats, lighting can go over 1), biggest first in rows.
+/// Each is surrounded by copies of its edge texels, which is what clamping to its edge used to give
+/// </summary>
+void CLightmapBaker::CreateAtlas()
+{
+	if (m_lightmaps.empty()) return;
+
+	std::vector<Lightmap*> lightmaps;
+	int area = 0;
+	int largest = 0;
+	for (std::map<std::string, Lightmap>::iterator it = m_lightmaps.begin(); it != m_lightmaps.end(); it++) {
+		int size = it->second.resolution + ATLAS_GUTTER * 2;
+		lightmaps.push_back(&it->second);
+		area += size * size;
+		largest = glm::max(largest, size);
+	}
+	std::sort(lightmaps.begin(), lightmaps.end(), [](const Lightmap* _a, const Lightmap* _b) { return _a->resolution > _b->resolution; });
+
+	//Roughly square, rows are added until everything fits
+	int width = MIN_RESOLUTION;
+	while (width < largest || width * width < area) width *= 2;
+
+	std::vector<glm::ivec2> origins(lightmaps.size());
+	int x = 0;
+	int y = 0;
+	int rowHeight = 0;
+	for (size_t i = 0; i < lightmaps.size(); i++) {
+		int size = lightmaps[i]->resolution + ATLAS_GUTTER * 2;
+		if (x + size > width) {
+			x = 0;
+			y += rowHeight;
+			rowHeight = 0;
+		}
+
+		origins[i] = glm::ivec2(x, y);
+		x += size;
+		rowHeight = glm::max(rowHeight, size);
+	}
+	int height = y + rowHeight;
+
+	std::vector<glm::vec4> texels(width * height, glm::vec4(0.0f));
+	glm::vec2 atlasSize((float)width, (float)height);
+
+	for (size_t i = 0; i < lightmaps.size(); i++) {
+		Lightmap& lightmap = *lightmaps[i];
+		int resolution = lightmap.resolution;
+		glm::ivec2 origin = origins[i] + ATLAS_GUTTER;
+
+		for (int row = -ATLAS_GUTTER; row < resolution + ATLAS_GUTTER; row++) {
+			int sourceRow = glm::clamp(row, 0, resolution - 1);
+
+			for (int column = -ATLAS_GUTTER; column < resolution + ATLAS_GUTTER; column++) {
+				int sourceColumn = glm::clamp(column, 0, resolution - 1);
+				texels[(origin.y + row) * width + origin.x + column] = lightmap.texels[sourceRow * resolution + sourceColumn];
+			}
+		}
+
+		glm::vec2 scale = glm::vec2((float)resolution) / atlasSize;
+		glm::vec2 offset = glm::vec2(origin) / atlasSize;
+		lightmap.atlasTransform = glm::vec4(glm::vec2(lightmap.transform) * scale, glm::vec2(lightmap.transform.z, lightmap.transform.w) * scale + offset);
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_atlas);
+	glTextureStorage2D(m_atlas, 1, GL_RGBA16F, width, height);
+	glTextureSubImage2D(m_atlas, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, texels.data());
+
+	glTextureParameteri(m_atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/// <summary>
+/// Bind the atlas to its own unit, and give every static shape the transform to its place in it, read by 3DLight_Baked.frag.
+/// The atlas stays out of the shapes' uniforms, so it isn't bound per draw and doesn't split their batches
+/// </summary>
+void CLightmapBaker::ApplyUniforms()
+{
+	static const std::string transformName = "LightmapTransform";
+
+	CGLState::BindTexture(LIGHTMAP_UNIT, GL_TEXTURE_2D, m_atlas);
+
+	for (const BakeTarget& _target : m_targets) {
+		std::map<std::string, Lightmap>::iterator it = m_lightmaps.find(*_target.name);
+		if (it == m_lightmaps.end()) continue;
+
+		_target.shape->GetUniforms().SetVec4(transformName, it->second.atlasTransform);
+	}
+}
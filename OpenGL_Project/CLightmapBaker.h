@@ -0,0 +1,139 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CLightmapBaker.h
+// Description : Bakes the lighting of static shapes into textures on the CPU, so they don't light every pixel each frame
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <glew.h>
+#include <glm.hpp>
+#include <Windows.h>
+
+#include "CShape.h"
+#include "COccluderBVH.h"
+
+/// <summary>
+/// What the last bake did
+/// </summary>
+struct LightmapStats
+{
+	int shapes = 0;
+	int texels = 0;
+
+	//Time spent baking (0 if it came from the disk cache)
+	float bakeMs = 0.0f;
+	bool fromCache = false;
+};
+
+class CLightmapBaker
+{
+private:
+	//Lightmap texels per world unit along each side, the resolution is rounded up to a power of two and clamped
+	static constexpr float TEXELS_PER_UNIT = 4.0f;
+	static const int MIN_RESOLUTION = 16;
+	static const int MAX_RESOLUTION = 1024;
+
+	//Rings of empty texels filled in around each chart, so filtering at the edges doesn't pull in black
+	static const int DILATE_PASSES = 2;
+
+	//Rays start this far off the surface so they don't hit what they started on
+	static constexpr float RAY_OFFSET = 0.01f;
+
+	//Every lightmap is packed into one atlas bound here, must match 3DLight_Baked.frag
+	static const GLuint LIGHTMAP_UNIT = 21;
+
+	//Texels copied out from each lightmap's edge around it in the atlas, so filtering doesn't pull in its neighbours
+	static const int ATLAS_GUTTER = 1;
+
+	/// <summary>
+	/// One static shape's baked lighting, rgb = ambient and diffuse from every light, a = directional light visibility.
+	/// Only static casters shadow the bake, moving ones are added at runtime from the shadow maps (3DLight_Baked.frag)
+	/// </summary>
+	struct Lightmap
+	{
+		int resolution = 0;
+
+		//xy scales and zw offsets the mesh's texture coords into the lightmap
+		glm::vec4 transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+		std::vector<glm::vec4> texels;
+
+		//transform followed by the lightmap's place in the atlas, what the shader is given
+		glm::vec4 atlasTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	};
+
+	/// <summary>
+	/// The surface point at a texel's centre, found by rasterizing the mesh in lightmap space
+	/// </summary>
+	struct TexelSample
+	{
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		bool covered = false;
+	};
+
+	/// <summary>
+	/// A shape that can be baked, and its name in the object manager (lightmaps are kept by name, so they survive a reset)
+	/// </summary>
+	struct BakeTarget
+	{
+		const std::string* name = nullptr;
+		CShape* shape = nullptr;
+	};
+
+	static std::string m_cacheDirectory;
+
+	static std::map<std::string, Lightmap> m_lightmaps;
+	static GLuint m_atlas;
+
+	//Shapes found this frame
+	static std::vector<BakeTarget> m_targets;
+
+	//Bounding spheres of the static shadow casters found this frame, the only occluders the bake traces
+	static std::vector<Sphere> m_occluders;
+
+	//What the lightmaps were made from, nothing is baked again while these stay the same
+	static uint64_t m_sceneHash;
+	static uint64_t m_lightHash;
+	static bool m_baked;
+
+	static LightmapStats m_stats;
+
+	static uint64_t HashScene();
+	static uint64_t HashLights();
+	static std::string GetCachePath();
+
+	static void Bake();
+	static void BakeShape(CShape* _shape, Lightmap& _lightmap);
+	static void Rasterize(CShape* _shape, Lightmap& _lightmap, std::vector<TexelSample>& _samples);
+	static void Dilate(Lightmap& _lightmap, std::vector<TexelSample>& _samples);
+	static glm::vec4 CalcLighting(const glm::vec3& _position, const glm::vec3& _normal);
+	static float TraceOccluders(const glm::vec3& _origin, const glm::vec3& _dir, float _maxDistance, bool _soft);
+
+	static bool LoadCache(const std::string& _path);
+	static void SaveCache(const std::string& _path);
+	static void CreateAtlas();
+	static void ApplyUniforms();
+
+public:
+	static void SetDiskCache(const std::string& _directory);
+	static void Update();
+
+	static bool CanBake(CShape* _shape);
+
+	static LightmapStats GetStats() { return m_stats; };
+};
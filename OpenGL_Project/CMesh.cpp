@@ -1,69 +1,87 @@
 #include "CMesh.h"
+#include "CGeometryArena.h"
+#include "CGLState.h"
 
 std::map<std::string, CMesh*> CMesh::meshMap;
+int CMesh::meshCount = 0;
 
 CMesh::CMesh(VertType _type, std::vector<float> _vertices, std::vector<int> _indices, bool defaultBind = true) {
 	type = _type;
+	m_id = ++meshCount;
 	m_VertexArray.vertices = _vertices;
 	m_VertexArray.indices = _indices;
 
 	GenBindVerts();
+	CalculateBounds();
 }
 
 /// <summary>
-/// Bind all verts to buffers
+/// Copy all verts into the shared geometry arena for this vertex format
 /// </summary>
 void CMesh::GenBindVerts()
 {
-	glGenVertexArrays(1, &m_VAO);
-	glBindVertexArray(m_VAO);
-
-	//Gen EBO 
-	glGenBuffers(1, &m_EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-	int* ind = &m_VertexArray.indices[0];
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_VertexArray.indices.size() * sizeof(int), ind, GL_DYNAMIC_DRAW);
-
-	//Gen VBO 
-	glGenBuffers(1, &m_VBO);
-	//copy our vertices array in a buffer for OpenGL to use
-	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-	float* verts = &m_VertexArray.vertices[0];
-	glBufferData(GL_ARRAY_BUFFER, m_VertexArray.vertices.size() * sizeof(float), verts, GL_DYNAMIC_DRAW);
-
-	//Set the vertex attributes pointers (How to interperet Vertex Data)
+	ArenaAllocation allocation = CGeometryArena::Allocate(type, m_VertexArray.vertices, m_VertexArray.indices);
+
+	m_baseVertex = allocation.baseVertex;
+	m_firstIndex = allocation.firstIndex;
+	m_indexCount = allocation.indexCount;
+}
+
+/// <summary>
+/// Find the box around every vertex position, and a sphere around the box centre that holds them all
+/// </summary>
+void CMesh::CalculateBounds()
+{
+	size_t stride = (size_t)GetStride();
+
+	const std::vector<float>& vertices = m_VertexArray.vertices;
+	if (vertices.size() < 3) return;
+
+	m_boundsMin = glm::vec3(vertices[0], vertices[1], vertices[2]);
+	m_boundsMax = m_boundsMin;
+
+	for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+		glm::vec3 position = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]);
+		m_boundsMin = glm::min(m_boundsMin, position);
+		m_boundsMax = glm::max(m_boundsMax, position);
+	}
+
+	//Furthest vertex from the centre, tighter than half the box diagonal
+	m_sphereCentre = (m_boundsMin + m_boundsMax) / 2.0f;
+	float radiusSquared = 0.0f;
+
+	for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+		glm::vec3 offset = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]) - m_sphereCentre;
+		float distanceSquared = glm::dot(offset, offset);
+		if (distanceSquared > radiusSquared) radiusSquared = distanceSquared;
+	}
+
+	m_sphereRadius = sqrtf(radiusSquared);
+}
+
+/// <summary>
+/// Floats per vertex for this mesh's vertex format
+/// </summary>
+/// <returns></returns>
+int CMesh::GetStride()
+{
 	switch (type)
 	{
 	case VertType::Pos_Col_Tex:
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		break;
-
 	case VertType::Pos_Tex_Norm:
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(5 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		break;
+		return 8;
 
 	case VertType::Pos:
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (void*)0);
-		glEnableVertexAttribArray(0);
-		break;
-
-	default:
-		break;
+		return 3;
 	}
 
-	
+	return 8;
 }
 
+GLuint CMesh::GetVBO() { return CGeometryArena::GetVBO(type); }
+GLuint CMesh::GetVAO() { return CGeometryArena::GetVAO(type); }
+GLuint CMesh::GetEBO() { return CGeometryArena::GetEBO(type); }
+
 /// <summary>
 /// Creates new mesh
 /// </summary>
@@ -255,9 +273,19 @@ CMesh* CMesh::GetMesh(std::string _name, bool* _doesExist)
 /// <summary>
 /// Render specific mesh
 /// </summary>
-void CMesh::Render()
+/// <param name="_drawID"> index of the object's data in the transform ring</param>
+void CMesh::Render(int _drawID)
+{
+	RenderInstanced(1, _drawID);
+}
+
+/// <summary>
+/// Render many copies of the mesh in one call, shaders read each copy's data from the transform ring
+/// </summary>
+/// <param name="_count"> how many instances to draw</param>
+/// <param name="_baseInstance"> index of the first instance's data in the transform ring</param>
+void CMesh::RenderInstanced(int _count, int _baseInstance)
 {
-	glBindVertexArray(GetVAO());
-	glDrawElements(GL_TRIANGLES, GetIndices().size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	CGLState::BindVertexArray(GetVAO());
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, (void*)(m_firstIndex * sizeof(GLuint)), _count, m_baseVertex, _baseInstance);
 }
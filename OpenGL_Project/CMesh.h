@@ -14,6 +14,7 @@
 #include <map>
 #include <string>
 #include <glew.h>
+#include <glm.hpp>
 #include <iostream>
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -35,16 +36,28 @@ private:
 
 	static std::map<std::string, CMesh*> meshMap;
 
+	//Used to give each mesh a small unique id (for render sorting)
+	static int meshCount;
+	int m_id = 0;
+
 	void GenBindVerts();
+	void CalculateBounds();
 
 	CVertexArray m_VertexArray;
 
-	GLuint m_VBO = NULL;
-	GLuint m_VAO = NULL;
-	GLuint m_EBO = NULL;
-
 	VertType type;
 
+	//Location of this mesh in the shared geometry arena
+	GLint m_baseVertex = 0;
+	GLuint m_firstIndex = 0;
+	GLsizei m_indexCount = 0;
+
+	//Local space bounds of the vertex positions, worked out once on creation
+	glm::vec3 m_boundsMin = glm::vec3(0.0f);
+	glm::vec3 m_boundsMax = glm::vec3(0.0f);
+	glm::vec3 m_sphereCentre = glm::vec3(0.0f);
+	float m_sphereRadius = 0.0f;
+
 public:
 
 	static void NewCMesh(std::string _name, VertType _type, std::vector<float> _vertices, std::vector<int> _indices);
@@ -53,13 +66,28 @@ public:
 
 	static CMesh* GetMesh(std::string _name, bool* _doesExist = nullptr);
 
-	GLuint GetVBO() { return m_VBO; };
-	GLuint GetVAO() { return m_VAO; };
-	GLuint GetEBO() { return m_EBO; };
+	GLuint GetVBO();
+	GLuint GetVAO();
+	GLuint GetEBO();
+	int GetID() { return m_id; };
+	VertType GetType() { return type; };
+
+	GLint GetBaseVertex() { return m_baseVertex; };
+	GLuint GetFirstIndex() { return m_firstIndex; };
+	GLsizei GetIndexCount() { return m_indexCount; };
+
+	glm::vec3 GetBoundsMin() { return m_boundsMin; };
+	glm::vec3 GetBoundsMax() { return m_boundsMax; };
+	glm::vec3 GetSphereCentre() { return m_sphereCentre; };
+	float GetSphereRadius() { return m_sphereRadius; };
+
+	const std::vector<float>& GetVertices() { return m_VertexArray.vertices; };
+	const std::vector<int>& GetIndices() { return m_VertexArray.indices; };
 
-	std::vector<float> GetVertices() { return m_VertexArray.vertices; };
-	std::vector<int> GetIndices() { return m_VertexArray.indices; };
+	//Floats per vertex, position is always the first 3
+	int GetStride();
 
-	void Render();
+	void Render(int _drawID = 0);
+	void RenderInstanced(int _count, int _baseInstance);
 };
 
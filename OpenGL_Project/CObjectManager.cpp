@@ -1,6 +1,9 @@
 #include "CObjectManager.h"
+#include "CRenderQueue.h"
+#include "CSceneBVH.h"
 
 std::map<std::string, CShape*> CObjectManager::m_shapes;
+int CObjectManager::m_generation = 0;
 
 /// <summary>
 /// Add new shape to list with name
@@ -10,10 +13,13 @@ std::map<std::string, CShape*> CObjectManager::m_shapes;
 void CObjectManager::AddShape(std::string _name, CShape* _shape)
 {
 	if (CObjectManager::m_shapes[_name]) {
+		CSceneBVH::Remove(CObjectManager::m_shapes[_name]);
 		delete CObjectManager::m_shapes[_name];
 	}
 
 	CObjectManager::m_shapes[_name] = _shape;
+	CSceneBVH::Insert(_shape);
+	m_generation++;
 }
 
 /// <summary>
@@ -27,17 +33,23 @@ void CObjectManager::UpdateAll(float _deltaTime, float _currentTime)
 	{
 		it->second->Update(_deltaTime, _currentTime);
 	}
+
+	//Move shapes that left their box in the scene tree
+	CSceneBVH::Refit();
 }
 
 /// <summary>
-/// Render all shapes
+/// Render all shapes, sorted by state through the render queue
 /// </summary>
-void CObjectManager::RenderAll()
+/// <param name="_camera"> used for depth sorting</param>
+void CObjectManager::RenderAll(CCamera* _camera)
 {
 	for (std::map<std::string, CShape*>::iterator it = m_shapes.begin(); it != m_shapes.end(); it++)
 	{
-		it->second->Render();
+		CRenderQueue::Submit(it->second);
 	}
+
+	CRenderQueue::Flush(_camera);
 }
 
 void CObjectManager::DeleteAll()
@@ -50,6 +62,8 @@ void CObjectManager::DeleteAll()
 		delete _shape.second;
 	}
 	m_shapes.clear();
+	CSceneBVH::Clear();
+	m_generation++;
 }
 
 /// <summary>
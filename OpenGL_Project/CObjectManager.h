@@ -21,12 +21,17 @@ private:
 
 	static std::map<std::string, CShape*> m_shapes;
 
+	//Changes whenever shapes are added or removed, so cached shape pointers know to look up again
+	static int m_generation;
+
 public:
 	static void AddShape(std::string _name, CShape* _shape);
 	static void UpdateAll(float _deltaTime, float _currentTime);
-	static void RenderAll();
+	static void RenderAll(CCamera* _camera);
 	static void DeleteAll();
 
 	static CShape* GetShape(std::string _name, bool errorLog = true);
+	static int GetGeneration() { return m_generation; };
+	static const std::map<std::string, CShape*>& GetShapes() { return m_shapes; };
 };
 
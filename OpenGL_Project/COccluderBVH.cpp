@@ -0,0 +1,133 @@
+#include "COccluderBVH.h"
+#include "CObjectManager.h"
+#include "CGLState.h"
+
+std::vector<Sphere> COccluderBVH::m_gathered;
+std::vector<Sphere> COccluderBVH::m_built;
+std::vector<Sphere> COccluderBVH::m_spheres;
+std::vector<OccluderNode> COccluderBVH::m_nodes;
+GLuint COccluderBVH::m_nodeBuffer = NULL;
+GLuint COccluderBVH::m_sphereBuffer = NULL;
+GLsizeiptr COccluderBVH::m_nodeCapacity = 0;
+GLsizeiptr COccluderBVH::m_sphereCapacity = 0;
+
+/// <summary>
+/// Gather the bounding spheres of every shadow casting shape, and rebuild and upload the tree if any moved,
+/// changed size, or were added or removed
+/// </summary>
+void COccluderBVH::Update()
+{
+	m_gathered.clear();
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+		if (!shape->IsShadowCaster() || shape->GetMesh() == nullptr) continue;
+
+		glm::vec4 bounds = shape->GetBoundingSphere();
+
+		Sphere sphere;
+		sphere.Position = glm::vec3(bounds);
+		sphere.rad = bounds.w;
+		m_gathered.push_back(sphere);
+	}
+
+	//Buffers always exist, even with nothing in them, so the shaders can read the node count
+	if (m_nodeBuffer != NULL && m_gathered == m_built) return;
+
+	m_built.swap(m_gathered);
+
+	m_spheres = m_built;
+	m_nodes.clear();
+	if (!m_spheres.empty()) Build(0, (int)m_spheres.size());
+
+	Upload();
+}
+
+/// <summary>
+/// Make a node around a run of spheres, splitting it at the median of its longest axis until it fits in a leaf.
+/// Nodes are written depth first, so a branch's left child is the next node
+/// </summary>
+/// <param name="_first"></param>
+/// <param name="_count"></param>
+/// <returns> index of the node</returns>
+int COccluderBVH::Build(int _first, int _count)
+{
+	int index = (int)m_nodes.size();
+	m_nodes.push_back(OccluderNode());
+
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+	glm::vec3 centreMin = glm::vec3(FLT_MAX);
+	glm::vec3 centreMax = glm::vec3(-FLT_MAX);
+
+	for (int i = _first; i < _first + _count; i++) {
+		const Sphere& sphere = m_spheres[i];
+
+		min = glm::min(min, sphere.Position - glm::vec3(sphere.rad));
+		max = glm::max(max, sphere.Position + glm::vec3(sphere.rad));
+		centreMin = glm::min(centreMin, sphere.Position);
+		centreMax = glm::max(centreMax, sphere.Position);
+	}
+
+	m_nodes[index].Min = glm::vec4(min, 0.0f);
+	m_nodes[index].Max = glm::vec4(max, 0.0f);
+
+	if (_count <= LEAF_SIZE) {
+		m_nodes[index].Data = glm::ivec4(-1, _first, _count, 0);
+		return index;
+	}
+
+	glm::vec3 size = centreMax - centreMin;
+	int axis = (size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2));
+
+	int half = _count / 2;
+	std::nth_element(m_spheres.begin() + _first, m_spheres.begin() + _first + half, m_spheres.begin() + _first + _count,
+		[axis](const Sphere& _a, const Sphere& _b) { return _a.Position[axis] < _b.Position[axis]; });
+
+	Build(_first, half);
+	int right = Build(_first + half, _count - half);
+
+	m_nodes[index].Data = glm::ivec4(right, _first, _count, 0);
+	return index;
+}
+
+/// <summary>
+/// Copy the tree and spheres to their storage buffers. The node buffer starts with the node count
+/// </summary>
+void COccluderBVH::Upload()
+{
+	GLsizeiptr headerSize = sizeof(glm::ivec4);
+	GLsizeiptr nodeSize = m_nodes.size() * sizeof(OccluderNode);
+	GLsizeiptr sphereSize = m_spheres.size() * sizeof(Sphere);
+
+	Reserve(m_nodeBuffer, m_nodeCapacity, headerSize + nodeSize, NODE_BINDING);
+	Reserve(m_sphereBuffer, m_sphereCapacity, sphereSize, SPHERE_BINDING);
+
+	glm::ivec4 header = glm::ivec4((int)m_nodes.size(), (int)m_spheres.size(), 0, 0);
+	glNamedBufferSubData(m_nodeBuffer, 0, headerSize, &header);
+
+	if (nodeSize > 0) glNamedBufferSubData(m_nodeBuffer, headerSize, nodeSize, m_nodes.data());
+	if (sphereSize > 0) glNamedBufferSubData(m_sphereBuffer, 0, sphereSize, m_spheres.data());
+}
+
+/// <summary>
+/// Create the buffer, or grow it if it is too small for the data, and attach it to its binding point
+/// </summary>
+/// <param name="_buffer"></param>
+/// <param name="_capacity"></param>
+/// <param name="_size"> bytes needed</param>
+/// <param name="_binding"></param>
+void COccluderBVH::Reserve(GLuint& _buffer, GLsizeiptr& _capacity, GLsizeiptr _size, GLuint _binding)
+{
+	if (_buffer == NULL) {
+		glCreateBuffers(1, &_buffer);
+	}
+
+	if (_size <= _capacity) return;
+
+	//Storage must not be empty, even with no occluders
+	_capacity = (_size * 2 > 256 ? _size * 2 : 256);
+	glNamedBufferData(_buffer, _capacity, NULL, GL_DYNAMIC_DRAW);
+	CGLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, _binding, _buffer);
+}
@@ -0,0 +1,75 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : COccluderBVH.h
+// Description : Builds a bounding volume hierarchy of shadow casting spheres for the lit shaders to trace
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+#include <glew.h>
+#include <glm.hpp>
+
+//Occluder data is uploaded as is to std430 storage buffers, layouts must match the blocks in 3DLight_BlinnPhong.frag
+
+struct Sphere {
+	glm::vec3 Position = glm::vec3();
+	float rad = 0;
+
+	bool operator==(const Sphere& _other) const { return Position == _other.Position && rad == _other.rad; };
+};
+
+/// <summary>
+/// One node of the tree, the left child of a branch always directly follows it
+/// </summary>
+struct OccluderNode {
+	glm::vec4 Min = glm::vec4(0.0f);
+	glm::vec4 Max = glm::vec4(0.0f);
+
+	//x = right child (-1 for leaves), y = first sphere, z = sphere count
+	glm::ivec4 Data = glm::ivec4(-1, 0, 0, 0);
+};
+
+static_assert(sizeof(Sphere) == 16, "Sphere must match std430 layout");
+static_assert(sizeof(OccluderNode) == 48, "OccluderNode must match std430 layout");
+
+class COccluderBVH
+{
+private:
+	//Storage block binding points, must match the shaders
+	static const GLuint NODE_BINDING = 4;
+	static const GLuint SPHERE_BINDING = 5;
+
+	//Most spheres in one leaf
+	static const int LEAF_SIZE = 4;
+
+	//Spheres from this frame's casters, and the ones the tree was last built from
+	static std::vector<Sphere> m_gathered;
+	static std::vector<Sphere> m_built;
+
+	//Spheres in leaf order, and the tree over them
+	static std::vector<Sphere> m_spheres;
+	static std::vector<OccluderNode> m_nodes;
+
+	static GLuint m_nodeBuffer;
+	static GLuint m_sphereBuffer;
+	static GLsizeiptr m_nodeCapacity;
+	static GLsizeiptr m_sphereCapacity;
+
+	static int Build(int _first, int _count);
+	static void Upload();
+	static void Reserve(GLuint& _buffer, GLsizeiptr& _capacity, GLsizeiptr _size, GLuint _binding);
+
+public:
+	static void Update();
+
+	static int GetOccluderCount() { return (int)m_spheres.size(); };
+	static int GetNodeCount() { return (int)m_nodes.size(); };
+};
@@ -0,0 +1,295 @@
+#include "CPointShadows.h"
+#include "CObjectManager.h"
+#include "CLightManager.h"
+#include "CFrustumCuller.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+
+GLuint CPointShadows::m_staticMap = NULL;
+GLuint CPointShadows::m_shadowMap = NULL;
+GLuint CPointShadows::m_framebuffer = NULL;
+CPointShadows::Face CPointShadows::m_faces[MAX_LIGHTS * 6];
+glm::vec3 CPointShadows::m_lightPositions[MAX_LIGHTS];
+int CPointShadows::m_lightCount = 0;
+std::unordered_map<CShape*, CPointShadows::CasterState> CPointShadows::m_casters;
+std::vector<CShape*> CPointShadows::m_staticCasters;
+std::vector<CShape*> CPointShadows::m_dynamicCasters;
+int CPointShadows::m_generation = -1;
+int CPointShadows::m_faceBudget = 6;
+int CPointShadows::m_cursor = 0;
+PointShadowStats CPointShadows::m_stats;
+
+/// <summary>
+/// Bring the shadow maps up to date (within the face budget) and bind them for the lit programs.
+/// Must be called before the scene is drawn, changes the framebuffer and viewport while drawing
+/// </summary>
+void CPointShadows::Render()
+{
+	if (m_shadowMap == NULL) CreateMaps();
+
+	UpdateLights();
+	UpdateCasters();
+
+	int faceCount = m_lightCount * 6;
+	int budget = m_faceBudget;
+
+	GLuint program = ShaderLoader::GetProgram("shadowCube")->m_id;
+	bool cull = CGLState::IsEnabled(GL_CULL_FACE);
+	bool started = false;
+
+	//Round robin from where the last frame stopped, so no face waits forever
+	for (int i = 0; i < faceCount; i++) {
+		int layer = (m_cursor + i) % faceCount;
+		Face& face = m_faces[layer];
+
+		if (!face.staticDirty && !face.dynamicDirty) continue;
+
+		if (budget <= 0) {
+			m_stats.waiting++;
+			continue;
+		}
+
+		if (!started) {
+			started = true;
+
+			CGLState::UseProgram(program);
+			CGLState::Enable(GL_DEPTH_TEST);
+
+			//Flat shapes (floor, quads) need both sides in the map
+			CGLState::Disable(GL_CULL_FACE);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glViewport(0, 0, RESOLUTION, RESOLUTION);
+		}
+
+		int light = layer / 6;
+		glUniform3fv(ShaderLoader::GetUniformLocation(program, "LightPos"), 1, &m_lightPositions[light][0]);
+
+		if (face.staticDirty) {
+			DrawFace(layer, m_staticMap, m_staticCasters);
+			face.staticDirty = false;
+			m_stats.staticFaces++;
+		}
+
+		//Start from the cached static depth, moving casters go on top
+		glCopyImageSubData(m_staticMap, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer,
+			m_shadowMap, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer, RESOLUTION, RESOLUTION, 1);
+
+		glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, m_shadowMap, 0, layer);
+		DrawFace(layer, NULL, m_dynamicCasters);
+		face.dynamicDirty = false;
+		m_stats.dynamicFaces++;
+
+		budget--;
+		m_cursor = (layer + 1) % faceCount;
+	}
+
+	if (started) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, utils::windowWidth, utils::windowHeight);
+
+		if (cull) CGLState::Enable(GL_CULL_FACE);
+	}
+
+	CGLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, m_shadowMap);
+}
+
+/// <summary>
+/// Create the cached and final depth cube arrays (every face starts at the far plane) and the framebuffer to draw into them
+/// </summary>
+void CPointShadows::CreateMaps()
+{
+	GLuint* maps[2] = { &m_staticMap, &m_shadowMap };
+
+	for (GLuint* _map : maps) {
+		glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, _map);
+		glTextureStorage3D(*_map, 1, GL_DEPTH_COMPONENT32F, RESOLUTION, RESOLUTION, MAX_LIGHTS * 6);
+
+		glTextureParameteri(*_map, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(*_map, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(*_map, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(*_map, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(*_map, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+		//Hardware compare gives 2x2 filtered shadows
+		glTextureParameteri(*_map, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTextureParameteri(*_map, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+		float farDepth = 1.0f;
+		glClearTexImage(*_map, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+	}
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+}
+
+/// <summary>
+/// Redraw every face of lights that were added or moved
+/// </summary>
+void CPointShadows::UpdateLights()
+{
+	//Each face looks down one axis, orientations are the ones cube maps are sampled with
+	static const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	static const glm::vec3 ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+
+	int count = CLightManager::GetPointLightCount();
+	if (count > MAX_LIGHTS) count = MAX_LIGHTS;
+
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, FAR_PLANE);
+
+	for (int i = 0; i < count; i++) {
+		glm::vec3 position = CLightManager::GetPointLight(i).Position;
+		if (i < m_lightCount && position == m_lightPositions[i]) continue;
+
+		m_lightPositions[i] = position;
+
+		for (int j = 0; j < 6; j++) {
+			Face& face = m_faces[i * 6 + j];
+			face.projectionView = projection * glm::lookAt(position, position + directions[j], ups[j]);
+			CFrustumCuller::ExtractPlanes(face.projectionView, face.planes);
+
+			face.staticDirty = true;
+			face.dynamicDirty = true;
+		}
+	}
+
+	m_lightCount = count;
+}
+
+/// <summary>
+/// Sort this frame's casters into static and moving, and mark the faces that can see a caster that appeared,
+/// moved, changed size or went away. Only opaque world space shapes cast shadows
+/// </summary>
+void CPointShadows::UpdateCasters()
+{
+	//Shapes were added or removed, old pointers may have been reused, start again
+	if (m_generation != CObjectManager::GetGeneration()) {
+		m_generation = CObjectManager::GetGeneration();
+		m_casters.clear();
+
+		for (Face& _face : m_faces) {
+			_face.staticDirty = true;
+			_face.dynamicDirty = true;
+		}
+	}
+
+	m_staticCasters.clear();
+	m_dynamicCasters.clear();
+
+	for (std::pair<CShape* const, CasterState>& _caster : m_casters) {
+		_caster.second.seen = false;
+	}
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+		if (shape->m_orthoProject || shape->GetMesh() == nullptr || shape->GetRenderPass() != RenderPass::Opaque) continue;
+
+		if (shape->IsStatic()) m_staticCasters.push_back(shape);
+		else m_dynamicCasters.push_back(shape);
+
+		glm::vec3 centre = shape->GetBoundsCentre();
+		glm::vec3 extents = shape->GetBoundsExtents();
+
+		std::unordered_map<CShape*, CasterState>::iterator found = m_casters.find(shape);
+		if (found == m_casters.end()) {
+			found = m_casters.insert(std::make_pair(shape, CasterState())).first;
+
+			CasterState& state = found->second;
+			state.centre = centre;
+			state.extents = extents;
+			state.isStatic = shape->IsStatic();
+
+			MarkFaces(centre, extents, state.isStatic);
+		}
+
+		CasterState& state = found->second;
+		state.seen = true;
+
+		bool moved = glm::any(glm::greaterThan(glm::abs(centre - state.centre), glm::vec3(MOVE_THRESHOLD)))
+			|| glm::any(glm::greaterThan(glm::abs(extents - state.extents), glm::vec3(MOVE_THRESHOLD)));
+
+		if (!moved && state.isStatic == shape->IsStatic()) continue;
+
+		//Faces that saw it where it was, and where it is now
+		MarkFaces(state.centre, state.extents, state.isStatic);
+		MarkFaces(centre, extents, shape->IsStatic());
+
+		state.centre = centre;
+		state.extents = extents;
+		state.isStatic = shape->IsStatic();
+	}
+
+	//Casters that stopped casting
+	for (std::unordered_map<CShape*, CasterState>::iterator it = m_casters.begin(); it != m_casters.end(); ) {
+		if (it->second.seen) {
+			it++;
+			continue;
+		}
+
+		MarkFaces(it->second.centre, it->second.extents, it->second.isStatic);
+		it = m_casters.erase(it);
+	}
+}
+
+/// <summary>
+/// Mark every face that can see a box as needing its static or moving casters redrawn
+/// </summary>
+/// <param name="_centre"></param>
+/// <param name="_extents"></param>
+/// <param name="_static"></param>
+void CPointShadows::MarkFaces(const glm::vec3& _centre, const glm::vec3& _extents, bool _static)
+{
+	for (int i = 0; i < m_lightCount * 6; i++) {
+		Face& face = m_faces[i];
+		if (!FaceOverlaps(face, _centre, _extents)) continue;
+
+		if (_static) face.staticDirty = true;
+		face.dynamicDirty = true;
+	}
+}
+
+bool CPointShadows::FaceOverlaps(const Face& _face, const glm::vec3& _centre, const glm::vec3& _extents)
+{
+	for (int p = 0; p < 6; p++) {
+		glm::vec3 normal = glm::vec3(_face.planes[p]);
+		if (glm::dot(normal, _centre) + _face.planes[p].w + glm::dot(glm::abs(normal), _extents) < 0.0f) return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Draw casters that the face can see into one layer. The framebuffer must already be bound.
+/// With a texture the layer is attached and cleared first, with NULL whatever is attached is drawn onto
+/// </summary>
+/// <param name="_layer"> light * 6 + face</param>
+/// <param name="_texture"></param>
+/// <param name="_casters"></param>
+void CPointShadows::DrawFace(int _layer, GLuint _texture, const std::vector<CShape*>& _casters)
+{
+	if (_texture != NULL) {
+		glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, _texture, 0, _layer);
+
+		float farDepth = 1.0f;
+		glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+	}
+
+	const Face& face = m_faces[_layer];
+
+	for (CShape* _shape : _casters) {
+		glm::vec3 centre = _shape->GetBoundsCentre();
+		glm::vec3 extents = _shape->GetBoundsExtents();
+		if (!FaceOverlaps(face, centre, extents)) continue;
+
+		_shape->UpdateModelMat();
+		glm::mat4 model = _shape->GetModel();
+
+		int index = CTransformRing::Push(model, face.projectionView * model);
+		_shape->GetMesh()->Render(index);
+
+		m_stats.casters++;
+	}
+}
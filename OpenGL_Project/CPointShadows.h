@@ -0,0 +1,110 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CPointShadows.h
+// Description : Cube shadow maps for point lights, static casters cached and moving casters redrawn on top
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+#include <glew.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "CShape.h"
+
+/// <summary>
+/// Shadow map faces redrawn this frame
+/// </summary>
+struct PointShadowStats
+{
+	int staticFaces = 0;
+	int dynamicFaces = 0;
+	int casters = 0;
+
+	//Faces waiting for a later frame because of the budget
+	int waiting = 0;
+};
+
+class CPointShadows
+{
+private:
+	/// <summary>
+	/// What a cube face needs redrawing
+	/// </summary>
+	struct Face
+	{
+		//Static casters changed, the cached depth needs drawing again
+		bool staticDirty = true;
+
+		//Moving casters changed, copy the cached depth and draw them on top
+		bool dynamicDirty = true;
+
+		glm::mat4 projectionView = glm::mat4();
+		glm::vec4 planes[6];
+	};
+
+	/// <summary>
+	/// A shape's bounds when the shadow maps last saw it
+	/// </summary>
+	struct CasterState
+	{
+		glm::vec3 centre = glm::vec3(0.0f);
+		glm::vec3 extents = glm::vec3(0.0f);
+		bool isStatic = false;
+		bool seen = false;
+	};
+
+	//Must match the shaders (MAX_SHADOWED_POINT_LIGHTS, POINT_SHADOW_FAR and the PointShadows binding), lights past the first MAX_LIGHTS have no shadows
+	static const int MAX_LIGHTS = 4;
+	static constexpr float FAR_PLANE = 100.0f;
+	static constexpr float NEAR_PLANE = 0.1f;
+	static const GLuint TEXTURE_UNIT = 10;
+
+	static const int RESOLUTION = 512;
+
+	//Casters moving less than this don't redraw anything
+	static constexpr float MOVE_THRESHOLD = 0.001f;
+
+	//Both are cube map arrays, layer = light * 6 + face
+	static GLuint m_staticMap;
+	static GLuint m_shadowMap;
+	static GLuint m_framebuffer;
+
+	static Face m_faces[MAX_LIGHTS * 6];
+	static glm::vec3 m_lightPositions[MAX_LIGHTS];
+	static int m_lightCount;
+
+	static std::unordered_map<CShape*, CasterState> m_casters;
+	static std::vector<CShape*> m_staticCasters;
+	static std::vector<CShape*> m_dynamicCasters;
+	static int m_generation;
+
+	//Most faces redrawn per frame, and where the next frame starts looking for dirty faces
+	static int m_faceBudget;
+	static int m_cursor;
+
+	static PointShadowStats m_stats;
+
+	static void CreateMaps();
+	static void UpdateLights();
+	static void UpdateCasters();
+	static void MarkFaces(const glm::vec3& _centre, const glm::vec3& _extents, bool _static);
+	static bool FaceOverlaps(const Face& _face, const glm::vec3& _centre, const glm::vec3& _extents);
+	static void DrawFace(int _layer, GLuint _texture, const std::vector<CShape*>& _casters);
+
+public:
+	static void Render();
+
+	static void SetFaceBudget(int _faces) { m_faceBudget = _faces; };
+	static GLuint GetShadowMap() { return m_shadowMap; };
+
+	static void NewFrame() { m_stats = PointShadowStats(); };
+	static PointShadowStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,248 @@
+#include "CPostProcess.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+
+AntiAliasing CPostProcess::m_antiAliasing = AntiAliasing::MSAA;
+bool CPostProcess::m_passEnabled[PASS_COUNT] = { true, true, false };
+float CPostProcess::m_exposure = 1.0f;
+GLuint CPostProcess::m_sceneFramebuffer = NULL;
+GLuint CPostProcess::m_sceneColour = NULL;
+GLuint CPostProcess::m_sceneDepth = NULL;
+GLuint CPostProcess::m_msFramebuffer = NULL;
+GLuint CPostProcess::m_msColour = NULL;
+GLuint CPostProcess::m_msDepth = NULL;
+GLuint CPostProcess::m_targets[2] = { NULL, NULL };
+GLuint CPostProcess::m_framebuffers[2] = { NULL, NULL };
+GLuint CPostProcess::m_emptyVertexArray = NULL;
+PostStats CPostProcess::m_stats;
+
+/// <summary>
+/// Pick how edges are smoothed. The multisampled targets are only kept while MSAA is selected
+/// </summary>
+/// <param name="_antiAliasing"></param>
+void CPostProcess::SetAntiAliasing(AntiAliasing _antiAliasing)
+{
+	m_antiAliasing = _antiAliasing;
+	m_passEnabled[(int)PostPass::FXAA] = (m_antiAliasing == AntiAliasing::FXAA);
+
+	if (m_sceneFramebuffer == NULL) return;
+
+	if (m_antiAliasing == AntiAliasing::MSAA) {
+		if (m_msFramebuffer == NULL) CreateMultisampleTargets();
+	}
+	else {
+		DeleteMultisampleTargets();
+	}
+}
+
+/// <summary>
+/// Turn a pass on or off, FXAA is the same as picking it (or no) anti-aliasing
+/// </summary>
+/// <param name="_pass"></param>
+/// <param name="_enabled"></param>
+void CPostProcess::SetPassEnabled(PostPass _pass, bool _enabled)
+{
+	if (_pass == PostPass::FXAA) {
+		SetAntiAliasing(_enabled ? AntiAliasing::FXAA : AntiAliasing::None);
+		return;
+	}
+
+	m_passEnabled[(int)_pass] = _enabled;
+}
+
+/// <summary>
+/// Framebuffer the scene is drawn into, for passes that switch framebuffers part way through the scene
+/// </summary>
+/// <returns></returns>
+GLuint CPostProcess::GetSceneFramebuffer()
+{
+	return (m_antiAliasing == AntiAliasing::MSAA ? m_msFramebuffer : m_sceneFramebuffer);
+}
+
+/// <summary>
+/// Start drawing the scene offscreen, call before clearing it
+/// </summary>
+void CPostProcess::BeginScene()
+{
+	if (m_sceneFramebuffer == NULL) CreateTargets();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GetSceneFramebuffer());
+}
+
+/// <summary>
+/// Resolve the scene if it was multisampled, then run each enabled pass, the last one drawing to the window.
+/// The window is bound afterwards, for anything drawn over the processed scene (text)
+/// </summary>
+/// <param name="_camera"> used by the fog pass to find each pixel's distance</param>
+void CPostProcess::EndScene(CCamera* _camera)
+{
+	GLsizei width = utils::windowWidth;
+	GLsizei height = utils::windowHeight;
+
+	bool scissor = CGLState::IsEnabled(GL_SCISSOR_TEST);
+	CGLState::Disable(GL_SCISSOR_TEST);
+
+	if (m_antiAliasing == AntiAliasing::MSAA) {
+		glBlitNamedFramebuffer(m_msFramebuffer, m_sceneFramebuffer, 0, 0, width, height, 0, 0, width, height,
+			GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		m_stats.resolved = true;
+	}
+
+	int passes[PASS_COUNT];
+	int passCount = 0;
+	for (int i = 0; i < PASS_COUNT; i++) {
+		if (m_passEnabled[i]) passes[passCount++] = i;
+	}
+
+	if (passCount == 0) {
+		glBlitNamedFramebuffer(m_sceneFramebuffer, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	else {
+		bool depthTest = CGLState::IsEnabled(GL_DEPTH_TEST);
+		bool blend = CGLState::IsEnabled(GL_BLEND);
+		CGLState::Disable(GL_DEPTH_TEST);
+		CGLState::Disable(GL_BLEND);
+
+		CGLState::BindVertexArray(m_emptyVertexArray);
+		CGLState::BindTexture(DEPTH_UNIT, GL_TEXTURE_2D, m_sceneDepth);
+
+		GLuint source = m_sceneColour;
+		for (int i = 0; i < passCount; i++) {
+			bool last = (i == passCount - 1);
+
+			RunPass((PostPass)passes[i], source, (last ? 0 : m_framebuffers[i % 2]), _camera);
+			source = m_targets[i % 2];
+		}
+
+		if (depthTest) CGLState::Enable(GL_DEPTH_TEST);
+		if (blend) CGLState::Enable(GL_BLEND);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (scissor) CGLState::Enable(GL_SCISSOR_TEST);
+}
+
+/// <summary>
+/// Draw one full screen pass reading _source into _framebuffer
+/// </summary>
+/// <param name="_pass"></param>
+/// <param name="_source"></param>
+/// <param name="_framebuffer"> 0 for the window</param>
+/// <param name="_camera"></param>
+void CPostProcess::RunPass(PostPass _pass, GLuint _source, GLuint _framebuffer, CCamera* _camera)
+{
+	static const char* programNames[PASS_COUNT] = { "postFog", "postTonemap", "postFXAA" };
+
+	GLuint program = ShaderLoader::GetProgram(programNames[(int)_pass])->m_id;
+	CGLState::UseProgram(program);
+
+	switch (_pass)
+	{
+	case PostPass::Fog: {
+		_camera->UpdatePerspective();
+		glm::mat4 inverse = glm::inverse(_camera->GetProjectionViewMat());
+		glm::vec3 cameraPos = _camera->GetCameraPos();
+
+		glUniformMatrix4fv(ShaderLoader::GetUniformLocation(program, "InverseProjectionView"), 1, GL_FALSE, &inverse[0][0]);
+		glUniform3fv(ShaderLoader::GetUniformLocation(program, "CameraPos"), 1, &cameraPos[0]);
+		break;
+	}
+
+	case PostPass::Tonemap:
+		glUniform1f(ShaderLoader::GetUniformLocation(program, "Exposure"), m_exposure);
+		break;
+
+	default:
+		break;
+	}
+
+	CGLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, _source);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	m_stats.passes++;
+}
+
+/// <summary>
+/// Create the single sample scene (half float colour, depth/stencil the passes can read), the pass targets,
+/// and the multisampled scene if MSAA is selected
+/// </summary>
+void CPostProcess::CreateTargets()
+{
+	GLsizei width = utils::windowWidth;
+	GLsizei height = utils::windowHeight;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_sceneColour);
+	glTextureStorage2D(m_sceneColour, 1, GL_RGBA16F, width, height);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_sceneDepth);
+	glTextureStorage2D(m_sceneDepth, 1, GL_DEPTH24_STENCIL8, width, height);
+	glTextureParameteri(m_sceneDepth, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_sceneDepth, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateFramebuffers(1, &m_sceneFramebuffer);
+	glNamedFramebufferTexture(m_sceneFramebuffer, GL_COLOR_ATTACHMENT0, m_sceneColour, 0);
+	glNamedFramebufferTexture(m_sceneFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_sceneDepth, 0);
+
+	if (glCheckNamedFramebufferStatus(m_sceneFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR: Scene framebuffer is incomplete." << std::endl;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 2, m_targets);
+	glCreateFramebuffers(2, m_framebuffers);
+
+	//FXAA samples between texels, so every colour target filters
+	GLuint colours[3] = { m_sceneColour, m_targets[0], m_targets[1] };
+	for (GLuint _colour : colours) {
+		if (_colour != m_sceneColour) glTextureStorage2D(_colour, 1, GL_RGBA16F, width, height);
+
+		glTextureParameteri(_colour, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(_colour, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(_colour, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(_colour, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		glNamedFramebufferTexture(m_framebuffers[i], GL_COLOR_ATTACHMENT0, m_targets[i], 0);
+	}
+
+	if (m_antiAliasing == AntiAliasing::MSAA) CreateMultisampleTargets();
+
+	//The passes make their triangle from gl_VertexID
+	glCreateVertexArrays(1, &m_emptyVertexArray);
+}
+
+void CPostProcess::CreateMultisampleTargets()
+{
+	GLsizei width = utils::windowWidth;
+	GLsizei height = utils::windowHeight;
+
+	glCreateRenderbuffers(1, &m_msColour);
+	glNamedRenderbufferStorageMultisample(m_msColour, MSAA_SAMPLES, GL_RGBA16F, width, height);
+
+	glCreateRenderbuffers(1, &m_msDepth);
+	glNamedRenderbufferStorageMultisample(m_msDepth, MSAA_SAMPLES, GL_DEPTH24_STENCIL8, width, height);
+
+	glCreateFramebuffers(1, &m_msFramebuffer);
+	glNamedFramebufferRenderbuffer(m_msFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_msColour);
+	glNamedFramebufferRenderbuffer(m_msFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_msDepth);
+
+	if (glCheckNamedFramebufferStatus(m_msFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR: Multisampled scene framebuffer is incomplete." << std::endl;
+	}
+}
+
+void CPostProcess::DeleteMultisampleTargets()
+{
+	if (m_msFramebuffer == NULL) return;
+
+	glDeleteFramebuffers(1, &m_msFramebuffer);
+	glDeleteRenderbuffers(1, &m_msColour);
+	glDeleteRenderbuffers(1, &m_msDepth);
+
+	m_msFramebuffer = NULL;
+	m_msColour = NULL;
+	m_msDepth = NULL;
+}
@@ -0,0 +1,103 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CPostProcess.h
+// Description : Renders the scene into an offscreen HDR target, then runs it through a chain of full screen passes to the window
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <glew.h>
+#include <glm.hpp>
+
+#include "CCamera.h"
+#include "Utility.h"
+
+enum class AntiAliasing
+{
+	None,
+
+	//Scene is drawn multisampled and resolved before the post passes
+	MSAA,
+
+	//One full screen pass after tonemapping instead
+	FXAA,
+};
+
+/// <summary>
+/// Post passes, in the order they run
+/// </summary>
+enum class PostPass
+{
+	Fog,
+	Tonemap,
+	FXAA,
+};
+
+/// <summary>
+/// What the chain did this frame
+/// </summary>
+struct PostStats
+{
+	int passes = 0;
+
+	//Multisampled scene was resolved
+	bool resolved = false;
+};
+
+class CPostProcess
+{
+private:
+	static const int PASS_COUNT = 3;
+	static const int MSAA_SAMPLES = 4;
+
+	//Every pass reads the previous one's result and the scene's depth here, must match the Post shaders
+	static const GLuint SOURCE_UNIT = 19;
+	static const GLuint DEPTH_UNIT = 20;
+
+	static AntiAliasing m_antiAliasing;
+	static bool m_passEnabled[PASS_COUNT];
+	static float m_exposure;
+
+	//Single sample scene, drawn into directly or resolved into from the multisampled one, and read by the passes
+	static GLuint m_sceneFramebuffer;
+	static GLuint m_sceneColour;
+	static GLuint m_sceneDepth;
+
+	//Multisampled scene, only exists while MSAA is selected
+	static GLuint m_msFramebuffer;
+	static GLuint m_msColour;
+	static GLuint m_msDepth;
+
+	//Passes before the last ping pong between these, the last draws to the window
+	static GLuint m_targets[2];
+	static GLuint m_framebuffers[2];
+	static GLuint m_emptyVertexArray;
+
+	static PostStats m_stats;
+
+	static void CreateTargets();
+	static void CreateMultisampleTargets();
+	static void DeleteMultisampleTargets();
+	static void RunPass(PostPass _pass, GLuint _source, GLuint _framebuffer, CCamera* _camera);
+
+public:
+	static void SetAntiAliasing(AntiAliasing _antiAliasing);
+	static AntiAliasing GetAntiAliasing() { return m_antiAliasing; };
+
+	static void SetPassEnabled(PostPass _pass, bool _enabled);
+	static bool IsPassEnabled(PostPass _pass) { return m_passEnabled[(int)_pass]; };
+
+	static void SetExposure(float _exposure) { m_exposure = _exposure; };
+
+	static GLuint GetSceneFramebuffer();
+
+	static void BeginScene();
+	static void EndScene(CCamera* _camera);
+
+	static void NewFrame() { m_stats = PostStats(); };
+	static PostStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,500 @@
+#include "CRenderQueue.h"
+#include <algorithm>
+#include "CUniform.h"
+#include "CGeometryArena.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "CFrustumCuller.h"
+
+std::vector<CRenderQueue::QueueItem> CRenderQueue::m_items;
+std::vector<CRenderQueue::QueueItem> CRenderQueue::m_sortBuffer;
+std::map<std::pair<std::array<GLuint, 4>, uint64_t>, uint16_t> CRenderQueue::m_materials;
+RenderQueueStats CRenderQueue::m_stats;
+std::map<GLuint, GLuint> CRenderQueue::m_instancedPrograms;
+OpaqueOrder CRenderQueue::m_opaqueOrder = OpaqueOrder::State;
+std::set<GLuint> CRenderQueue::m_prepassPrograms;
+GLuint CRenderQueue::m_depthProgram = NULL;
+std::vector<size_t> CRenderQueue::m_prepassItems;
+std::vector<CRenderQueue::Batch> CRenderQueue::m_batches;
+std::vector<CRenderQueue::DrawCommand> CRenderQueue::m_commands;
+GLuint CRenderQueue::m_commandBuffer = NULL;
+GLsizeiptr CRenderQueue::m_commandCapacity = 0;
+
+/// <summary>
+/// Add a shape to be drawn on the next flush
+/// </summary>
+/// <param name="_shape"></param>
+void CRenderQueue::Submit(CShape* _shape)
+{
+	if (_shape == nullptr || _shape->GetMesh() == nullptr) return;
+
+	QueueItem item;
+	item.shape = _shape;
+	m_items.push_back(item);
+}
+
+/// <summary>
+/// Give (or stop giving) shapes drawn with a program a depth only draw before the opaque pass,
+/// so their expensive fragment shader only runs on the pixels that end up visible.
+/// Needs a depth program set with SetDepthProgram
+/// </summary>
+/// <param name="_program"></param>
+/// <param name="_enabled"></param>
+void CRenderQueue::SetPrepass(GLuint _program, bool _enabled)
+{
+	if (_enabled) {
+		m_prepassPrograms.insert(_program);
+	}
+	else {
+		m_prepassPrograms.erase(_program);
+	}
+}
+
+/// <summary>
+/// Sort all submitted shapes by state and draw them, only changing program when needed
+/// </summary>
+/// <param name="_camera"> used for depth sorting</param>
+void CRenderQueue::Flush(CCamera* _camera)
+{
+	if (m_items.empty()) return;
+
+	//Drop everything outside the camera's view before any sorting or uploading
+	Cull(_camera);
+
+	if (m_items.empty()) return;
+
+	//Build sort keys
+	for (QueueItem& _item : m_items) {
+		CShape* shape = _item.shape;
+
+		_item.program = shape->GetProgram();
+		_item.material = GetMaterialID(shape);
+		_item.mesh = shape->GetMesh()->GetID();
+
+		_item.depth = (_camera ? glm::distance(_camera->GetCameraPos(), shape->GetPosition()) : 0.0f);
+		_item.key = MakeKey(shape->GetRenderPass(), _item.program, _item.material, _item.mesh, _item.depth);
+
+		_item.prepass = (m_depthProgram != NULL && shape->GetRenderPass() == RenderPass::Opaque && !shape->m_orthoProject
+			&& m_prepassPrograms.count(_item.program) > 0);
+	}
+
+	m_stats.unsortedChanges += CountChanges(m_items);
+
+	RadixSort();
+
+	DrawPrepass(_camera);
+
+	//Group into batches, runs of the same program/material go out as one multi draw where possible
+	BuildBatches(_camera);
+
+	if (!m_commands.empty()) {
+		UploadBuffer(m_commandBuffer, m_commandCapacity, m_commands.data(), m_commands.size() * sizeof(DrawCommand));
+	}
+
+	//Draw in sorted order
+	GLuint currentProgram = 0;
+	uint16_t currentMaterial = 0;
+	int currentMesh = -1;
+
+	GLenum depthFunc = CGLState::GetDepthFunc();
+	GLboolean depthMask = CGLState::GetDepthMask();
+
+	for (Batch& _batch : m_batches) {
+		QueueItem& first = m_items[_batch.start];
+
+		//Prepassed shapes already wrote their depth, they pass where they are the nearest surface.
+		//The background sits at the far plane, so it passes wherever nothing was drawn
+		bool equalDepth = first.prepass || first.shape->GetRenderPass() == RenderPass::Background;
+		CGLState::DepthFunc(equalDepth ? GL_LEQUAL : depthFunc);
+
+		CGLState::DepthMask(first.prepass ? GL_FALSE : depthMask);
+
+		GLuint program = first.program;
+		if (_batch.indirect) program = m_instancedPrograms[first.program];
+
+		if (program != currentProgram) {
+			CGLState::UseProgram(program);
+			currentProgram = program;
+			m_stats.programChanges++;
+		}
+		if (first.material != currentMaterial) {
+			currentMaterial = first.material;
+			m_stats.textureChanges++;
+		}
+		if (first.mesh != currentMesh) {
+			currentMesh = first.mesh;
+			m_stats.meshChanges++;
+		}
+
+		if (_batch.indirect) {
+			DrawIndirect(_batch, program);
+			continue;
+		}
+
+		first.shape->Draw();
+		m_stats.draws++;
+	}
+
+	CGLState::DepthFunc(depthFunc);
+	CGLState::DepthMask(depthMask);
+
+	m_items.clear();
+
+	//Ids only have to be unique within a flush
+	if (m_materials.size() >= MAX_MATERIALS) m_materials.clear();
+}
+
+/// <summary>
+/// Draws the depth of every prepass item, nearest first, with colour writes off.
+/// Uses the same projection view and model matrices as the lit draws, so the depths match exactly (see PositionOnly.vert)
+/// </summary>
+/// <param name="_camera"></param>
+void CRenderQueue::DrawPrepass(CCamera* _camera)
+{
+	if (_camera == nullptr) return;
+
+	m_prepassItems.clear();
+	for (size_t i = 0; i < m_items.size(); i++) {
+		if (m_items[i].prepass) m_prepassItems.push_back(i);
+	}
+	if (m_prepassItems.empty()) return;
+
+	std::sort(m_prepassItems.begin(), m_prepassItems.end(), [](size_t _a, size_t _b) {
+		return m_items[_a].depth < m_items[_b].depth;
+	});
+
+	glm::mat4 projectionView = _camera->GetProjectionViewMat();
+
+	CGLState::UseProgram(m_depthProgram);
+	m_stats.programChanges++;
+	CGLState::ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	for (size_t _index : m_prepassItems) {
+		CShape* shape = m_items[_index].shape;
+
+		shape->UpdateModelMat();
+		glm::mat4 model = shape->GetModel();
+
+		int ringIndex = CTransformRing::Push(model, projectionView * model);
+		shape->GetMesh()->Render(ringIndex);
+
+		m_stats.prepassDraws++;
+	}
+
+	CGLState::ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+/// <summary>
+/// Tests the world bounds of every submitted shape against the camera's frustum in one packed pass,
+/// and removes the ones outside it. Screen space and background shapes are never culled
+/// </summary>
+/// <param name="_camera"></param>
+void CRenderQueue::Cull(CCamera* _camera)
+{
+	if (_camera == nullptr) return;
+
+	_camera->UpdatePerspective();
+	CFrustumCuller::SetFrustum(_camera->GetProjectionViewMat());
+	CFrustumCuller::Clear();
+
+	for (QueueItem& _item : m_items) {
+		CShape* shape = _item.shape;
+
+		_item.cullIndex = -1;
+		if (shape->m_orthoProject || shape->GetRenderPass() == RenderPass::Background) continue;
+
+		_item.cullIndex = CFrustumCuller::Add(shape->GetBoundsCentre(), shape->GetBoundsExtents());
+	}
+
+	CFrustumCuller::Cull();
+
+	//Keep visible items in submission order
+	size_t kept = 0;
+	for (size_t i = 0; i < m_items.size(); i++) {
+		if (m_items[i].cullIndex >= 0 && !CFrustumCuller::IsVisible(m_items[i].cullIndex)) continue;
+
+		m_items[kept++] = m_items[i];
+	}
+	m_items.resize(kept);
+}
+
+/// <summary>
+/// Can two items go out in the same multi draw (same pass, program, material and vertex format)
+/// </summary>
+/// <param name="_a"></param>
+/// <param name="_b"></param>
+/// <returns></returns>
+bool CRenderQueue::CanShareDraw(const QueueItem& _a, const QueueItem& _b)
+{
+	return _a.program == _b.program
+		&& _a.material == _b.material
+		&& (_a.key >> (64 - PASS_BITS)) == (_b.key >> (64 - PASS_BITS))
+		&& _a.shape->GetMesh()->GetType() == _b.shape->GetMesh()->GetType();
+}
+
+/// <summary>
+/// Splits the sorted items into batches. Runs of 2+ items with the same pass, program, material and vertex format
+/// become one indirect batch (one command per mesh) if the program has an instanced variant.
+/// Each indirect shape's data is written to the transform ring, in order, so a command's instances are contiguous
+/// </summary>
+/// <param name="_camera"> nullptr for none (identity projection and view)</param>
+void CRenderQueue::BuildBatches(CCamera* _camera)
+{
+	m_batches.clear();
+	m_commands.clear();
+
+	//Without a camera the shapes' model matrices are used as they are
+	glm::mat4 projectionView = glm::mat4(1.0f);
+	if (_camera != nullptr) {
+		_camera->UpdatePerspective();
+		projectionView = _camera->GetProjectionViewMat();
+	}
+
+	static const std::string rimExponentName = "RimExponent";
+	static const std::string rimColourName = "RimColour";
+	static const std::string reflectivityName = "Reflectivity";
+
+	size_t i = 0;
+	while (i < m_items.size()) {
+		QueueItem& first = m_items[i];
+
+		//Find end of run sharing state
+		size_t end = i + 1;
+		while (end < m_items.size() && CanShareDraw(first, m_items[end])) {
+			end++;
+		}
+
+		Batch batch;
+		batch.start = i;
+		batch.count = (int)(end - i);
+		batch.indirect = (batch.count > 1 && m_instancedPrograms.find(first.program) != m_instancedPrograms.end());
+
+		if (!batch.indirect) {
+			//Draw each on its own
+			for (size_t j = i; j < end; j++) {
+				Batch single;
+				single.start = j;
+				single.count = 1;
+				m_batches.push_back(single);
+			}
+			i = end;
+			continue;
+		}
+
+		batch.firstCommand = (int)m_commands.size();
+
+		for (size_t j = i; j < end; j++) {
+			CShape* shape = m_items[j].shape;
+			CMesh* mesh = shape->GetMesh();
+
+			//New mesh, new command (items are sorted by mesh within the run)
+			if (j == i || m_items[j].mesh != m_items[j - 1].mesh) {
+				DrawCommand command;
+				command.count = mesh->GetIndexCount();
+				command.firstIndex = mesh->GetFirstIndex();
+				command.baseVertex = mesh->GetBaseVertex();
+				command.baseInstance = (GLuint)CTransformRing::GetCount();
+				m_commands.push_back(command);
+			}
+			m_commands.back().instanceCount++;
+
+			//Fill instance data
+			shape->UpdateModelMat();
+
+			ObjectData instance;
+			instance.model = shape->GetModel();
+			instance.PVM = projectionView * instance.model;
+			instance.normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(instance.model))));
+
+			CUniformBlock& uniforms = shape->GetUniforms();
+			glm::vec3 rimColour = glm::vec3(0.0f);
+			uniforms.GetFloat(rimExponentName, instance.rim.a);
+			uniforms.GetVec3(rimColourName, rimColour);
+			uniforms.GetFloat(reflectivityName, instance.params.x);
+			instance.rim = glm::vec4(rimColour, instance.rim.a);
+
+			CTransformRing::Push(instance);
+		}
+
+		batch.commandCount = (int)m_commands.size() - batch.firstCommand;
+
+		m_batches.push_back(batch);
+		i = end;
+	}
+}
+
+/// <summary>
+/// Copies data for this flush to a GPU buffer, growing the buffer if needed
+/// </summary>
+/// <param name="_buffer"></param>
+/// <param name="_capacity"></param>
+/// <param name="_data"></param>
+/// <param name="_size"> bytes</param>
+void CRenderQueue::UploadBuffer(GLuint& _buffer, GLsizeiptr& _capacity, const void* _data, GLsizeiptr _size)
+{
+	if (_buffer == NULL) {
+		glCreateBuffers(1, &_buffer);
+	}
+
+	if (_size > _capacity) {
+		_capacity = _size * 2;
+	}
+
+	//Orphan the old storage so we don't wait on draws still using it
+	glNamedBufferData(_buffer, _capacity, NULL, GL_STREAM_DRAW);
+	glNamedBufferSubData(_buffer, 0, _size, _data);
+}
+
+/// <summary>
+/// Draw a batch of shapes sharing program, material and vertex format with one multi draw indirect call
+/// </summary>
+/// <param name="_batch"></param>
+/// <param name="_instancedProgram"> must be in use</param>
+void CRenderQueue::DrawIndirect(Batch& _batch, GLuint _instancedProgram)
+{
+	CShape* first = m_items[_batch.start].shape;
+
+	//Shared uniforms (textures, time etc.) come from the first shape, per shape values come from the transform ring
+	first->SendUniforms(_instancedProgram);
+
+	CGLState::BindVertexArray(first->GetMesh()->GetVAO());
+	CGLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(_batch.firstCommand * sizeof(DrawCommand)), _batch.commandCount, 0);
+
+	m_stats.draws++;
+	m_stats.indirectDraws++;
+	m_stats.indirectCommands += _batch.commandCount;
+	m_stats.instances += _batch.count;
+}
+
+/// <summary>
+/// Returns a small id unique to the textures the shape binds and the uniform values an indirect batch shares,
+/// so shapes only share a multi draw when the first one's uniforms are right for all of them
+/// </summary>
+/// <param name="_shape"></param>
+/// <returns></returns>
+uint16_t CRenderQueue::GetMaterialID(CShape* _shape)
+{
+	//Sent per instance through the transform ring, or the same for every shape (time)
+	static const std::string perInstance[] = { "RimExponent", "RimColour", "Reflectivity", "CurrentTime" };
+
+	std::pair<std::array<GLuint, 4>, uint64_t> material;
+	_shape->GetTextureSet(material.first);
+	material.second = _shape->GetUniforms().HashValues(perInstance, 4);
+
+	std::map<std::pair<std::array<GLuint, 4>, uint64_t>, uint16_t>::iterator it = m_materials.find(material);
+	if (it != m_materials.end()) {
+		return it->second;
+	}
+
+	uint16_t id = (uint16_t)(m_materials.size() + 1);
+	m_materials[material] = id;
+	return id;
+}
+
+/// <summary>
+/// Packs draw state into a single key, so that sorting the keys groups draws with the same state
+/// </summary>
+/// <param name="_pass"></param>
+/// <param name="_program"></param>
+/// <param name="_material"></param>
+/// <param name="_mesh"></param>
+/// <param name="_depth"> distance from camera</param>
+/// <returns></returns>
+uint64_t CRenderQueue::MakeKey(RenderPass _pass, GLuint _program, uint16_t _material, int _mesh, float _depth)
+{
+	const float maxDepth = 4000.0f;
+	const uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+
+	//Opaque front to back (less overdraw), transparent back to front (correct blending)
+	uint64_t depth = (uint64_t)(glm::clamp(_depth / maxDepth, 0.0f, 1.0f) * (float)depthMax);
+	if (_pass == RenderPass::Transparent) depth = depthMax - depth;
+
+	uint64_t key = 0;
+	key |= ((uint64_t)_pass & ((1ull << PASS_BITS) - 1));
+
+	//Nearest first so early depth testing rejects as much as it can, state only groups draws at the same distance
+	if (_pass == RenderPass::Opaque && m_opaqueOrder == OpaqueOrder::FrontToBack) {
+		key = (key << DEPTH_BITS) | depth;
+		key = (key << PROGRAM_BITS) | ((uint64_t)_program & ((1ull << PROGRAM_BITS) - 1));
+		key = (key << MATERIAL_BITS) | ((uint64_t)_material & ((1ull << MATERIAL_BITS) - 1));
+		key = (key << MESH_BITS) | ((uint64_t)_mesh & ((1ull << MESH_BITS) - 1));
+		return key;
+	}
+
+	key = (key << PROGRAM_BITS) | ((uint64_t)_program & ((1ull << PROGRAM_BITS) - 1));
+	key = (key << MATERIAL_BITS) | ((uint64_t)_material & ((1ull << MATERIAL_BITS) - 1));
+	key = (key << MESH_BITS) | ((uint64_t)_mesh & ((1ull << MESH_BITS) - 1));
+	key = (key << DEPTH_BITS) | depth;
+
+	return key;
+}
+
+/// <summary>
+/// Counts how many program, texture and mesh changes drawing the list in order would cause
+/// </summary>
+/// <param name="_items"></param>
+/// <returns></returns>
+int CRenderQueue::CountChanges(const std::vector<QueueItem>& _items)
+{
+	int changes = 0;
+
+	GLuint currentProgram = 0;
+	uint16_t currentMaterial = 0;
+	int currentMesh = -1;
+
+	for (const QueueItem& _item : _items) {
+		if (_item.program != currentProgram) changes++;
+		if (_item.material != currentMaterial) changes++;
+		if (_item.mesh != currentMesh) changes++;
+
+		currentProgram = _item.program;
+		currentMaterial = _item.material;
+		currentMesh = _item.mesh;
+	}
+
+	return changes;
+}
+
+/// <summary>
+/// LSD radix sort on the 64 bit keys, one byte per pass. Passes where every key has the same byte are skipped
+/// </summary>
+void CRenderQueue::RadixSort()
+{
+	size_t count = m_items.size();
+	m_sortBuffer.resize(count);
+
+	std::vector<QueueItem>* src = &m_items;
+	std::vector<QueueItem>* dst = &m_sortBuffer;
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t histogram[256] = { 0 };
+
+		for (size_t i = 0; i < count; i++) {
+			histogram[((*src)[i].key >> shift) & 0xFF]++;
+		}
+
+		//All keys share this byte, nothing to do
+		if (histogram[((*src)[0].key >> shift) & 0xFF] == count) continue;
+
+		//Turn counts into starting offsets
+		size_t offset = 0;
+		for (int i = 0; i < 256; i++) {
+			size_t bucketCount = histogram[i];
+			histogram[i] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			(*dst)[histogram[((*src)[i].key >> shift) & 0xFF]++] = (*src)[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	//Make sure the result ends up in m_items
+	if (src != &m_items) {
+		m_items.swap(m_sortBuffer);
+	}
+}
@@ -0,0 +1,178 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CRenderQueue.h
+// Description : Sorts submitted shapes by a packed state key so that draws sharing state are grouped
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <map>
+#include <set>
+#include <array>
+#include <cstdint>
+
+#include <glew.h>
+
+#include "CShape.h"
+#include "CCamera.h"
+
+/// <summary>
+/// Counts of state changes for the current frame
+/// </summary>
+struct RenderQueueStats
+{
+	int draws = 0;
+
+	//Depth only draws before the opaque pass
+	int prepassDraws = 0;
+
+	//Multi draw indirect calls, the commands (one per mesh) in them, and the shapes they drew
+	int indirectDraws = 0;
+	int indirectCommands = 0;
+	int instances = 0;
+
+	//State changes done after sorting
+	int programChanges = 0;
+	int textureChanges = 0;
+	int meshChanges = 0;
+
+	//State changes that would have happened in submission order
+	int unsortedChanges = 0;
+
+	int GetChanges() { return programChanges + textureChanges + meshChanges; };
+	int GetSaved() { return unsortedChanges - GetChanges(); };
+};
+
+/// <summary>
+/// How the opaque pass is ordered
+/// </summary>
+enum class OpaqueOrder
+{
+	//Fewest state changes, distance only orders draws with the same state
+	State,
+
+	//Nearest first so early depth testing skips hidden pixels, state only orders draws at the same distance
+	FrontToBack,
+};
+
+class CRenderQueue
+{
+private:
+	/// <summary>
+	/// A single submitted draw
+	/// </summary>
+	struct QueueItem
+	{
+		uint64_t key = 0;
+		CShape* shape = nullptr;
+		GLuint program = 0;
+		uint16_t material = 0;
+		int mesh = 0;
+
+		//Index in the frustum culler, -1 if always drawn
+		int cullIndex = -1;
+
+		float depth = 0.0f;
+
+		//Depth was already written by the prepass, only pixels at that depth are shaded
+		bool prepass = false;
+	};
+
+	/// <summary>
+	/// Layout of a glMultiDrawElementsIndirect command
+	/// </summary>
+	struct DrawCommand
+	{
+		GLuint count = 0;
+		GLuint instanceCount = 0;
+		GLuint firstIndex = 0;
+		GLint baseVertex = 0;
+		GLuint baseInstance = 0;
+	};
+
+	/// <summary>
+	/// A run of sorted items drawn together
+	/// </summary>
+	struct Batch
+	{
+		size_t start = 0;
+		int count = 0;
+
+		//Indirect batches draw every item in one call, one command per mesh
+		bool indirect = false;
+		int firstCommand = 0;
+		int commandCount = 0;
+	};
+
+	//Bit layout of the sort key (most significant first)
+	//	pass (4) | program (12) | material (16) | mesh (12) | depth (20)
+	//or for the opaque pass ordered front to back
+	//	pass (4) | depth (20) | program (12) | material (16) | mesh (12)
+	static const int DEPTH_BITS = 20;
+	static const int MESH_BITS = 12;
+	static const int MATERIAL_BITS = 16;
+	static const int PROGRAM_BITS = 12;
+	static const int PASS_BITS = 4;
+
+	static std::vector<QueueItem> m_items;
+
+	//Scratch buffers for the radix sort, kept between frames to avoid reallocating
+	static std::vector<QueueItem> m_sortBuffer;
+
+	//Texture sets and shared uniform values seen so far, mapped to a small material id
+	static std::map<std::pair<std::array<GLuint, 4>, uint64_t>, uint16_t> m_materials;
+
+	//Ids start over after a flush once this many materials have been seen (animated values keep adding new ones)
+	static const size_t MAX_MATERIALS = 4096;
+
+	static RenderQueueStats m_stats;
+
+	//Programs that have an instanced variant
+	static std::map<GLuint, GLuint> m_instancedPrograms;
+
+	static OpaqueOrder m_opaqueOrder;
+
+	//Programs expensive enough that their shapes get a depth only draw first, and the program that draws it
+	static std::set<GLuint> m_prepassPrograms;
+	static GLuint m_depthProgram;
+	static std::vector<size_t> m_prepassItems;
+
+	static std::vector<Batch> m_batches;
+	static std::vector<DrawCommand> m_commands;
+
+	static GLuint m_commandBuffer;
+	static GLsizeiptr m_commandCapacity;
+
+	static uint16_t GetMaterialID(CShape* _shape);
+	static uint64_t MakeKey(RenderPass _pass, GLuint _program, uint16_t _material, int _mesh, float _depth);
+	static int CountChanges(const std::vector<QueueItem>& _items);
+
+	static void Cull(CCamera* _camera);
+	static void RadixSort();
+	static bool CanShareDraw(const QueueItem& _a, const QueueItem& _b);
+	static void BuildBatches(CCamera* _camera);
+	static void UploadBuffer(GLuint& _buffer, GLsizeiptr& _capacity, const void* _data, GLsizeiptr _size);
+	static void DrawIndirect(Batch& _batch, GLuint _instancedProgram);
+	static void DrawPrepass(CCamera* _camera);
+
+public:
+	static void Submit(CShape* _shape);
+	static void Flush(CCamera* _camera);
+
+	static void SetInstancedProgram(GLuint _program, GLuint _instancedProgram) { m_instancedPrograms[_program] = _instancedProgram; };
+
+	static void SetOpaqueOrder(OpaqueOrder _order) { m_opaqueOrder = _order; };
+	static OpaqueOrder GetOpaqueOrder() { return m_opaqueOrder; };
+
+	static void SetDepthProgram(GLuint _program) { m_depthProgram = _program; };
+	static void SetPrepass(GLuint _program, bool _enabled);
+	static bool HasPrepass(GLuint _program) { return m_prepassPrograms.count(_program) > 0; };
+
+	static void NewFrame() { m_stats = RenderQueueStats(); };
+	static RenderQueueStats GetStats() { return m_stats; };
+};
@@ -0,0 +1,525 @@
+#include "CSceneBVH.h"
+#include "CFrustumCuller.h"
+
+std::vector<CSceneBVH::Node> CSceneBVH::m_nodes;
+int CSceneBVH::m_root = -1;
+std::vector<int> CSceneBVH::m_freeNodes;
+std::unordered_map<CShape*, int> CSceneBVH::m_leaves;
+std::vector<int> CSceneBVH::m_stack;
+
+/// <summary>
+/// Add a shape to the tree. Screen space shapes are not in world space so are left out
+/// </summary>
+/// <param name="_shape"></param>
+void CSceneBVH::Insert(CShape* _shape)
+{
+	if (_shape == nullptr || _shape->GetMesh() == nullptr || _shape->m_orthoProject) return;
+	if (m_leaves.find(_shape) != m_leaves.end()) return;
+
+	int leaf = AllocateNode();
+
+	glm::vec3 centre = _shape->GetBoundsCentre();
+	glm::vec3 extents = _shape->GetBoundsExtents() + glm::vec3(FAT_MARGIN);
+
+	m_nodes[leaf].min = centre - extents;
+	m_nodes[leaf].max = centre + extents;
+	m_nodes[leaf].shape = _shape;
+	m_nodes[leaf].height = 0;
+
+	m_leaves[_shape] = leaf;
+	InsertLeaf(leaf);
+}
+
+/// <summary>
+/// Take a shape out of the tree, must be done before the shape is deleted
+/// </summary>
+/// <param name="_shape"></param>
+void CSceneBVH::Remove(CShape* _shape)
+{
+	std::unordered_map<CShape*, int>::iterator it = m_leaves.find(_shape);
+	if (it == m_leaves.end()) return;
+
+	RemoveLeaf(it->second);
+	FreeNode(it->second);
+	m_leaves.erase(it);
+}
+
+/// <summary>
+/// Remove every shape
+/// </summary>
+void CSceneBVH::Clear()
+{
+	m_nodes.clear();
+	m_freeNodes.clear();
+	m_leaves.clear();
+	m_root = -1;
+}
+
+/// <summary>
+/// Move the leaves of shapes that left their fat box. Shapes moving within it don't change the tree
+/// </summary>
+void CSceneBVH::Refit()
+{
+	for (std::pair<CShape* const, int>& _leaf : m_leaves) {
+		glm::vec3 centre = _leaf.first->GetBoundsCentre();
+		glm::vec3 extents = _leaf.first->GetBoundsExtents();
+
+		Node& node = m_nodes[_leaf.second];
+		if (glm::all(glm::greaterThanEqual(centre - extents, node.min)) && glm::all(glm::lessThanEqual(centre + extents, node.max))) continue;
+
+		RemoveLeaf(_leaf.second);
+
+		m_nodes[_leaf.second].min = centre - extents - glm::vec3(FAT_MARGIN);
+		m_nodes[_leaf.second].max = centre + extents + glm::vec3(FAT_MARGIN);
+
+		InsertLeaf(_leaf.second);
+	}
+}
+
+/// <summary>
+/// Find the closest triangle of any shape along a ray. Nearer children are visited first,
+/// and boxes further than the closest hit so far are skipped. Background shapes (the skybox) are ignored
+/// </summary>
+/// <param name="_origin"></param>
+/// <param name="_direction"> normalized, e.g. CCamera::GetWorldRay</param>
+/// <param name="_hit"> filled if something was hit</param>
+/// <param name="_maxDistance"></param>
+/// <returns> if anything was hit</returns>
+bool CSceneBVH::Raycast(const glm::vec3& _origin, const glm::vec3& _direction, RayHit& _hit, float _maxDistance)
+{
+	_hit = RayHit();
+	_hit.distance = _maxDistance;
+
+	if (m_root == -1) return false;
+
+	glm::vec3 inverseDirection = 1.0f / _direction;
+
+	float entry = 0.0f;
+	if (!RayBox(_origin, inverseDirection, m_nodes[m_root].min, m_nodes[m_root].max, _hit.distance, entry)) return false;
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (!m_stack.empty()) {
+		int index = m_stack.back();
+		m_stack.pop_back();
+
+		const Node& node = m_nodes[index];
+
+		if (node.IsLeaf()) {
+			if (node.shape->GetRenderPass() == RenderPass::Background) continue;
+
+			RayMesh(node.shape, _origin, _direction, _hit);
+			continue;
+		}
+
+		float leftEntry = 0.0f;
+		float rightEntry = 0.0f;
+		bool hitLeft = RayBox(_origin, inverseDirection, m_nodes[node.left].min, m_nodes[node.left].max, _hit.distance, leftEntry);
+		bool hitRight = RayBox(_origin, inverseDirection, m_nodes[node.right].min, m_nodes[node.right].max, _hit.distance, rightEntry);
+
+		//Push the further child first so the nearer one is popped next
+		if (hitLeft && hitRight) {
+			if (leftEntry < rightEntry) {
+				m_stack.push_back(node.right);
+				m_stack.push_back(node.left);
+			}
+			else {
+				m_stack.push_back(node.left);
+				m_stack.push_back(node.right);
+			}
+		}
+		else if (hitLeft) m_stack.push_back(node.left);
+		else if (hitRight) m_stack.push_back(node.right);
+	}
+
+	return _hit.shape != nullptr;
+}
+
+/// <summary>
+/// Every shape whose bounds touch a sphere
+/// </summary>
+/// <param name="_centre"></param>
+/// <param name="_radius"></param>
+/// <param name="_results"> shapes are added to the end</param>
+void CSceneBVH::QuerySphere(const glm::vec3& _centre, float _radius, std::vector<CShape*>& _results)
+{
+	if (m_root == -1) return;
+
+	float radiusSquared = _radius * _radius;
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (!m_stack.empty()) {
+		const Node& node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+
+		//Closest point of the box to the centre
+		glm::vec3 offset = glm::clamp(_centre, node.min, node.max) - _centre;
+		if (glm::dot(offset, offset) > radiusSquared) continue;
+
+		if (!node.IsLeaf()) {
+			m_stack.push_back(node.left);
+			m_stack.push_back(node.right);
+			continue;
+		}
+
+		//Leaf boxes are fat, test the shape's own bounds
+		glm::vec3 centre = node.shape->GetBoundsCentre();
+		glm::vec3 extents = node.shape->GetBoundsExtents();
+		offset = glm::clamp(_centre, centre - extents, centre + extents) - _centre;
+
+		if (glm::dot(offset, offset) <= radiusSquared) _results.push_back(node.shape);
+	}
+}
+
+/// <summary>
+/// Every shape whose bounds are at least partly inside a view frustum
+/// </summary>
+/// <param name="_projectionView"></param>
+/// <param name="_results"> shapes are added to the end</param>
+void CSceneBVH::QueryFrustum(const glm::mat4& _projectionView, std::vector<CShape*>& _results)
+{
+	if (m_root == -1) return;
+
+	glm::vec4 planes[6];
+	CFrustumCuller::ExtractPlanes(_projectionView, planes);
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (!m_stack.empty()) {
+		const Node& node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+
+		glm::vec3 centre = (node.min + node.max) / 2.0f;
+		glm::vec3 extents = (node.max - node.min) / 2.0f;
+
+		if (node.IsLeaf()) {
+			centre = node.shape->GetBoundsCentre();
+			extents = node.shape->GetBoundsExtents();
+		}
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++) {
+			glm::vec3 normal = glm::vec3(planes[p]);
+			outside = (glm::dot(normal, centre) + planes[p].w + glm::dot(glm::abs(normal), extents) < 0.0f);
+		}
+		if (outside) continue;
+
+		if (node.IsLeaf()) {
+			_results.push_back(node.shape);
+			continue;
+		}
+
+		m_stack.push_back(node.left);
+		m_stack.push_back(node.right);
+	}
+}
+
+/// <summary>
+/// Get an unused node, reusing freed ones first
+/// </summary>
+/// <returns></returns>
+int CSceneBVH::AllocateNode()
+{
+	if (!m_freeNodes.empty()) {
+		int node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+
+		m_nodes[node] = Node();
+		return node;
+	}
+
+	m_nodes.push_back(Node());
+	return (int)m_nodes.size() - 1;
+}
+
+void CSceneBVH::FreeNode(int _node)
+{
+	m_nodes[_node] = Node();
+	m_nodes[_node].height = -1;
+	m_freeNodes.push_back(_node);
+}
+
+/// <summary>
+/// Put a leaf next to the sibling that grows the tree's surface area the least, then rebalance up to the root.
+/// Walks down choosing the cheaper child, stopping when pairing with the current node is cheaper than going lower
+/// </summary>
+/// <param name="_leaf"></param>
+void CSceneBVH::InsertLeaf(int _leaf)
+{
+	if (m_root == -1) {
+		m_root = _leaf;
+		m_nodes[_leaf].parent = -1;
+		return;
+	}
+
+	glm::vec3 leafMin = m_nodes[_leaf].min;
+	glm::vec3 leafMax = m_nodes[_leaf].max;
+
+	int index = m_root;
+	while (!m_nodes[index].IsLeaf()) {
+		const Node& node = m_nodes[index];
+
+		float area = SurfaceArea(node.min, node.max);
+		float combinedArea = SurfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		//Cost of a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+
+		//Every node above the new parent grows by this much
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.left, node.right };
+		for (int i = 0; i < 2; i++) {
+			const Node& child = m_nodes[children[i]];
+			float grownArea = SurfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+
+			childCost[i] = (child.IsLeaf() ? grownArea : grownArea - SurfaceArea(child.min, child.max)) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+
+		index = (childCost[0] < childCost[1] ? children[0] : children[1]);
+	}
+
+	int sibling = index;
+
+	//New parent for the sibling and leaf (may move the node list)
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode();
+
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].left = sibling;
+	m_nodes[newParent].right = _leaf;
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].min = glm::min(m_nodes[sibling].min, leafMin);
+	m_nodes[newParent].max = glm::max(m_nodes[sibling].max, leafMax);
+
+	if (oldParent != -1) {
+		if (m_nodes[oldParent].left == sibling) m_nodes[oldParent].left = newParent;
+		else m_nodes[oldParent].right = newParent;
+	}
+	else {
+		m_root = newParent;
+	}
+
+	m_nodes[sibling].parent = newParent;
+	m_nodes[_leaf].parent = newParent;
+
+	//Fix heights and boxes up to the root
+	index = m_nodes[_leaf].parent;
+	while (index != -1) {
+		index = Balance(index);
+		FitNode(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+/// <summary>
+/// Take a leaf out of the tree (the node itself is kept), its sibling takes the parent's place
+/// </summary>
+/// <param name="_leaf"></param>
+void CSceneBVH::RemoveLeaf(int _leaf)
+{
+	if (_leaf == m_root) {
+		m_root = -1;
+		return;
+	}
+
+	int parent = m_nodes[_leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = (m_nodes[parent].left == _leaf ? m_nodes[parent].right : m_nodes[parent].left);
+
+	m_nodes[_leaf].parent = -1;
+
+	if (grandParent == -1) {
+		m_root = sibling;
+		m_nodes[sibling].parent = -1;
+		FreeNode(parent);
+		return;
+	}
+
+	if (m_nodes[grandParent].left == parent) m_nodes[grandParent].left = sibling;
+	else m_nodes[grandParent].right = sibling;
+
+	m_nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	int index = grandParent;
+	while (index != -1) {
+		index = Balance(index);
+		FitNode(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+/// <summary>
+/// Rotate the taller child up if the node's children differ in height by more than one
+/// </summary>
+/// <param name="_node"></param>
+/// <returns> node now in _node's place</returns>
+int CSceneBVH::Balance(int _node)
+{
+	int a = _node;
+	if (m_nodes[a].IsLeaf() || m_nodes[a].height < 2) return a;
+
+	int b = m_nodes[a].left;
+	int c = m_nodes[a].right;
+	int balance = m_nodes[c].height - m_nodes[b].height;
+
+	if (balance >= -1 && balance <= 1) return a;
+
+	//The taller child moves up, the shorter of its children moves down to a
+	int up = (balance > 1 ? c : b);
+	int other = (balance > 1 ? b : c);
+
+	int upLeft = m_nodes[up].left;
+	int upRight = m_nodes[up].right;
+	int keep = (m_nodes[upLeft].height > m_nodes[upRight].height ? upLeft : upRight);
+	int moved = (keep == upLeft ? upRight : upLeft);
+
+	//up takes a's place
+	m_nodes[up].parent = m_nodes[a].parent;
+	if (m_nodes[up].parent != -1) {
+		if (m_nodes[m_nodes[up].parent].left == a) m_nodes[m_nodes[up].parent].left = up;
+		else m_nodes[m_nodes[up].parent].right = up;
+	}
+	else {
+		m_root = up;
+	}
+
+	//a is now a child of up, with the shorter grandchild in up's old slot
+	m_nodes[up].left = a;
+	m_nodes[up].right = keep;
+	m_nodes[a].parent = up;
+
+	m_nodes[a].left = other;
+	m_nodes[a].right = moved;
+	m_nodes[moved].parent = a;
+
+	FitNode(a);
+	FitNode(up);
+
+	return up;
+}
+
+/// <summary>
+/// Box and height from the node's children
+/// </summary>
+/// <param name="_node"></param>
+void CSceneBVH::FitNode(int _node)
+{
+	Node& node = m_nodes[_node];
+	if (node.IsLeaf()) return;
+
+	const Node& left = m_nodes[node.left];
+	const Node& right = m_nodes[node.right];
+
+	node.min = glm::min(left.min, right.min);
+	node.max = glm::max(left.max, right.max);
+	node.height = 1 + (left.height > right.height ? left.height : right.height);
+}
+
+float CSceneBVH::SurfaceArea(const glm::vec3& _min, const glm::vec3& _max)
+{
+	glm::vec3 size = _max - _min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/// <summary>
+/// Slab test, a ray starting inside the box hits it at 0
+/// </summary>
+/// <param name="_origin"></param>
+/// <param name="_inverseDirection"> 1 / direction</param>
+/// <param name="_min"></param>
+/// <param name="_max"></param>
+/// <param name="_maxDistance"></param>
+/// <param name="_entry"> distance the ray enters the box</param>
+/// <returns></returns>
+bool CSceneBVH::RayBox(const glm::vec3& _origin, const glm::vec3& _inverseDirection, const glm::vec3& _min, const glm::vec3& _max, float _maxDistance, float& _entry)
+{
+	glm::vec3 t1 = (_min - _origin) * _inverseDirection;
+	glm::vec3 t2 = (_max - _origin) * _inverseDirection;
+
+	glm::vec3 tNear = glm::min(t1, t2);
+	glm::vec3 tFar = glm::max(t1, t2);
+
+	float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+	float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, _maxDistance));
+
+	_entry = entry;
+	return entry <= exit;
+}
+
+/// <summary>
+/// Test every triangle of the shape's mesh (both sides), in the mesh's local space. Updates the hit if closer
+/// </summary>
+/// <param name="_shape"></param>
+/// <param name="_origin"></param>
+/// <param name="_direction"> normalized, so distances stay in world units</param>
+/// <param name="_hit"></param>
+/// <returns> if the hit was updated</returns>
+bool CSceneBVH::RayMesh(CShape* _shape, const glm::vec3& _origin, const glm::vec3& _direction, RayHit& _hit)
+{
+	CMesh* mesh = _shape->GetMesh();
+	const std::vector<float>& vertices = mesh->GetVertices();
+	const std::vector<int>& indices = mesh->GetIndices();
+	int stride = mesh->GetStride();
+
+	_shape->UpdateModelMat();
+	glm::mat4 inverseModel = glm::inverse(_shape->GetModel());
+
+	//The local direction isn't normalized, so the distance along it is the world distance
+	glm::vec3 origin = glm::vec3(inverseModel * glm::vec4(_origin, 1.0f));
+	glm::vec3 direction = glm::vec3(inverseModel * glm::vec4(_direction, 0.0f));
+
+	const float epsilon = 1e-7f;
+	bool updated = false;
+	glm::vec3 localNormal = glm::vec3(0.0f);
+
+	//Moller-Trumbore
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const float* v0 = &vertices[indices[i] * stride];
+		const float* v1 = &vertices[indices[i + 1] * stride];
+		const float* v2 = &vertices[indices[i + 2] * stride];
+
+		glm::vec3 p0 = glm::vec3(v0[0], v0[1], v0[2]);
+		glm::vec3 edge1 = glm::vec3(v1[0], v1[1], v1[2]) - p0;
+		glm::vec3 edge2 = glm::vec3(v2[0], v2[1], v2[2]) - p0;
+
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (glm::abs(determinant) < epsilon) continue;
+
+		float inverseDeterminant = 1.0f / determinant;
+		glm::vec3 t = origin - p0;
+
+		float u = glm::dot(t, p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f) continue;
+
+		glm::vec3 q = glm::cross(t, edge1);
+		float v = glm::dot(direction, q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f) continue;
+
+		float distance = glm::dot(edge2, q) * inverseDeterminant;
+		if (distance < 0.0f || distance >= _hit.distance) continue;
+
+		_hit.shape = _shape;
+		_hit.triangle = (int)i;
+		_hit.distance = distance;
+		localNormal = glm::cross(edge1, edge2);
+		updated = true;
+	}
+
+	if (updated) {
+		_hit.point = _origin + _direction * _hit.distance;
+		_hit.normal = glm::normalize(glm::transpose(glm::mat3(inverseModel)) * localNormal);
+		if (glm::dot(_hit.normal, _direction) > 0.0f) _hit.normal = -_hit.normal;
+	}
+
+	return updated;
+}
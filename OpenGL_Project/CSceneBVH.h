@@ -0,0 +1,99 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CSceneBVH.h
+// Description : Dynamic AABB tree over every world space shape, for ray, sphere and frustum queries
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cfloat>
+
+#include <glm.hpp>
+
+#include "CShape.h"
+
+/// <summary>
+/// Closest shape and triangle a ray hit
+/// </summary>
+struct RayHit
+{
+	CShape* shape = nullptr;
+
+	//Index of the first of the triangle's three indices in the mesh
+	int triangle = -1;
+
+	float distance = FLT_MAX;
+	glm::vec3 point = glm::vec3(0.0f);
+
+	//World space face normal, facing back along the ray
+	glm::vec3 normal = glm::vec3(0.0f);
+};
+
+class CSceneBVH
+{
+private:
+	/// <summary>
+	/// A branch (two children) or a leaf (one shape), free nodes have a height of -1
+	/// </summary>
+	struct Node
+	{
+		//Leaves are fattened so small moves don't need the tree changing
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+
+		int parent = -1;
+		int left = -1;
+		int right = -1;
+		int height = 0;
+
+		CShape* shape = nullptr;
+
+		bool IsLeaf() const { return left == -1; };
+	};
+
+	//How far leaf boxes are grown past the shape's bounds
+	static constexpr float FAT_MARGIN = 0.2f;
+
+	static std::vector<Node> m_nodes;
+	static int m_root;
+
+	//Free nodes, reused before the node list grows
+	static std::vector<int> m_freeNodes;
+
+	//Leaf of each shape in the tree
+	static std::unordered_map<CShape*, int> m_leaves;
+
+	//Traversal stack, kept between queries
+	static std::vector<int> m_stack;
+
+	static int AllocateNode();
+	static void FreeNode(int _node);
+
+	static void InsertLeaf(int _leaf);
+	static void RemoveLeaf(int _leaf);
+	static int Balance(int _node);
+	static void FitNode(int _node);
+
+	static float SurfaceArea(const glm::vec3& _min, const glm::vec3& _max);
+	static bool RayBox(const glm::vec3& _origin, const glm::vec3& _inverseDirection, const glm::vec3& _min, const glm::vec3& _max, float _maxDistance, float& _entry);
+	static bool RayMesh(CShape* _shape, const glm::vec3& _origin, const glm::vec3& _direction, RayHit& _hit);
+
+public:
+	static void Insert(CShape* _shape);
+	static void Remove(CShape* _shape);
+	static void Clear();
+	static void Refit();
+
+	static bool Raycast(const glm::vec3& _origin, const glm::vec3& _direction, RayHit& _hit, float _maxDistance = 1000.0f);
+	static void QuerySphere(const glm::vec3& _centre, float _radius, std::vector<CShape*>& _results);
+	static void QueryFrustum(const glm::mat4& _projectionView, std::vector<CShape*>& _results);
+
+	static int GetCount() { return (int)m_leaves.size(); };
+	static int GetHeight() { return (m_root == -1 ? 0 : m_nodes[m_root].height); };
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include "CShape.h"
-#include "CUniform.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+#include "CFrustumCuller.h"
 
 //#include <stb_image.h>
 
@@ -41,40 +44,35 @@ CShape::CShape(std::string _meshName ,glm::vec3 _pos, float _rot, glm::vec3 _sca
 
 CShape::~CShape()
 {
-	for (CUniform* _uniform : m_uniforms) {
-		delete _uniform;
-	}
 }
 
 /// <summary>
-/// Add unifrom to shape
+/// Set the program, resolving uniform locations against it if it changed
 /// </summary>
-/// <param name="_uniform"> type</param>
-/// <param name="_name"> what it is called in shader files</param>
-void CShape::AddUniform(CUniform* _uniform)
+/// <param name="_program"></param>
+void CShape::SetProgram(GLuint _program)
 {
-	const char* val = _uniform->name.c_str();
-	_uniform->location = glGetUniformLocation(m_program, val);
+	if (_program == m_program) return;
 
-	m_uniforms.push_back(_uniform);
+	m_program = _program;
+	m_uniforms.SetProgram(m_program);
 }
 
 /// <summary>
-/// Update a uniform with a new one, if it exists
+/// Use an animated texture, made of frames side by side
 /// </summary>
-/// <param name="_NewUniform"></param>
-/// <param name="_name"></param>
-void CShape::UpdateUniform(CUniform* _NewUniform)
+/// <param name="_texture"></param>
+/// <param name="_frameCount"> amount of frames in image</param>
+/// <param name="_secondsPerFrame"></param>
+void CShape::SetAnimation(GLuint _texture, int _frameCount, float _secondsPerFrame)
 {
-	GLuint loc = glGetUniformLocation(m_program, _NewUniform->name.c_str());
-	_NewUniform->location = loc;
-	for (CUniform*& _uniform : m_uniforms) {
-		if (_NewUniform->name == _uniform->name) {
-			delete _uniform;
-			_uniform = _NewUniform;
-			return;
-		}
-	}
+	m_animationFrames = _frameCount;
+	m_secondsPerFrame = _secondsPerFrame;
+	m_currentFrame = 0;
+
+	m_uniforms.SetTexture("ImageTexture", _texture);
+	m_uniforms.SetInt("frameCount", _frameCount);
+	m_uniforms.SetFloat("offset", 0.0f);
 }
 
 /// <summary>
@@ -84,29 +82,60 @@ void CShape::UpdateUniform(CUniform* _NewUniform)
 /// <param name="currentTime"></param>
 void CShape::Update(float deltaTime, float currentTime)
 {
+	static const std::string timeName = "CurrentTime";
+	static const std::string offsetName = "offset";
+
 	m_currentTime = currentTime;
-	UpdateUniform(new FloatUniform(currentTime, "CurrentTime"));
+	m_uniforms.SetFloat(m_uniforms.Find(timeName), currentTime);
+
+	//Increment the current frame based on speed defined
+	if (m_animationFrames > 0 && currentTime >= m_lastFrameTime + m_secondsPerFrame) {
+		m_lastFrameTime = currentTime;
+		m_currentFrame++;
+
+		if (m_currentFrame >= m_animationFrames) m_currentFrame = 0;
+
+		m_uniforms.SetFloat(m_uniforms.Find(offsetName), (float)m_currentFrame * (1.0f / m_animationFrames));
+	}
+}
+
+/// <summary>
+/// Fills list with the textures this shape binds (0 for unused slots), used by the render queue to group by material
+/// </summary>
+/// <param name="_textures"></param>
+void CShape::GetTextureSet(std::array<GLuint, 4>& _textures)
+{
+	m_uniforms.GetTextures(_textures);
 }
 
 /// <summary>
-/// Renders shape
+/// Renders shape, unless it is outside the camera's view
 /// </summary>
 void CShape::Render()
 {
-	UpdatePVM();
+	if (!IsInView()) return;
 
-	glUseProgram(m_program);
+	CGLState::UseProgram(m_program);
 
-	for (CUniform* _uniform : m_uniforms) {
-		_uniform->Send(this);
-	}
+	Draw();
+}
 
-	m_mesh->Render();
-	
-	glUseProgram(0);
+/// <summary>
+/// Sends uniforms and draws the mesh, expects the shapes program to already be in use
+/// </summary>
+void CShape::Draw()
+{
+	UpdatePVM();
+
+	m_uniforms.Send();
+
+	m_mesh->Render(m_objectIndex);
 }
 
-void CShape::UpdatePVM()
+/// <summary>
+/// Recalculates the model matrix from position, rotation and scale
+/// </summary>
+void CShape::UpdateModelMat()
 {
 	//Calc transformation matrices
 	m_translationMat = glm::translate(glm::mat4(), m_position);
@@ -118,31 +147,64 @@ void CShape::UpdatePVM()
 
 	//Calculate model matrix for shape
 	m_modelMat = pixelScale * m_translationMat * m_rotationMat * m_scaleMat ;
+}
+
+/// <summary>
+/// Moves the mesh's local box and sphere into world space, if the shape moved since they were last worked out
+/// </summary>
+void CShape::UpdateBounds()
+{
+	if (!m_boundsDirty || m_mesh == nullptr) return;
+	m_boundsDirty = false;
+
+	UpdateModelMat();
+
+	glm::vec3 localCentre = (m_mesh->GetBoundsMin() + m_mesh->GetBoundsMax()) / 2.0f;
+	glm::vec3 localExtents = (m_mesh->GetBoundsMax() - m_mesh->GetBoundsMin()) / 2.0f;
+
+	//Box around the rotated box: each world axis gets the absolute projection of every local axis
+	m_boundsCentre = glm::vec3(m_modelMat * glm::vec4(localCentre, 1.0f));
+	m_boundsExtents = glm::vec3(0.0f);
+	for (int i = 0; i < 3; i++) {
+		m_boundsExtents += glm::abs(glm::vec3(m_modelMat[i])) * localExtents[i];
+	}
 
-	//Ortho project
-	float halfWindowWidth = (float)utils::windowWidth / 2.0f;
-	float halfWindowHeight = (float)utils::windowHeight / 2.0f;
+	float largestScale = glm::max(glm::length(glm::vec3(m_modelMat[0])), glm::max(glm::length(glm::vec3(m_modelMat[1])), glm::length(glm::vec3(m_modelMat[2]))));
+	m_boundingSphere = glm::vec4(glm::vec3(m_modelMat * glm::vec4(m_mesh->GetSphereCentre(), 1.0f)), m_mesh->GetSphereRadius() * largestScale);
+}
+
+/// <summary>
+/// Is any of the shape inside the current view frustum. Screen space and background shapes always are
+/// </summary>
+/// <returns></returns>
+bool CShape::IsInView()
+{
+	if (m_orthoProject || m_renderPass == RenderPass::Background || m_mesh == nullptr) return true;
+
+	UpdateBounds();
+	return CFrustumCuller::TestBox(m_boundsCentre, m_boundsExtents);
+}
+
+void CShape::UpdatePVM()
+{
+	UpdateModelMat();
 
 	//Perspective or ortho project
 	if (m_orthoProject) {
 		m_camera->SetCameraProjectionMat(glm::ortho(0.0f, (float)utils::windowWidth, 0.0f, (float)utils::windowHeight, 0.0f, 100.0f));
 
-		m_modelMat = m_camera->GetCameraProjectionMat() * m_modelMat;
+		m_PVMMat = m_camera->GetCameraProjectionMat() * m_modelMat;
 
-		UpdateUniform(new Mat4Uniform(m_modelMat, "CurrentTime"));
+		m_objectIndex = CTransformRing::Push(m_modelMat, m_PVMMat);
 		return;
 	}
 	else {
-		m_camera->SetCameraProjectionMat(glm::perspective(glm::radians(90.0f), (float)utils::windowWidth / (float)utils::windowHeight, 0.1f, 4000.0f));
+		m_camera->UpdatePerspective();
 	}
-	
-
-	//Calculate the new View matrix using all camera vars
-	m_camera->SetCameraViewMat(glm::lookAt(m_camera->GetCameraPos(), m_camera->GetCameraPos() + m_camera->GetCameraForwardDir(), m_camera->GetCameraUpDir()));
 
 	//Calculate the PVM mat for the shape using camera view mat
 	m_PVMMat = m_camera->GetCameraProjectionMat() * m_camera->GetCameraViewMat() * m_modelMat;
 
-	UpdateUniform(new Mat4Uniform(m_PVMMat, "PVMMat"));
-	UpdateUniform(new Mat4Uniform(m_modelMat, "Model"));
+	//Matrices go to this frame's part of the transform ring, shaders read them using the draw's base instance
+	m_objectIndex = CTransformRing::Push(m_modelMat, m_PVMMat);
 }
@@ -23,12 +23,23 @@
 
 #include "CVertexArray.h"
 #include <map>
+#include <array>
 
 #include "CCamera.h"
 #include "Utility.h"
 #include "CMesh.h"
+#include "CUniform.h"
 
-class CUniform;
+/// <summary>
+/// Which pass of the render queue a shape is drawn in (lower passes draw first).
+/// Background goes after opaque, at the far plane, so it only shades pixels nothing else covered
+/// </summary>
+enum class RenderPass
+{
+	Opaque,
+	Background,
+	Transparent,
+};
 
 class CShape
 {
@@ -40,16 +51,30 @@ private:
 
 	CCamera* m_camera = nullptr;
 
-	//List of uniforms
-	std::vector<CUniform*> m_uniforms;
+	//Uniform values
+	CUniformBlock m_uniforms;
 
 	float m_currentTime = 0;
 
+	//Animated texture (frameCount frames side by side, stepped through with the "offset" uniform)
+	int m_animationFrames = 0;
+	float m_secondsPerFrame = 0;
+	int m_currentFrame = 0;
+	float m_lastFrameTime = 0;
+
 	glm::vec3 m_position = glm::vec3(0.0f, 0.0f, 0.0f);
 	GLfloat m_rotation = 0.0f;
 	glm::vec3 m_scale = glm::vec3(1.0f, 1.0f, 1.0f);
 
 	bool isPerspective = false;
+
+	RenderPass m_renderPass = RenderPass::Opaque;
+
+	//Bounding sphere is traced for shadows by the lit shaders
+	bool m_shadowCaster = false;
+
+	//Never moves, so its shadows can be cached
+	bool m_static = false;
 	
 
 	glm::mat4 m_modelMat = glm::mat4();
@@ -58,6 +83,17 @@ private:
 	glm::mat4 m_scaleMat = glm::mat4();
 	glm::mat4 m_PVMMat = glm::mat4();
 
+	//Where this frame's matrices are in the transform ring
+	int m_objectIndex = 0;
+
+	//World space bounds of the mesh, recalculated when the transform or mesh changes
+	glm::vec3 m_boundsCentre = glm::vec3(0.0f);
+	glm::vec3 m_boundsExtents = glm::vec3(0.0f);
+	glm::vec4 m_boundingSphere = glm::vec4(0.0f);
+	bool m_boundsDirty = true;
+
+	void UpdateBounds();
+
 public:
 	bool m_orthoProject = false;
 
@@ -66,10 +102,20 @@ public:
 
 	~CShape();
 
-	void SetProgram(GLuint _program) { m_program = _program; };
+	void SetProgram(GLuint _program);
 	void SetCamera(CCamera* _camera) { m_camera = _camera; };
-	void SetMesh(CMesh* _mesh) { m_mesh = _mesh; };
-	void SetPosition(glm::vec3 _pos) { m_position = _pos; };
+	void SetMesh(CMesh* _mesh) { m_mesh = _mesh; m_boundsDirty = true; };
+	void SetPosition(glm::vec3 _pos) { m_position = _pos; m_boundsDirty = true; };
+	void SetRenderPass(RenderPass _pass) { m_renderPass = _pass; };
+	void SetShadowCaster(bool _casts) { m_shadowCaster = _casts; };
+	void SetStatic(bool _static) { m_static = _static; };
+
+	GLuint GetProgram() { return m_program; };
+	CMesh* GetMesh() { return m_mesh; };
+	RenderPass GetRenderPass() { return m_renderPass; };
+	bool IsShadowCaster() { return m_shadowCaster; };
+	bool IsStatic() { return m_static; };
+	void GetTextureSet(std::array<GLuint, 4>& _textures);
 
 	glm::mat4 GetPVM() { return m_PVMMat; };
 	glm::mat4 GetModel() { return m_modelMat; };
@@ -80,15 +126,24 @@ public:
 	glm::vec3 Up() { return glm::vec3(m_modelMat[0][1], m_modelMat[1][1], m_modelMat[2][1]); };
 	glm::vec3 Forward() { return glm::vec3(m_modelMat[2][0], m_modelMat[2][1], m_modelMat[2][2]); };
 
-	void Scale(float _s) { m_scale *= _s; };
+	void Scale(float _s) { m_scale *= _s; m_boundsDirty = true; };
+
+	//World space box (centre and half size) and sphere (xyz centre, w radius)
+	glm::vec3 GetBoundsCentre() { UpdateBounds(); return m_boundsCentre; };
+	glm::vec3 GetBoundsExtents() { UpdateBounds(); return m_boundsExtents; };
+	glm::vec4 GetBoundingSphere() { UpdateBounds(); return m_boundingSphere; };
+	bool IsInView();
 
 
 	//Adding/updating uniforms
-	void AddUniform(CUniform* _uniform);
-	void UpdateUniform(CUniform* _NewUniform);
+	CUniformBlock& GetUniforms() { return m_uniforms; };
+	void SendUniforms(GLuint _program) { m_uniforms.SendTo(_program); };
+	void SetAnimation(GLuint _texture, int _frameCount, float _secondsPerFrame);
 
 	void Update(float deltaTime, float currentTime);
 	void Render();
+	void Draw();
 
+	void UpdateModelMat();
 	void UpdatePVM();
 };
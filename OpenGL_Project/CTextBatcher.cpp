@@ -0,0 +1,136 @@
+#include "CTextBatcher.h"
+#include "CGLState.h"
+#include "ShaderLoader.h"
+#include "Utility.h"
+
+std::vector<CTextBatcher::Submission> CTextBatcher::m_submissions;
+std::vector<TextGlyph> CTextBatcher::m_glyphs;
+std::vector<TextLabelData> CTextBatcher::m_labels;
+std::vector<CTextBatcher::Batch> CTextBatcher::m_batches;
+GLuint CTextBatcher::m_program = NULL;
+GLuint CTextBatcher::m_vertexArray = NULL;
+GLuint CTextBatcher::m_glyphBuffer = NULL;
+GLuint CTextBatcher::m_labelBuffer = NULL;
+GLsizeiptr CTextBatcher::m_glyphCapacity = 0;
+GLsizeiptr CTextBatcher::m_labelCapacity = 0;
+TextBatchStats CTextBatcher::m_stats;
+
+/// <summary>
+/// Create the program, the storage buffers and an empty VAO (quads are made from gl_VertexID)
+/// </summary>
+void CTextBatcher::Init()
+{
+	m_program = ShaderLoader::CreateProgram("text", "Resources/Shaders/Text.vert", "Resources/Shaders/Text.frag");
+
+	glCreateVertexArrays(1, &m_vertexArray);
+	glCreateBuffers(1, &m_glyphBuffer);
+	glCreateBuffers(1, &m_labelBuffer);
+}
+
+/// <summary>
+/// Queue a label's glyphs to be drawn at the end of the frame.
+/// The glyph list is read at Flush, so it must stay alive until then
+/// </summary>
+/// <param name="_atlas"> texture the glyph coordinates are for</param>
+/// <param name="_glyphs"></param>
+/// <param name="_label"></param>
+void CTextBatcher::Submit(GLuint _atlas, const std::vector<TextGlyph>& _glyphs, const TextLabelData& _label)
+{
+	if (_glyphs.empty()) return;
+
+	Submission submission;
+	submission.atlas = _atlas;
+	submission.glyphs = &_glyphs;
+	submission.label = _label;
+
+	m_submissions.push_back(submission);
+}
+
+/// <summary>
+/// Upload every submitted glyph and draw them, one instanced draw per atlas
+/// </summary>
+void CTextBatcher::Flush()
+{
+	if (m_submissions.empty()) return;
+	if (m_program == NULL) Init();
+
+	//Labels sharing a font end up next to each other
+	std::stable_sort(m_submissions.begin(), m_submissions.end(), [](const Submission& _a, const Submission& _b) { return _a.atlas < _b.atlas; });
+
+	m_glyphs.clear();
+	m_labels.clear();
+	m_batches.clear();
+
+	for (const Submission& _submission : m_submissions) {
+		if (m_batches.empty() || m_batches.back().atlas != _submission.atlas) {
+			Batch batch;
+			batch.atlas = _submission.atlas;
+			batch.first = (GLuint)m_glyphs.size();
+			m_batches.push_back(batch);
+		}
+
+		GLuint labelIndex = (GLuint)m_labels.size();
+		m_labels.push_back(_submission.label);
+
+		for (const TextGlyph& _glyph : *_submission.glyphs) {
+			m_glyphs.push_back(_glyph);
+			m_glyphs.back().label.x = labelIndex;
+		}
+
+		m_batches.back().count += (GLsizei)_submission.glyphs->size();
+	}
+
+	m_stats.labels += (int)m_labels.size();
+	m_stats.glyphs += (int)m_glyphs.size();
+	m_submissions.clear();
+
+	Upload(m_glyphBuffer, m_glyphCapacity, m_glyphs.data(), m_glyphs.size() * sizeof(TextGlyph));
+	Upload(m_labelBuffer, m_labelCapacity, m_labels.data(), m_labels.size() * sizeof(TextLabelData));
+
+	CGLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, GLYPH_BINDING, m_glyphBuffer);
+	CGLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, LABEL_BINDING, m_labelBuffer);
+
+	//Disable depth test for text
+	bool _copyOfDepthTest = CGLState::IsEnabled(GL_DEPTH_TEST);
+	CGLState::Disable(GL_DEPTH_TEST);
+
+	//Set blend mode
+	CGLState::Enable(GL_BLEND);
+	CGLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//Shared by every label
+	glm::mat4 projection = glm::ortho(0.0f, (float)utils::windowWidth, 0.0f, (float)utils::windowHeight, 0.0f, 100.0f);
+
+	CGLState::UseProgram(m_program);
+	glUniformMatrix4fv(ShaderLoader::GetUniformLocation(m_program, "ProjectionMat"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniform1f(ShaderLoader::GetUniformLocation(m_program, "CurrentTime"), utils::currentTime);
+	glUniform1i(ShaderLoader::GetUniformLocation(m_program, "TextTexture"), 0);
+
+	CGLState::BindVertexArray(m_vertexArray);
+
+	for (const Batch& _batch : m_batches) {
+		CGLState::BindTexture(0, GL_TEXTURE_2D, _batch.atlas);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, _batch.count, _batch.first);
+		m_stats.draws++;
+	}
+
+	CGLState::Disable(GL_BLEND);
+
+	//Re enable depth testing if it was one previously
+	if (_copyOfDepthTest) CGLState::Enable(GL_DEPTH_TEST);
+}
+
+/// <summary>
+/// Replace a buffer's contents, orphaning the old storage so the GPU can keep reading last frame's
+/// </summary>
+/// <param name="_buffer"></param>
+/// <param name="_capacity"> grown if too small</param>
+/// <param name="_data"></param>
+/// <param name="_size"></param>
+void CTextBatcher::Upload(GLuint _buffer, GLsizeiptr& _capacity, const void* _data, GLsizeiptr _size)
+{
+	if (_size > _capacity) _capacity = _size * 2;
+
+	glNamedBufferData(_buffer, _capacity, NULL, GL_STREAM_DRAW);
+	glNamedBufferSubData(_buffer, 0, _size, _data);
+}
@@ -0,0 +1,102 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CTextBatcher.h
+// Description : Collects the glyphs of every text label drawn in a frame and draws them together
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include <glew.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+/// <summary>
+/// One glyph quad, layout must match Glyph in Text.vert (std430)
+/// </summary>
+struct TextGlyph
+{
+	glm::vec4 rect = glm::vec4(0.0f);		//xy = bottom left relative to the label's origin, zw = size (pixels)
+	glm::vec4 uv = glm::vec4(0.0f);			//xy = top left, zw = bottom right (atlas texture coordinates)
+	glm::uvec4 label = glm::uvec4(0);		//x = label index, set by the batcher
+};
+
+/// <summary>
+/// Per label values, layout must match Label in Text.vert and Text.frag (std430)
+/// </summary>
+struct TextLabelData
+{
+	glm::vec4 origin = glm::vec4(0.0f);						//xy = label position on screen
+	glm::vec4 colour = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);	//rgb = colour, a = 1 for SDF glyphs
+	glm::vec4 clip = glm::vec4(0.0f);						//x = left, y = right, z = scroll speed (0 for none), w = hidden margin inside the range
+	glm::vec4 bounce = glm::vec4(0.0f);						//xy = centre scaled around (on screen), z = 1 to bounce
+};
+
+/// <summary>
+/// Counts for the current frame
+/// </summary>
+struct TextBatchStats
+{
+	int labels = 0;
+	int glyphs = 0;
+	int draws = 0;
+};
+
+class CTextBatcher
+{
+private:
+	/// <summary>
+	/// A label waiting to be drawn
+	/// </summary>
+	struct Submission
+	{
+		GLuint atlas = 0;
+		const std::vector<TextGlyph>* glyphs = nullptr;
+		TextLabelData label;
+	};
+
+	/// <summary>
+	/// Glyphs using the same atlas, drawn in one call
+	/// </summary>
+	struct Batch
+	{
+		GLuint atlas = 0;
+		GLuint first = 0;
+		GLsizei count = 0;
+	};
+
+	static const GLuint GLYPH_BINDING = 2;
+	static const GLuint LABEL_BINDING = 3;
+
+	static std::vector<Submission> m_submissions;
+	static std::vector<TextGlyph> m_glyphs;
+	static std::vector<TextLabelData> m_labels;
+	static std::vector<Batch> m_batches;
+
+	static GLuint m_program;
+	static GLuint m_vertexArray;
+	static GLuint m_glyphBuffer;
+	static GLuint m_labelBuffer;
+	static GLsizeiptr m_glyphCapacity;
+	static GLsizeiptr m_labelCapacity;
+
+	static TextBatchStats m_stats;
+
+	static void Init();
+	static void Upload(GLuint _buffer, GLsizeiptr& _capacity, const void* _data, GLsizeiptr _size);
+
+public:
+	static void Submit(GLuint _atlas, const std::vector<TextGlyph>& _glyphs, const TextLabelData& _label);
+	static void Flush();
+
+	static void NewFrame() { m_stats = TextBatchStats(); };
+	static TextBatchStats GetStats() { return m_stats; };
+};
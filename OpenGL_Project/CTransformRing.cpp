@@ -0,0 +1,124 @@
+#include "CTransformRing.h"
+#include "CGLState.h"
+
+GLuint CTransformRing::m_buffer = NULL;
+ObjectData* CTransformRing::m_mapped = nullptr;
+GLsync CTransformRing::m_fences[FRAME_COUNT] = { 0 };
+int CTransformRing::m_frame = 0;
+int CTransformRing::m_count = 0;
+int CTransformRing::m_capacity = 0;
+
+/// <summary>
+/// Create the buffer with room for _capacity objects per frame, and map it once for as long as it is used
+/// </summary>
+/// <param name="_capacity"></param>
+void CTransformRing::Create(int _capacity)
+{
+	GLsizeiptr size = (GLsizeiptr)sizeof(ObjectData) * _capacity * FRAME_COUNT;
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, size, NULL, flags);
+	m_mapped = (ObjectData*)glMapNamedBufferRange(m_buffer, 0, size, flags);
+	m_capacity = _capacity;
+
+	if (m_mapped == nullptr) {
+		std::cout << "ERROR: Failed to map transform ring buffer" << std::endl;
+	}
+}
+
+/// <summary>
+/// Replace the buffer with one twice as big, part way through a frame.
+/// Objects already pushed this frame are copied over at the same indices, draws already made keep reading the old
+/// buffer (it is only freed once the GPU is done with it)
+/// </summary>
+void CTransformRing::Grow()
+{
+	GLuint oldBuffer = m_buffer;
+	std::vector<ObjectData> pushed(m_mapped + m_frame * m_capacity, m_mapped + m_frame * m_capacity + m_count);
+
+	glUnmapNamedBuffer(oldBuffer);
+	CGLState::DeleteBuffers(1, &oldBuffer);
+
+	Create(m_capacity * 2);
+	if (m_mapped == nullptr) return;
+
+	std::copy(pushed.begin(), pushed.end(), m_mapped + m_frame * m_capacity);
+
+	BindFrame();
+}
+
+/// <summary>
+/// Bind this frame's part of the ring for the shaders
+/// </summary>
+void CTransformRing::BindFrame()
+{
+	GLsizeiptr frameSize = (GLsizeiptr)sizeof(ObjectData) * m_capacity;
+	CGLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, m_buffer, frameSize * m_frame, frameSize);
+}
+
+/// <summary>
+/// Move to the next third of the ring, waiting until the GPU is done with it, and bind it for the shaders
+/// </summary>
+void CTransformRing::BeginFrame()
+{
+	if (m_buffer == NULL) Create(INITIAL_OBJECTS);
+
+	m_frame = (m_frame + 1) % FRAME_COUNT;
+	m_count = 0;
+
+	//Wait for the GPU to finish reading this part (normally already done)
+	GLsync& fence = m_fences[m_frame];
+	if (fence) {
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	BindFrame();
+}
+
+/// <summary>
+/// Mark this part of the ring as in use by the GPU until all of this frame's draws are done
+/// </summary>
+void CTransformRing::EndFrame()
+{
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/// <summary>
+/// Write an object's data for this frame
+/// </summary>
+/// <param name="_data"></param>
+/// <returns> index for the shaders to read it with (passed as the base instance of the draw)</returns>
+int CTransformRing::Push(const ObjectData& _data)
+{
+	if (m_mapped == nullptr) return 0;
+
+	if (m_count >= m_capacity) {
+		Grow();
+		if (m_mapped == nullptr) return 0;
+	}
+
+	m_mapped[m_frame * m_capacity + m_count] = _data;
+	return m_count++;
+}
+
+/// <summary>
+/// Write an object's matrices for this frame, calculating the normal matrix
+/// </summary>
+/// <param name="_model"></param>
+/// <param name="_PVM"></param>
+/// <returns> index for the shaders to read it with</returns>
+int CTransformRing::Push(const glm::mat4& _model, const glm::mat4& _PVM)
+{
+	ObjectData data;
+	data.model = _model;
+	data.PVM = _PVM;
+	data.normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(_model))));
+
+	return Push(data);
+}
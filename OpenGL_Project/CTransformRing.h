@@ -0,0 +1,63 @@
+// Bachelor of Software Engineering
+// Media Design School
+// Auckland
+// New Zealand
+// (c) 2021 Media Design School
+//
+// File Name   : CTransformRing.h
+// Description : Triple buffered, persistently mapped storage buffer holding every drawn object's matrices for the frame
+// Author      : Keane Carotenuto
+// Mail        : KeaneCarotenuto@gmail.com
+
+#pragma once
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <glew.h>
+#include <glm.hpp>
+
+/// <summary>
+/// Per object data read by the vertex shaders, layout must match Resources/Shaders/ObjectData.glsl (std430)
+/// </summary>
+struct ObjectData
+{
+	glm::mat4 model;
+	glm::mat4 PVM;
+	glm::mat4 normal;
+	glm::vec4 rim = glm::vec4(0.0f);		//rgb = rim colour, a = rim exponent
+	glm::vec4 params = glm::vec4(0.0f);	//x = reflectivity
+};
+
+class CTransformRing
+{
+private:
+	//Frames the CPU can be ahead of the GPU
+	static const int FRAME_COUNT = 3;
+
+	//Objects each frame has room for to start with, doubled whenever a frame needs more
+	static const int INITIAL_OBJECTS = 16384;
+
+	static const GLuint BINDING = 0;
+
+	static GLuint m_buffer;
+	static ObjectData* m_mapped;
+	static GLsync m_fences[FRAME_COUNT];
+
+	static int m_frame;
+	static int m_count;
+	static int m_capacity;
+
+	static void Create(int _capacity);
+	static void Grow();
+	static void BindFrame();
+
+public:
+	static void BeginFrame();
+	static void EndFrame();
+
+	static int Push(const ObjectData& _data);
+	static int Push(const glm::mat4& _model, const glm::mat4& _PVM);
+
+	static int GetCount() { return m_count; };
+};
@@ -1 +1,416 @@
-#include "CUniform.h"
\ No newline at end of file
+#include "CUniform.h"
+#include "CGLState.h"
+
+#include <cstring>
+#include <algorithm>
+
+uint64_t CUniformBlock::m_nextID = 1;
+UniformStats CUniformBlock::m_stats;
+
+CUniformBlock::CUniformBlock()
+{
+	m_id = m_nextID++;
+}
+
+/// <summary>
+/// Switch the program values are sent to. Locations are only looked up by name the first time a program is used,
+/// after that they come from its table, along with the values it has missed since
+/// </summary>
+/// <param name="_program"></param>
+void CUniformBlock::SetProgram(GLuint _program)
+{
+	CProgram* program = ShaderLoader::GetProgram(_program);
+	if (program == m_program && m_current >= 0) return;
+
+	if (m_current >= 0) m_programs[m_current].dirty = m_dirty;
+
+	m_program = program;
+	m_current = -1;
+	if (m_program == nullptr) {
+		for (Slot& _slot : m_slots) {
+			_slot.location = -1;
+			_slot.unit = -1;
+		}
+		m_dirty = ~0ull;
+		return;
+	}
+
+	for (size_t i = 0; i < m_programs.size(); i++) {
+		if (m_programs[i].program == m_program) {
+			m_current = (int)i;
+			break;
+		}
+	}
+	if (m_current < 0) {
+		ProgramSlots entry;
+		entry.program = m_program;
+		m_programs.push_back(entry);
+		m_current = (int)m_programs.size() - 1;
+	}
+
+	//Shapes may carry uniforms only some of their programs use, so don't warn here (adding one already does).
+	//Slots added while another program was current are resolved now
+	ProgramSlots& entry = m_programs[m_current];
+	for (size_t i = entry.locations.size(); i < m_slots.size(); i++) {
+		const UniformInfo* info = m_program->GetUniformInfo(m_slots[i].name);
+		entry.locations.push_back(info ? info->location : -1);
+		entry.units.push_back(info ? info->unit : -1);
+	}
+
+	for (size_t i = 0; i < m_slots.size(); i++) {
+		m_slots[i].location = entry.locations[i];
+		m_slots[i].unit = entry.units[i];
+	}
+
+	m_dirty = entry.dirty;
+}
+
+/// <summary>
+/// Index of a uniform by name
+/// </summary>
+/// <param name="_name"></param>
+/// <returns> -1 if the block does not have it</returns>
+int CUniformBlock::Find(const std::string& _name) const
+{
+	for (size_t i = 0; i < m_slots.size(); i++) {
+		if (m_slots[i].name == _name) return (int)i;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Make room for a new uniform at the end of the buffer, checking it against the program's reflected type
+/// </summary>
+/// <param name="_name"></param>
+/// <param name="_type"></param>
+/// <returns> slot index, -1 if the block is full</returns>
+int CUniformBlock::AddSlot(const std::string& _name, UniformType _type)
+{
+	if (m_slots.size() >= MAX_SLOTS) {
+		std::cout << "ERROR: Too many uniforms on one shape, " << _name << " not added." << std::endl;
+		return -1;
+	}
+
+	Slot slot;
+	slot.name = _name;
+	slot.type = _type;
+	slot.offset = (uint16_t)m_data.size();
+
+	if (m_program) {
+		slot.location = m_program->GetUniformLocation(_name);
+
+		const UniformInfo* info = m_program->GetUniformInfo(_name);
+		if (info && !MatchesType(_type, info->type)) {
+			std::cout << "WARNING: Uniform " << _name << " is set with a different type than program " << m_program->m_name << " declares." << std::endl;
+		}
+		if (info) slot.unit = info->unit;
+
+		if (m_current >= 0) {
+			m_programs[m_current].locations.push_back(slot.location);
+			m_programs[m_current].units.push_back(slot.unit);
+		}
+	}
+
+	m_data.resize(m_data.size() + GetSize(_type), 0);
+	m_slots.push_back(slot);
+
+	return (int)m_slots.size() - 1;
+}
+
+/// <summary>
+/// Set a uniform by name, adding it if needed
+/// </summary>
+/// <param name="_name"></param>
+/// <param name="_type"></param>
+/// <param name="_value"> GetSize(_type) bytes</param>
+void CUniformBlock::SetValue(const std::string& _name, UniformType _type, const void* _value)
+{
+	int slot = Find(_name);
+	if (slot < 0) {
+		slot = AddSlot(_name, _type);
+		if (slot < 0) return;
+
+		//New values always need sending
+		std::memcpy(&m_data[m_slots[slot].offset], _value, GetSize(_type));
+		MarkDirty(slot);
+		return;
+	}
+
+	if (m_slots[slot].type != _type) {
+		std::cout << "ERROR: Uniform " << _name << " set with a different type than it was added with." << std::endl;
+		return;
+	}
+
+	SetValue(slot, _value);
+}
+
+/// <summary>
+/// Copy a new value into a slot, marking it dirty only if it changed
+/// </summary>
+/// <param name="_slot"></param>
+/// <param name="_value"></param>
+void CUniformBlock::SetValue(int _slot, const void* _value)
+{
+	if (_slot < 0 || _slot >= (int)m_slots.size()) return;
+
+	Slot& slot = m_slots[_slot];
+	uint16_t size = GetSize(slot.type);
+	unsigned char* data = &m_data[slot.offset];
+
+	if (std::memcmp(data, _value, size) == 0) return;
+
+	std::memcpy(data, _value, size);
+	MarkDirty(_slot);
+}
+
+/// <summary>
+/// A value changed, so every program the block has been used with needs it again
+/// </summary>
+/// <param name="_slot"></param>
+void CUniformBlock::MarkDirty(int _slot)
+{
+	m_dirty |= (1ull << _slot);
+
+	for (ProgramSlots& _entry : m_programs) {
+		_entry.dirty |= (1ull << _slot);
+	}
+}
+
+/// <summary>
+/// Get a float uniform's value
+/// </summary>
+/// <param name="_name"></param>
+/// <param name="_value"> unchanged if not found</param>
+/// <returns> if found</returns>
+bool CUniformBlock::GetFloat(const std::string& _name, float& _value) const
+{
+	int slot = Find(_name);
+	if (slot < 0 || m_slots[slot].type != UniformType::Float) return false;
+
+	std::memcpy(&_value, &m_data[m_slots[slot].offset], sizeof(float));
+	return true;
+}
+
+/// <summary>
+/// Get a vec3 uniform's value
+/// </summary>
+/// <param name="_name"></param>
+/// <param name="_value"> unchanged if not found</param>
+/// <returns> if found</returns>
+bool CUniformBlock::GetVec3(const std::string& _name, glm::vec3& _value) const
+{
+	int slot = Find(_name);
+	if (slot < 0 || m_slots[slot].type != UniformType::Vec3) return false;
+
+	std::memcpy(glm::value_ptr(_value), &m_data[m_slots[slot].offset], sizeof(glm::vec3));
+	return true;
+}
+
+/// <summary>
+/// Fills list with the textures this block binds (0 for unused slots)
+/// </summary>
+/// <param name="_textures"></param>
+void CUniformBlock::GetTextures(std::array<GLuint, 4>& _textures) const
+{
+	int count = 0;
+	_textures.fill(0);
+
+	for (const Slot& _slot : m_slots) {
+		if (_slot.type != UniformType::Texture2D && _slot.type != UniformType::TextureCube) continue;
+
+		GLuint texture = 0;
+		std::memcpy(&texture, &m_data[_slot.offset], sizeof(GLuint));
+
+		if (texture != NULL && count < 4) {
+			_textures[count++] = texture;
+		}
+	}
+}
+
+/// <summary>
+/// Hash of every non texture uniform's name and value (FNV-1a), blocks with the same hash send the same values
+/// </summary>
+/// <param name="_skip"> names to leave out</param>
+/// <param name="_skipCount"></param>
+/// <returns></returns>
+uint64_t CUniformBlock::HashValues(const std::string* _skip, int _skipCount) const
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (const Slot& _slot : m_slots) {
+		if (_slot.type == UniformType::Texture2D || _slot.type == UniformType::TextureCube) continue;
+		if (std::find(_skip, _skip + _skipCount, _slot.name) != _skip + _skipCount) continue;
+
+		for (char _character : _slot.name) {
+			hash = (hash ^ (unsigned char)_character) * 1099511628211ull;
+		}
+
+		for (uint16_t i = 0; i < GetSize(_slot.type); i++) {
+			hash = (hash ^ m_data[_slot.offset + i]) * 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+/// <summary>
+/// Send to the block's program, which must be in use.
+/// If the program last received this block, only changed values are sent
+/// </summary>
+void CUniformBlock::Send()
+{
+	if (m_program == nullptr) return;
+
+	bool sendAll = (m_program->m_lastBlock != m_id);
+	m_program->m_lastBlock = m_id;
+
+	for (size_t i = 0; i < m_slots.size(); i++) {
+		const Slot& slot = m_slots[i];
+
+		//Textures are bound every draw as other shapes may have replaced them, the sampler's unit was set when the program was linked
+		if (slot.type == UniformType::Texture2D || slot.type == UniformType::TextureCube) {
+			if (slot.type == UniformType::TextureCube) CGLState::Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+			BindSlotTexture(slot, slot.unit);
+			continue;
+		}
+
+		if (slot.location < 0) continue;
+
+		if (!sendAll && (m_dirty & (1ull << i)) == 0) {
+			m_stats.skipped++;
+			continue;
+		}
+
+		SendSlot(slot, slot.location);
+	}
+
+	m_dirty = 0;
+}
+
+/// <summary>
+/// Send every value to a different program than the block's own (e.g. an instanced variant), which must be in use
+/// </summary>
+/// <param name="_program"></param>
+void CUniformBlock::SendTo(GLuint _program)
+{
+	CProgram* program = ShaderLoader::GetProgram(_program);
+	if (program == nullptr) return;
+
+	//Values now in the program are not tracked by any block
+	program->m_lastBlock = 0;
+
+	for (const Slot& _slot : m_slots) {
+		//The variant may leave out some uniforms on purpose (e.g. per instance values), so don't warn
+		const UniformInfo* info = program->GetUniformInfo(_slot.name);
+		if (info == nullptr) continue;
+
+		if (_slot.type == UniformType::Texture2D || _slot.type == UniformType::TextureCube) {
+			BindSlotTexture(_slot, info->unit);
+			continue;
+		}
+
+		SendSlot(_slot, info->location);
+	}
+}
+
+/// <summary>
+/// Bind a texture slot's value to the unit its sampler reads from
+/// </summary>
+/// <param name="_slot"></param>
+/// <param name="_unit"> -1 if the program does not sample it</param>
+void CUniformBlock::BindSlotTexture(const Slot& _slot, GLint _unit)
+{
+	if (_unit < 0) return;
+
+	GLuint texture = 0;
+	std::memcpy(&texture, &m_data[_slot.offset], sizeof(GLuint));
+	CGLState::BindTexture((GLuint)_unit, (_slot.type == UniformType::Texture2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP), texture);
+}
+
+/// <summary>
+/// Upload one value
+/// </summary>
+/// <param name="_slot"></param>
+/// <param name="_location"></param>
+void CUniformBlock::SendSlot(const Slot& _slot, GLint _location)
+{
+	const unsigned char* data = &m_data[_slot.offset];
+	m_stats.sent++;
+
+	switch (_slot.type)
+	{
+	case UniformType::Int: {
+		int value = 0;
+		std::memcpy(&value, data, sizeof(int));
+		glUniform1i(_location, value);
+		break;
+	}
+	case UniformType::Float: {
+		float value = 0;
+		std::memcpy(&value, data, sizeof(float));
+		glUniform1f(_location, value);
+		break;
+	}
+	case UniformType::Vec2:
+		glUniform2fv(_location, 1, (const GLfloat*)data);
+		break;
+
+	case UniformType::Vec3:
+		glUniform3fv(_location, 1, (const GLfloat*)data);
+		break;
+
+	case UniformType::Vec4:
+		glUniform4fv(_location, 1, (const GLfloat*)data);
+		break;
+
+	case UniformType::Mat4:
+		glUniformMatrix4fv(_location, 1, GL_FALSE, (const GLfloat*)data);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/// <summary>
+/// Bytes a value of this type takes in the buffer
+/// </summary>
+/// <param name="_type"></param>
+/// <returns></returns>
+uint16_t CUniformBlock::GetSize(UniformType _type)
+{
+	switch (_type)
+	{
+	case UniformType::Int: return sizeof(int);
+	case UniformType::Float: return sizeof(float);
+	case UniformType::Vec2: return sizeof(glm::vec2);
+	case UniformType::Vec3: return sizeof(glm::vec3);
+	case UniformType::Vec4: return sizeof(glm::vec4);
+	case UniformType::Mat4: return sizeof(glm::mat4);
+	case UniformType::Texture2D: return sizeof(GLuint);
+	case UniformType::TextureCube: return sizeof(GLuint);
+	default: return 0;
+	}
+}
+
+/// <summary>
+/// Does a uniform type match the type the program reflected
+/// </summary>
+/// <param name="_type"></param>
+/// <param name="_glType"></param>
+/// <returns></returns>
+bool CUniformBlock::MatchesType(UniformType _type, GLenum _glType)
+{
+	switch (_type)
+	{
+	case UniformType::Int: return (_glType == GL_INT || _glType == GL_BOOL);
+	case UniformType::Float: return (_glType == GL_FLOAT);
+	case UniformType::Vec2: return (_glType == GL_FLOAT_VEC2);
+	case UniformType::Vec3: return (_glType == GL_FLOAT_VEC3);
+	case UniformType::Vec4: return (_glType == GL_FLOAT_VEC4);
+	case UniformType::Mat4: return (_glType == GL_FLOAT_MAT4);
+	case UniformType::Texture2D: return (_glType == GL_SAMPLER_2D);
+	case UniformType::TextureCube: return (_glType == GL_SAMPLER_CUBE);
+	default: return false;
+	}
+}
@@ -2,234 +2,135 @@
 // Media Design School
 // Auckland
 // New Zealand
-// 
+//
 // (c) 2021 Media Design School
 //
 // File Name   : CUniform.h
-// Description : Contains datastructures to create Uniforms for shapes
+// Description : Per shape uniform values, stored by value in one buffer and only sent to the program when changed
 // Author      : Keane Carotenuto
 // Mail        : KeaneCarotenuto@gmail.com
 
 #pragma once
 #include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
 #include <glew.h>
 #include <glm.hpp>
 #include <gtc/type_ptr.hpp>
 
-#include "CShape.h"
-
-class CUniform {
-public:
-	CUniform(std::string _name) : name(_name) {};
-	std::string name;
-	GLint location = NULL;
-	virtual void Send(CShape * _shape) = 0;
+#include "ShaderLoader.h"
+
+enum class UniformType : uint8_t
+{
+	Int,
+	Float,
+	Vec2,
+	Vec3,
+	Vec4,
+	Mat4,
+	Texture2D,
+	TextureCube,
 };
 
 /// <summary>
-/// Uniform for "static" images
+/// Counts of uniform uploads for the current frame
 /// </summary>
-class ImageUniform : public CUniform { 
-public:
-	ImageUniform(GLuint _val, std::string _name): CUniform(_name),
-		value(_val)
-	{
+struct UniformStats
+{
+	//glUniform calls made
+	int sent = 0;
 
-	}
-
-	GLuint value = NULL;
-	void Send(CShape * _shape) {
-		//Activate and bind texture
-		glActiveTexture(GL_TEXTURE0 + value);
-		glBindTexture(GL_TEXTURE_2D, value);
-		glUniform1i(location, value);
-	}
+	//Values that were already current in the program so were not sent
+	int skipped = 0;
 };
 
-/// <summary>
-/// Uniform for "static" images
-/// </summary>
-class CubemapUniform : public CUniform {
-public:
-	CubemapUniform(GLuint _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
-
-	}
-
-	GLuint value = NULL;
-	void Send(CShape* _shape) {
-		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
-
-		//Activate and bind texture
-		glActiveTexture(GL_TEXTURE0 + value);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, value);
-		glUniform1i(location, value);
-	}
-};
+class CUniformBlock
+{
+private:
+	//One dirty bit per uniform
+	static const int MAX_SLOTS = 64;
 
-/// <summary>
-/// uniform for floats
-/// </summary>
-class FloatUniform : public CUniform {
-public:
-	FloatUniform(float _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
-
-	}
-
-	float value;
-	void Send(CShape* _shape) {
-		glUniform1f(location, value);
-	}
-};
-
-/// <summary>
-/// Uniform for animated images
-/// </summary>
-class AnimationUniform : public CUniform { 
-public:
 	/// <summary>
-	/// 
+	/// Where a uniform's value lives in the buffer, and its location (and unit, for textures) in the current program
 	/// </summary>
-	/// <param name="_va">Image GLuint</param>
-	/// <param name="_count">Amount of frames in image</param>
-	/// <param name="_speed">Seconds per frame</param>
-	/// <param name="_shape">The shape that is using the image</param>
-	/// <returns></returns>
-	AnimationUniform(GLuint _val, int _count, float _speed, CShape* _shape, std::string _name) : CUniform(_name),
-		value(_val),
-		frameCount(_count),
-		SPF(_speed)
+	struct Slot
 	{
-		
-	}
-
-	GLuint value = NULL;
-	int frameCount = NULL;
-	float SPF = NULL;
-	int currentFrame = 0;
-	float lastFrameTime = 0;
-
-	void Send(CShape * _shape) {
-		//Activate and bind texture
-		glActiveTexture(GL_TEXTURE0 + value);
-		glBindTexture(GL_TEXTURE_2D, value);
-		glUniform1i(location, value);
+		std::string name;
+		UniformType type = UniformType::Float;
+		uint16_t offset = 0;
+		GLint location = -1;
+		GLint unit = -1;
+	};
 
-		//Increment the current frame based on speed defined
-		if (utils::currentTime >= lastFrameTime + SPF) {
-			lastFrameTime = utils::currentTime;
-			currentFrame++;
-
-			if (currentFrame >= frameCount) currentFrame = 0;
-		}
-
-		float newVal = (float)currentFrame * (1.0f / frameCount);
-
-		_shape->UpdateUniform(new FloatUniform(newVal, "offset"));
-	}
-};
-
-/// <summary>
-/// Uniform for ints...
-/// </summary>
-class IntUniform : public CUniform { 
-public:
-	IntUniform(int _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
-
-	}
-
-	int value;
-	void Send(CShape * _shape) {
-		glUniform1i(location, value);
-	}
-};
-
-/// <summary>
-/// Uniform for ints...
-/// </summary>
-class BoolUniform : public CUniform {
-public:
-	BoolUniform(bool _val, std::string _name) : CUniform(_name),
-		value(_val)
+	/// <summary>
+	/// Every slot's location and unit in a program the block has been used with, and which values it is missing,
+	/// so switching back to it needs no name lookups and only sends what changed
+	/// </summary>
+	struct ProgramSlots
 	{
+		CProgram* program = nullptr;
+		std::vector<GLint> locations;
+		std::vector<GLint> units;
+		uint64_t dirty = ~0ull;
+	};
 
-	}
-
-	int value;
-	void Send(CShape* _shape) {
-		glUniform1i(location, value);
-	}
-};
+	std::vector<Slot> m_slots;
+	std::vector<unsigned char> m_data;
 
-/// <summary>
-/// Uniform for glm::mat4
-/// </summary>
-class Mat4Uniform : public CUniform { 
-public:
-	Mat4Uniform(glm::mat4 _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
+	//Values the current program is missing, the others keep theirs in m_programs
+	uint64_t m_dirty = 0;
 
-	}
+	//Program locations are resolved against
+	CProgram* m_program = nullptr;
+	std::vector<ProgramSlots> m_programs;
+	int m_current = -1;
 
-	glm::mat4 value;
-	void Send(CShape * _shape) {
-		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
-	}
-};
+	//Lets a program know whose values it last received, so unchanged values can be skipped
+	uint64_t m_id = 0;
+	static uint64_t m_nextID;
 
-/// <summary>
-/// Uniform for glm::vec3
-/// </summary>
-class Vec3Uniform : public CUniform { 
-public:
-	Vec3Uniform(glm::vec3 _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
+	static UniformStats m_stats;
 
-	}
+	int AddSlot(const std::string& _name, UniformType _type);
+	void MarkDirty(int _slot);
+	void SetValue(const std::string& _name, UniformType _type, const void* _value);
+	void SetValue(int _slot, const void* _value);
+	void SendSlot(const Slot& _slot, GLint _location);
+	void BindSlotTexture(const Slot& _slot, GLint _unit);
 
-	glm::vec3 value;
-	void Send(CShape * _shape){
-		glUniform3fv(location, 1, glm::value_ptr(value));
-	}
-};
+	static uint16_t GetSize(UniformType _type);
+	static bool MatchesType(UniformType _type, GLenum _glType);
 
-/// <summary>
-/// Uniform for glm::vec2
-/// </summary>
-class Vec2Uniform : public CUniform {
 public:
-	Vec2Uniform(glm::vec2 _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
-
-	}
-
-	glm::vec2 value;
-	void Send(CShape* _shape){
-		glUniform2fv(location, 1, glm::value_ptr(value));
-	}
+	CUniformBlock();
+
+	void SetProgram(GLuint _program);
+	int Find(const std::string& _name) const;
+
+	//Setters add the uniform the first time a name is used
+	void SetInt(const std::string& _name, int _value) { SetValue(_name, UniformType::Int, &_value); };
+	void SetBool(const std::string& _name, bool _value) { SetInt(_name, (int)_value); };
+	void SetFloat(const std::string& _name, float _value) { SetValue(_name, UniformType::Float, &_value); };
+	void SetVec2(const std::string& _name, const glm::vec2& _value) { SetValue(_name, UniformType::Vec2, glm::value_ptr(_value)); };
+	void SetVec3(const std::string& _name, const glm::vec3& _value) { SetValue(_name, UniformType::Vec3, glm::value_ptr(_value)); };
+	void SetVec4(const std::string& _name, const glm::vec4& _value) { SetValue(_name, UniformType::Vec4, glm::value_ptr(_value)); };
+	void SetMat4(const std::string& _name, const glm::mat4& _value) { SetValue(_name, UniformType::Mat4, glm::value_ptr(_value)); };
+	void SetTexture(const std::string& _name, GLuint _texture) { SetValue(_name, UniformType::Texture2D, &_texture); };
+	void SetCubemap(const std::string& _name, GLuint _texture) { SetValue(_name, UniformType::TextureCube, &_texture); };
+
+	//Setters by slot (from Find), for values updated every frame
+	void SetInt(int _slot, int _value) { SetValue(_slot, &_value); };
+	void SetFloat(int _slot, float _value) { SetValue(_slot, &_value); };
+
+	bool GetFloat(const std::string& _name, float& _value) const;
+	bool GetVec3(const std::string& _name, glm::vec3& _value) const;
+	void GetTextures(std::array<GLuint, 4>& _textures) const;
+	uint64_t HashValues(const std::string* _skip, int _skipCount) const;
+
+	void Send();
+	void SendTo(GLuint _program);
+
+	static void NewFrame() { m_stats = UniformStats(); };
+	static UniformStats GetStats() { return m_stats; };
 };
-
-/// <summary>
-/// Uniform for glm::vec4
-/// </summary>
-class Vec4Uniform : public CUniform {
-public:
-	Vec4Uniform(glm::vec4 _val, std::string _name) : CUniform(_name),
-		value(_val)
-	{
-
-	}
-
-	glm::vec4 value;
-	void Send(CShape* _shape) {
-		glUniform4fv(location, 1, glm::value_ptr(value));
-	}
-};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#version 460 core
+
+//Lit shader for static shapes, their lighting was baked by CLightmapBaker so only the directional highlight and reflection are per pixel.
+//The bake only sees static casters, shadows from moving ones (shadow maps) and ambient occlusion are taken off the baked light here
+in vec2 FragTexCoords;
+in vec3 FragNormal;
+in vec3 FragPos;
+in vec2 screenPos;
+
+flat in vec4 FragRim;
+flat in float FragReflectivity;
+
+uniform sampler2D ImageTexture;
+uniform sampler2D ReflectionMap;
+uniform bool hasRefMap = true;
+
+uniform float offset;
+uniform int frameCount;
+
+//Every static shape's lightmap packed together, rgb = ambient and diffuse from every light, a = how much of the directional light reaches the texel
+layout (binding = 21) uniform sampler2D Lightmap;
+
+//xy scales and zw offsets the mesh's texture coords into this shape's part of the atlas
+uniform vec4 LightmapTransform = vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+out vec4 FinalColor;
+
+#include "Lighting.glsl"
+
+void main()
+{
+	vec4 baked = texture(Lightmap, FragTexCoords * LightmapTransform.xy + LightmapTransform.zw);
+
+	vec3 normal = normalize(FragNormal);
+	vec3 lightDir = normalize(DirLight.Direction);
+
+	//The cascades see every caster, so the darker of the two is used and static shadows aren't applied twice
+	float dirVisibility = min(baked.a, CalcDirShadow(lightDir, normal));
+	float dirDiffuse = max(dot(normal, -lightDir), 0.0f);
+
+	//Light the bake counted that the realtime shadows block, and the ambient it counted, per light the same as CalcPointLight/CalcDirLight
+	vec3 shadowed = dirDiffuse * DirLight.Colour * (baked.a - dirVisibility);
+	vec3 ambient = DirLight.AmbientStrength * DirLight.Colour;
+
+	uvec2 cluster = Clusters[GetCluster()];
+	for (uint i = 0; i < cluster.y; i++) {
+		int index = int(LightIndices[cluster.x + i]);
+		PointLight light = PointLights[index];
+
+		float Distance = length(light.Position - FragPos);
+		float Attenuation = light.AttenuationConstant + (light.AttenuationLinear * Distance) + (light.AttenuationExponent * pow(Distance, 2));
+		if (Attenuation < 1.0f) continue;
+
+		float rangeFade = clamp(1.0f - pow(Distance / light.Range, 4.0f), 0.0f, 1.0f);
+		float scale = rangeFade * rangeFade / Attenuation;
+
+		ambient += light.AmbientStrength * light.Colour * scale;
+
+		if (index < MAX_SHADOWED_POINT_LIGHTS) {
+			float pointDiffuse = max(dot(normal, normalize(light.Position - FragPos)), 0.0f);
+			shadowed += pointDiffuse * light.Colour * scale * (1.0f - CalcPointShadow(index, light.Position, normal));
+		}
+	}
+
+	//Never below the ambient, which is where a texel the bake already shadowed ends up
+	vec3 lit = max(baked.rgb - shadowed, ambient) - ambient * (1.0f - GetAmbientOcclusion());
+
+	//Specular depends on the view, so the directional light's is still added here
+	vec3 halfWayVector = normalize(-lightDir + normalize(CameraPos - FragPos));
+	float specularReflecitivity = pow(max(dot(normal, halfWayVector), 0.0f), Shininess);
+	vec3 specular = DirLight.SpecularStrength * specularReflecitivity * DirLight.Colour * dirVisibility;
+
+	vec3 LightOutpt = lit + specular;
+
+	float frameCountCopy = frameCount;
+    if (frameCountCopy <= 0) frameCountCopy = 1;
+
+	vec4 trueColour = vec4(LightOutpt, 1.0f) * texture(ImageTexture, vec2(FragTexCoords.x/frameCountCopy + offset, FragTexCoords.y));
+	vec4 reflectColour = CalcReflection();
+	float reflectionAmount = texture(ReflectionMap, FragTexCoords).r;
+	if (!hasRefMap) reflectionAmount = 1;
+
+	FinalColor = mix(trueColour, reflectColour, FragReflectivity * reflectionAmount);
+}
\ No newline at end of file
@@ -4,21 +4,36 @@ layout (location = 0) in vec3 Pos;
 layout (location = 1) in vec2 TexCoords;
 layout (location = 2) in vec3 Normal;
 
-uniform mat4 PVMMat;
-uniform mat4 Model;
+//Depth must match exactly between the depth prepass (PositionOnly.vert) and the lit draws
+invariant gl_Position;
+
+#include "ObjectData.glsl"
+
+uniform float RimExponent = 0.0f;
+uniform vec3 RimColour;
+uniform float Reflectivity;
 
 out vec2 FragTexCoords;
 out vec3 FragNormal;
 out vec3 FragPos;
 out vec2 screenPos;
 
+flat out vec4 FragRim;
+flat out float FragReflectivity;
+
 void main() 
 {
-	gl_Position = PVMMat * vec4(Pos, 1.0);
+	ObjectData object = Objects[gl_BaseInstance + gl_InstanceID];
+
+	gl_Position = object.PVM * vec4(Pos, 1.0);
 
 	FragTexCoords = TexCoords;
-	FragNormal = mat3(transpose(inverse(Model))) * Normal;
-	FragPos = vec3(Model * vec4(Pos, 1.0f));
+	FragNormal = mat3(object.Normal) * Normal;
+	FragPos = vec3(object.Model * vec4(Pos, 1.0f));
 
 	screenPos = Pos.xy;
+
+	//Material is passed through so the lighting shader works for instanced and non instanced draws
+	FragRim = vec4(RimColour, RimExponent);
+	FragReflectivity = Reflectivity;
 }
\ No newline at end of file
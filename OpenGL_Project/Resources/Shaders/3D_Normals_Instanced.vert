@@ -0,0 +1,35 @@
+#version 460 core
+
+layout (location = 0) in vec3 Pos;
+layout (location = 1) in vec2 TexCoords;
+layout (location = 2) in vec3 Normal;
+
+//Depth must match exactly between the depth prepass (PositionOnly.vert) and the lit draws
+invariant gl_Position;
+
+#include "ObjectData.glsl"
+
+out vec2 FragTexCoords;
+out vec3 FragNormal;
+out vec3 FragPos;
+out vec2 screenPos;
+
+flat out vec4 FragRim;
+flat out float FragReflectivity;
+
+void main() 
+{
+	ObjectData object = Objects[gl_BaseInstance + gl_InstanceID];
+
+	gl_Position = object.PVM * vec4(Pos, 1.0);
+
+	FragTexCoords = TexCoords;
+	FragNormal = mat3(object.Normal) * Normal;
+	FragPos = vec3(object.Model * vec4(Pos, 1.0f));
+
+	screenPos = Pos.xy;
+
+	//Material comes from the object data too, so every instance can differ
+	FragRim = object.Rim;
+	FragReflectivity = object.Params.x;
+}
\ No newline at end of file
@@ -4,14 +4,14 @@ layout (location = 0) in vec3 Pos;
 layout (location = 1) in vec3 Col;
 layout (location = 2) in vec2 TexCoords;
 
-uniform mat4 PVMMat;
+#include "ObjectData.glsl"
 
 out vec3 FragColor;
 out vec2 FragTexCoords;
 
 void main() 
 {
-	gl_Position = PVMMat * vec4(Pos, 1.0);
+	gl_Position = Objects[gl_BaseInstance + gl_InstanceID].PVM * vec4(Pos, 1.0);
 	FragColor = Col;
 	FragTexCoords = TexCoords;
 }
\ No newline at end of file
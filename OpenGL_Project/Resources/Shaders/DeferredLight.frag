@@ -0,0 +1,25 @@
+#version 460 core
+
+//Deferred full screen pass: directional light, skybox reflection, shaded once per pixel.
+//Point lights are added on top by DeferredPointLight.frag
+#include "GBuffer.glsl"
+#include "Lighting.glsl"
+
+out vec4 FinalColor;
+
+void main() 
+{
+	vec4 albedo;
+	float depth;
+	if (!ReadSurface(albedo, depth)) discard;
+
+	//Later forward draws (skybox, outlines, water) test against the G-buffer's depth
+	gl_FragDepth = depth;
+
+	vec3 LightOutpt = CalcDirLight(DirLight);
+
+	//Same as the forward shader, with the reflection amount from the G-buffer
+	vec4 trueColour = vec4(LightOutpt * albedo.rgb, 1.0f);
+	FinalColor = mix(trueColour, CalcReflection(), albedo.a);
+	FinalColor.a = 1.0f;
+}
@@ -0,0 +1,23 @@
+#version 460 core
+
+//Adds one point light to the pixels its volume covers, blended on top of DeferredLight.frag
+flat in int LightIndex;
+
+#include "GBuffer.glsl"
+#include "Lighting.glsl"
+
+out vec4 FinalColor;
+
+void main() 
+{
+	vec4 albedo;
+	float depth;
+	if (!ReadSurface(albedo, depth)) discard;
+
+	PointLight light = PointLights[LightIndex];
+	if (distance(FragPos, light.Position) > light.Range) discard;
+
+	//The forward shader's mix with reflection is linear, so each light can be added on its own
+	vec3 lightOutput = CalcPointLight(light, LightIndex) * albedo.rgb;
+	FinalColor = vec4(lightOutput * (1.0f - albedo.a), 1.0f);
+}
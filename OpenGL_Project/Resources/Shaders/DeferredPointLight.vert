@@ -0,0 +1,37 @@
+#version 460 core
+
+layout (location = 0) in vec3 Pos;
+
+//Must match CLightManager.h and Lighting.glsl
+struct PointLight {
+	vec3 Position;
+	float AmbientStrength;
+	vec3 Colour;
+	float SpecularStrength;
+
+	float AttenuationConstant;
+	float AttenuationLinear;
+	float AttenuationExponent;
+	float Range;
+};
+
+layout (std430, binding = 6) readonly buffer PointLightBuffer
+{
+	PointLight PointLights[];
+};
+
+uniform mat4 ProjectionView;
+
+//Scales the sphere mesh so it holds a sphere of radius 1
+uniform float VolumeScale;
+
+flat out int LightIndex;
+
+//One instance per point light, a sphere the size of its range
+void main() 
+{
+	PointLight light = PointLights[gl_InstanceID];
+
+	gl_Position = ProjectionView * vec4(light.Position + Pos * light.Range * VolumeScale, 1.0f);
+	LightIndex = gl_InstanceID;
+}
@@ -0,0 +1,64 @@
+#version 460 core
+
+//Fast approximate anti-aliasing, the cheap alternative to drawing the scene multisampled.
+//Finds edges from the contrast in luma between neighbours and blurs along them. Runs after tonemapping, as it needs display range colours
+layout (binding = 19) uniform sampler2D Source;
+
+out vec4 FinalColor;
+
+//Edges softer than this are left alone
+#define EDGE_THRESHOLD_MIN 0.0312f
+#define EDGE_THRESHOLD 0.125f
+
+#define REDUCE_MIN (1.0f / 128.0f)
+#define REDUCE_MUL (1.0f / 8.0f)
+
+//Furthest along the edge (in texels) it will blur
+#define SPAN_MAX 8.0f
+
+float Luma(vec3 _colour) {
+	return dot(clamp(_colour, 0.0f, 1.0f), vec3(0.299f, 0.587f, 0.114f));
+}
+
+vec3 Sample(vec2 _uv) {
+	return clamp(texture(Source, _uv).rgb, 0.0f, 1.0f);
+}
+
+void main()
+{
+	vec2 texel = 1.0f / vec2(textureSize(Source, 0));
+	vec2 uv = gl_FragCoord.xy * texel;
+
+	vec3 centre = Sample(uv);
+
+	float lumaM = Luma(centre);
+	float lumaNW = Luma(Sample(uv + vec2(-1.0f, -1.0f) * texel));
+	float lumaNE = Luma(Sample(uv + vec2(1.0f, -1.0f) * texel));
+	float lumaSW = Luma(Sample(uv + vec2(-1.0f, 1.0f) * texel));
+	float lumaSE = Luma(Sample(uv + vec2(1.0f, 1.0f) * texel));
+
+	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+	float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+	//Flat areas cost the five taps and nothing else
+	if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+		FinalColor = vec4(centre, 1.0f);
+		return;
+	}
+
+	//Direction along the edge
+	vec2 dir;
+	dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+	dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+	float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25f * REDUCE_MUL, REDUCE_MIN);
+	float rcpDirMin = 1.0f / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+	dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+	vec3 rgbA = 0.5f * (Sample(uv + dir * (1.0f / 3.0f - 0.5f)) + Sample(uv + dir * (2.0f / 3.0f - 0.5f)));
+	vec3 rgbB = rgbA * 0.5f + 0.25f * (Sample(uv + dir * -0.5f) + Sample(uv + dir * 0.5f));
+
+	//The wider blur crossed onto another surface, use the narrow one
+	float lumaB = Luma(rgbB);
+	FinalColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0f);
+}
@@ -0,0 +1,40 @@
+#version 460 core
+
+//Writes a shape's surface for the deferred lighting passes, targets must match CDeferredRenderer.h
+in vec2 FragTexCoords;
+in vec3 FragNormal;
+in vec3 FragPos;
+in vec2 screenPos;
+
+flat in vec4 FragRim;
+flat in float FragReflectivity;
+
+uniform sampler2D ImageTexture;
+uniform sampler2D ReflectionMap;
+uniform bool hasRefMap = true;
+
+uniform float offset;
+uniform int frameCount;
+
+//rgb = texture colour, a = how much of the skybox is reflected
+layout (location = 0) out vec4 GAlbedo;
+
+//xyz = world normal, w = rim exponent
+layout (location = 1) out vec4 GNormal;
+
+//rgb = rim colour
+layout (location = 2) out vec4 GParams;
+
+void main() 
+{
+	float frameCountCopy = frameCount;
+    if (frameCountCopy <= 0) frameCountCopy = 1;
+
+	vec4 albedo = texture(ImageTexture, vec2(FragTexCoords.x/frameCountCopy + offset, FragTexCoords.y));
+	float reflectionAmount = texture(ReflectionMap, FragTexCoords).r;
+	if (!hasRefMap) reflectionAmount = 1;
+
+	GAlbedo = vec4(albedo.rgb, FragReflectivity * reflectionAmount);
+	GNormal = vec4(normalize(FragNormal), FragRim.a);
+	GParams = vec4(FragRim.rgb, 0.0f);
+}
@@ -0,0 +1,35 @@
+//Reads the surface the G-buffer pass wrote under this pixel, included by the deferred lighting shaders.
+//Bindings must match CDeferredRenderer.h
+
+layout (binding = 12) uniform sampler2D GAlbedo;
+layout (binding = 13) uniform sampler2D GNormal;
+layout (binding = 14) uniform sampler2D GParams;
+layout (binding = 15) uniform sampler2D GDepth;
+
+uniform mat4 InverseProjectionView;
+
+//Filled by ReadSurface, named like the forward shader's inputs so the lighting functions work unchanged
+vec3 FragPos;
+vec3 FragNormal;
+vec4 FragRim;
+
+//Rebuild the world position from depth and fill the surface. Returns false for pixels nothing was drawn to
+bool ReadSurface(out vec4 _albedo, out float _depth) {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	float depth = texelFetch(GDepth, pixel, 0).r;
+	_depth = depth;
+	if (depth >= 1.0f) return false;
+
+	vec4 clip = vec4(gl_FragCoord.xy / vec2(textureSize(GDepth, 0)) * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+	vec4 world = InverseProjectionView * clip;
+	FragPos = world.xyz / world.w;
+
+	vec4 normal = texelFetch(GNormal, pixel, 0);
+	FragNormal = normal.xyz;
+	FragRim = vec4(texelFetch(GParams, pixel, 0).rgb, normal.w);
+
+	_albedo = texelFetch(GAlbedo, pixel, 0);
+
+	return true;
+}
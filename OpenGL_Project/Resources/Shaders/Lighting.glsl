@@ -0,0 +1,313 @@
+//Lighting shared by the forward (3DLight_BlinnPhong.frag) and deferred (DeferredLight.frag) programs, included by ShaderLoader.
+//Ambient light is darkened by CAmbientOcclusion's result.
+//The including shader must declare FragPos, FragNormal (world space) and FragRim before including this
+
+//Layouts must match CLightManager.h (vec3s padded with the following float), CLightClusters.h and COccluderBVH.h
+struct PointLight {
+	vec3 Position;
+	float AmbientStrength;
+	vec3 Colour;
+	float SpecularStrength;
+
+	float AttenuationConstant;
+	float AttenuationLinear;
+	float AttenuationExponent;
+	float Range;
+};
+
+struct DirectionalLight {
+	vec3 Direction;
+	float AmbientStrength;
+	vec3 Colour;
+	float SpecularStrength;
+};
+
+struct Sphere {
+	vec3 Position;
+	float rad;
+};
+
+//Left child directly follows its parent, Data.x = right child (-1 for leaves), y = first sphere, z = sphere count
+struct OccluderNode {
+	vec4 Min;
+	vec4 Max;
+	ivec4 Data;
+};
+
+//Must match CLightClusters.h
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+//Must match CPointShadows.h
+#define MAX_SHADOWED_POINT_LIGHTS 4
+#define POINT_SHADOW_FAR 100.0f
+
+//Must match CCascadedShadows.h
+#define MAX_CASCADES 4
+#define OCCLUDER_STACK_SIZE 32
+
+//Must match CAmbientOcclusion.h (1 / SCALE_DIVISOR)
+#define AO_SCALE 0.5f
+
+uniform samplerCube Skybox;
+uniform vec3 CameraPos;
+uniform float Shininess = 64.0f;
+
+layout (std140, binding = 0) uniform Lights
+{
+	DirectionalLight DirLight;
+};
+
+layout (std430, binding = 6) readonly buffer PointLightBuffer
+{
+	PointLight PointLights[];
+};
+
+//Finding a fragment's cluster: tiles per pixel, then scale and bias from log(depth) to slice.
+//Depth is dot(ViewForward.xyz, FragPos) - ViewForward.w
+layout (std140, binding = 1) uniform ClusterView
+{
+	vec4 ClusterScale;
+	vec4 ViewForward;
+};
+
+//Per cluster x = first entry in LightIndices, y = light count
+layout (std430, binding = 7) readonly buffer LightClusters
+{
+	uvec2 Clusters[CLUSTER_COUNT];
+	uint LightIndices[];
+};
+
+//Tree over every shadow casting sphere, x of OccluderInfo is the node count
+layout (std430, binding = 4) readonly buffer OccluderNodes
+{
+	ivec4 OccluderInfo;
+	OccluderNode Nodes[];
+};
+
+layout (std430, binding = 5) readonly buffer OccluderSpheres
+{
+	Sphere Spheres[];
+};
+
+//Distance to the nearest caster over POINT_SHADOW_FAR, one cube per point light, bound by CPointShadows
+layout (binding = 10) uniform samplerCubeArrayShadow PointShadows;
+
+//Directional light cascades, nearest first, bound by CCascadedShadows
+layout (std140, binding = 2) uniform Cascades
+{
+	mat4 CascadeMatrices[MAX_CASCADES];
+	vec4 CascadeTexelSizes;
+	int CascadeCount;
+};
+
+layout (binding = 11) uniform sampler2DArrayShadow CascadeShadows;
+
+//Half resolution ambient occlusion from CAmbientOcclusion, x = visibility, y = view depth (all visible when it is off)
+layout (binding = 16) uniform sampler2D AmbientOcclusion;
+
+//This fragment's ambient occlusion, worked out the first time a light asks for it
+float FragOcclusion = -1.0f;
+
+//How much light gets from _origin along _dir (normalized) without passing through a sphere, within _maxDistance.
+//Hard shadows are fully dark behind any sphere, soft ones darken less the further the sphere is
+float TraceOccluders(vec3 _origin, vec3 _dir, float _maxDistance, bool _soft) {
+	float visibility = 1.0f;
+	if (OccluderInfo.x == 0) return visibility;
+
+	vec3 invDir = 1.0f / _dir;
+
+	int stack[OCCLUDER_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		int index = stack[--top];
+		OccluderNode node = Nodes[index];
+
+		//Skip nodes the ray misses
+		vec3 t1 = (node.Min.xyz - _origin) * invDir;
+		vec3 t2 = (node.Max.xyz - _origin) * invDir;
+		vec3 tMin = min(t1, t2);
+		vec3 tMax = max(t1, t2);
+		float tNear = max(max(tMin.x, tMin.y), max(tMin.z, 0.0f));
+		float tFar = min(min(tMax.x, tMax.y), min(tMax.z, _maxDistance));
+		if (tNear > tFar) continue;
+
+		if (node.Data.x >= 0) {
+			if (top + 2 <= OCCLUDER_STACK_SIZE) {
+				stack[top++] = node.Data.x;
+				stack[top++] = index + 1;
+			}
+			continue;
+		}
+
+		for (int i = node.Data.y; i < node.Data.y + node.Data.z; i++) {
+			vec3 toSphere = Spheres[i].Position - _origin;
+
+			//Closest point of the ray to the sphere's centre must be ahead, and within the radius
+			float along = dot(toSphere, _dir);
+			if (along <= 0.0f || along > _maxDistance) continue;
+			if (length(toSphere - _dir * along) >= Spheres[i].rad) continue;
+
+			if (!_soft) return 0.0f;
+			visibility *= min(length(toSphere) / 30.0f, 1.0f);
+		}
+	}
+
+	return visibility;
+}
+
+//How lit the fragment is by a point light, from the light's cube shadow map
+float CalcPointShadow(int _index, vec3 _lightPos, vec3 _normal) {
+	vec3 fromLight = FragPos - _lightPos;
+	float depth = length(fromLight) / POINT_SHADOW_FAR;
+	if (depth >= 1.0f) return 1.0f;
+
+	//Surfaces the light grazes need more bias to not shadow themselves
+	float bias = max(0.15f * (1.0f - dot(_normal, normalize(-fromLight))), 0.03f) / POINT_SHADOW_FAR;
+
+	return texture(PointShadows, vec4(fromLight, _index), depth - bias);
+}
+
+//Shadow from the first cascade the fragment is inside, past the last cascade the spheres are traced instead
+float CalcDirShadow(vec3 _lightDir, vec3 _normal) {
+	for (int i = 0; i < CascadeCount; i++) {
+		//Push out along the normal by about a texel so surfaces don't shadow themselves
+		vec3 offsetPos = FragPos + _normal * CascadeTexelSizes[i] * 1.5f;
+
+		vec4 lightSpace = CascadeMatrices[i] * vec4(offsetPos, 1.0f);
+		vec3 coords = lightSpace.xyz / lightSpace.w * 0.5f + 0.5f;
+
+		if (any(lessThan(coords, vec3(0.0f))) || any(greaterThan(coords, vec3(1.0f)))) continue;
+
+		return texture(CascadeShadows, vec4(coords.xy, i, coords.z - 0.0005f));
+	}
+
+	return TraceOccluders(FragPos, -_lightDir, 1000.0f, true);
+}
+
+//Upsample the ambient occlusion: the four nearest half resolution texels, weighted by distance and
+//by how close their depth is to this fragment's, so occlusion from a surface behind doesn't leak onto it
+float GetAmbientOcclusion() {
+	if (FragOcclusion >= 0.0f) return FragOcclusion;
+
+	float depth = dot(ViewForward.xyz, FragPos) - ViewForward.w;
+
+	ivec2 last = textureSize(AmbientOcclusion, 0) - 1;
+	vec2 texel = gl_FragCoord.xy * AO_SCALE - 0.5f;
+	ivec2 base = ivec2(floor(texel));
+	vec2 f = fract(texel);
+
+	float total = 0.0f;
+	float weightSum = 0.0f;
+
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 s = texelFetch(AmbientOcclusion, clamp(base + offset, ivec2(0), last), 0).xy;
+
+		float bilinear = (offset.x == 1 ? f.x : 1.0f - f.x) * (offset.y == 1 ? f.y : 1.0f - f.y);
+		float weight = (bilinear + 0.001f) / (abs(depth - s.y) + 0.01f);
+
+		total += s.x * weight;
+		weightSum += weight;
+	}
+
+	FragOcclusion = total / weightSum;
+	return FragOcclusion;
+}
+
+//Caluclate the effect of a single point light on this fragment
+vec3 CalcPointLight(PointLight _pLight, int _index) {
+	
+	vec3 normal = normalize(FragNormal);
+	vec3 lightDir = normalize(FragPos - _pLight.Position);
+
+	vec3 ambient = _pLight.AmbientStrength * _pLight.Colour * GetAmbientOcclusion();
+
+	float diffuseStrength = max(dot(normal, -lightDir), 0.0f);
+	vec3 diffuse = diffuseStrength * _pLight.Colour;
+
+	vec3 reverseViewDir = normalize(CameraPos - FragPos);
+	vec3 halfWayVector = normalize(-lightDir + reverseViewDir);
+	float specularReflecitivity = pow(max(dot(normal, halfWayVector), 0.0f), Shininess);
+	vec3 specular = _pLight.SpecularStrength * specularReflecitivity * _pLight.Colour;
+
+	vec3 rim = vec3(0,0,0);
+	if (FragRim.a > 0 ){
+		float rimFactor = 1.0f - dot(normal, reverseViewDir);
+		rimFactor = smoothstep(0.0f, 1.0f, rimFactor);
+		rimFactor = pow(rimFactor, FragRim.a);
+		rim = rimFactor * FragRim.rgb;
+	}
+
+	float Distance = length(_pLight.Position - FragPos);
+	float Attenuation =  _pLight.AttenuationConstant + (_pLight.AttenuationLinear * Distance) + (_pLight.AttenuationExponent * pow(Distance, 2));
+
+	vec3 lightOutput = (diffuse + specular + rim);
+
+	if (_index < MAX_SHADOWED_POINT_LIGHTS) lightOutput *= CalcPointShadow(_index, _pLight.Position, normal);
+
+	lightOutput = (ambient + lightOutput) / Attenuation;
+
+	//Fade to nothing at the range, past it the light isn't in this cluster's list
+	float rangeFade = clamp(1.0f - pow(Distance / _pLight.Range, 4.0f), 0.0f, 1.0f);
+	lightOutput *= rangeFade * rangeFade;
+
+	if (Attenuation < 1f) {
+		lightOutput = vec3(0,0,0);
+	}
+
+	return lightOutput;
+}
+
+//Index of the cluster this fragment is in
+uint GetCluster() {
+	float depth = dot(ViewForward.xyz, FragPos) - ViewForward.w;
+
+	uvec3 cluster;
+	cluster.xy = uvec2(clamp(gl_FragCoord.xy * ClusterScale.xy, vec2(0.0f), vec2(CLUSTER_X - 1, CLUSTER_Y - 1)));
+	cluster.z = uint(clamp(floor(log(max(depth, 0.0001f)) * ClusterScale.z + ClusterScale.w), 0.0f, float(CLUSTER_Z - 1)));
+
+	return (cluster.z * CLUSTER_Y + cluster.y) * CLUSTER_X + cluster.x;
+}
+
+//Caluclate the effect of the directional light on this fragment
+vec3 CalcDirLight(DirectionalLight _dLight) {
+	
+	vec3 normal = normalize(FragNormal);
+	vec3 lightDir = normalize(_dLight.Direction);
+
+	vec3 ambient = _dLight.AmbientStrength * _dLight.Colour * GetAmbientOcclusion();
+
+	float diffuseStrength = max(dot(normal, -lightDir), 0.0f);
+	vec3 diffuse = diffuseStrength * _dLight.Colour;
+
+	vec3 reverseViewDir = normalize(CameraPos - FragPos);
+	vec3 halfWayVector = normalize(-lightDir + reverseViewDir);
+	float specularReflecitivity = pow(max(dot(normal, halfWayVector), 0.0f), Shininess);
+	vec3 specular = _dLight.SpecularStrength * specularReflecitivity * _dLight.Colour;
+
+	vec3 lightOutput = (diffuse + specular);
+
+	lightOutput *= CalcDirShadow(lightDir, normal);
+
+	lightOutput = (ambient + lightOutput);
+
+	return lightOutput;
+}
+
+//Calculate skybox reflection
+vec4 CalcReflection() {
+	
+	vec3 normal = normalize(FragNormal);
+	vec3 viewDir = normalize(FragPos - CameraPos);
+	vec3 reflectDir = reflect(viewDir, normal);
+
+	vec4 reflectColour = texture(Skybox, reflectDir);
+
+	return reflectColour;
+}
+
@@ -0,0 +1,19 @@
+//Per object data written by CTransformRing, included by every shape vertex shader.
+//Layout must match ObjectData in CTransformRing.h (std430), read with Objects[gl_BaseInstance + gl_InstanceID]
+struct ObjectData
+{
+	mat4 Model;
+	mat4 PVM;
+	mat4 Normal;
+
+	//rgb = rim colour, a = rim exponent
+	vec4 Rim;
+
+	//x = reflectivity
+	vec4 Params;
+};
+
+layout (std430, binding = 0) readonly buffer ObjectTransforms
+{
+	ObjectData Objects[];
+};
@@ -2,9 +2,12 @@
 
 layout (location = 0) in vec3 Pos;
 
-uniform mat4 PVMMat;
+//Depth must match exactly between the depth prepass (PositionOnly.vert) and the lit draws
+invariant gl_Position;
+
+#include "ObjectData.glsl"
 
 void main() 
 {
-	gl_Position = PVMMat * vec4(Pos, 1.0);
+	gl_Position = Objects[gl_BaseInstance + gl_InstanceID].PVM * vec4(Pos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 460 core
+
+//Distance fog over the whole scene, first of CPostProcess's passes. Finds each pixel's world position from the scene's depth
+layout (binding = 19) uniform sampler2D Source;
+layout (binding = 20) uniform sampler2D SceneDepth;
+
+uniform mat4 InverseProjectionView;
+uniform vec3 CameraPos;
+
+out vec4 FinalColor;
+
+//Same grey as the clear colour, so far shapes fade into the background
+#define FOG_COLOUR vec3(0.5f, 0.5f, 0.5f)
+
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+	vec3 colour = texelFetch(Source, coord, 0).rgb;
+	float depth = texelFetch(SceneDepth, coord, 0).r;
+
+	//Skybox (and nothing) sits on the far plane, leave it clear
+	if (depth >= 1.0f) {
+		FinalColor = vec4(colour, 1.0f);
+		return;
+	}
+
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(SceneDepth, 0));
+	vec4 world = InverseProjectionView * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+	world /= world.w;
+
+	//0 up close to 1 far away
+	float d = distance(world.xyz, CameraPos);
+	float fog = clamp((d - 5.0f) / 20.0f, 0.0f, 1.0f);
+
+	FinalColor = vec4(mix(colour, FOG_COLOUR, fog), 1.0f);
+}
@@ -0,0 +1,80 @@
+#version 460 core
+
+//Ambient occlusion at half resolution from the opaque shapes' depth, drawn by CAmbientOcclusion before the lit shapes.
+//Samples a hemisphere around each texel's surface and counts how many are behind the depth buffer
+layout (binding = 17) uniform sampler2D SceneDepth;
+
+uniform mat4 Projection;
+uniform mat4 InverseProjection;
+
+uniform int SampleCount = 16;
+
+//How far out (world units) the samples reach, occluders further than this are ignored
+uniform float Radius = 0.75f;
+
+//x = visibility (1 = unoccluded), y = view depth for the blur and upsample
+layout (location = 0) out vec2 Occlusion;
+
+//Depth given to texels with nothing drawn, far enough that nothing blends with them
+#define EMPTY_DEPTH 1000.0f
+
+#define GOLDEN_ANGLE 2.39996323f
+
+vec3 ViewPos(vec2 _uv) {
+	float depth = texture(SceneDepth, _uv).r;
+	vec4 view = InverseProjection * vec4(vec3(_uv, depth) * 2.0f - 1.0f, 1.0f);
+	return view.xyz / view.w;
+}
+
+void main()
+{
+	vec2 size = vec2(textureSize(SceneDepth, 0));
+	vec2 uv = gl_FragCoord.xy / size;
+
+	if (texture(SceneDepth, uv).r >= 1.0f) {
+		Occlusion = vec2(1.0f, EMPTY_DEPTH);
+		return;
+	}
+
+	vec3 position = ViewPos(uv);
+
+	//Normal from the closer neighbour on each axis, so it doesn't bend over edges
+	vec2 texel = 1.0f / size;
+	vec3 left = ViewPos(uv - vec2(texel.x, 0.0f));
+	vec3 right = ViewPos(uv + vec2(texel.x, 0.0f));
+	vec3 down = ViewPos(uv - vec2(0.0f, texel.y));
+	vec3 up = ViewPos(uv + vec2(0.0f, texel.y));
+
+	vec3 dx = (abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left);
+	vec3 dy = (abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down);
+	vec3 normal = normalize(cross(dx, dy));
+
+	vec3 tangent = normalize(cross(abs(normal.y) < 0.99f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f), normal));
+	mat3 tangentToView = mat3(tangent, cross(normal, tangent), normal);
+
+	//Each texel turns the sample spiral by a different amount, the blur smooths out the pattern
+	float rotation = 6.2831853f * fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+
+	float occlusion = 0.0f;
+	for (int i = 0; i < SampleCount; i++) {
+		//Spread over the hemisphere, more of them close to the surface
+		float t = (float(i) + 0.5f) / float(SampleCount);
+		float angle = float(i) * GOLDEN_ANGLE + rotation;
+		float height = 1.0f - t;
+		float ring = sqrt(1.0f - height * height);
+
+		vec3 direction = tangentToView * vec3(cos(angle) * ring, sin(angle) * ring, height);
+		vec3 samplePos = position + direction * Radius * mix(0.1f, 1.0f, t * t);
+
+		vec4 projected = Projection * vec4(samplePos, 1.0f);
+		vec2 sampleUV = projected.xy / projected.w * 0.5f + 0.5f;
+
+		float sceneZ = ViewPos(sampleUV).z;
+
+		//Surfaces much closer to the camera than this one don't darken it
+		float rangeCheck = smoothstep(0.0f, 1.0f, Radius / abs(position.z - sceneZ));
+		occlusion += (sceneZ >= samplePos.z + 0.025f ? 1.0f : 0.0f) * rangeCheck;
+	}
+
+	Occlusion = vec2(1.0f - occlusion / float(SampleCount), -position.z);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 460 core
+
+//One direction of CAmbientOcclusion's blur. Texels are weighted by how close their depth is to the centre's,
+//so occlusion doesn't bleed from one surface onto another behind it
+layout (binding = 18) uniform sampler2D Source;
+
+//(1, 0) across or (0, 1) down
+uniform ivec2 Direction;
+uniform int BlurRadius = 4;
+
+//x = visibility, y = view depth (passed through)
+layout (location = 0) out vec2 Occlusion;
+
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+	ivec2 last = textureSize(Source, 0) - 1;
+
+	vec2 centre = texelFetch(Source, coord, 0).xy;
+
+	float total = centre.x;
+	float weightSum = 1.0f;
+
+	for (int i = -BlurRadius; i <= BlurRadius; i++) {
+		if (i == 0) continue;
+
+		vec2 s = texelFetch(Source, clamp(coord + Direction * i, ivec2(0), last), 0).xy;
+
+		float gaussian = exp(-float(i * i) / float(BlurRadius * BlurRadius));
+		float depthWeight = max(1.0f - abs(s.y - centre.y) / (centre.y * 0.05f + 0.01f), 0.0f);
+
+		total += s.x * gaussian * depthWeight;
+		weightSum += gaussian * depthWeight;
+	}
+
+	Occlusion = vec2(total / weightSum, centre.y);
+}
\ No newline at end of file
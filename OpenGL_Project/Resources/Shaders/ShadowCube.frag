@@ -0,0 +1,14 @@
+#version 460 core
+
+//Must match CPointShadows.h
+#define POINT_SHADOW_FAR 100.0f
+
+in vec3 FragPos;
+
+uniform vec3 LightPos;
+
+void main() 
+{
+	//Linear distance from the light, so every face of the cube compares the same way
+	gl_FragDepth = length(FragPos - LightPos) / POINT_SHADOW_FAR;
+}
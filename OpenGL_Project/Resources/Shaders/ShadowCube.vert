@@ -0,0 +1,16 @@
+#version 460 core
+
+layout (location = 0) in vec3 Pos;
+
+#include "ObjectData.glsl"
+
+out vec3 FragPos;
+
+void main() 
+{
+	ObjectData object = Objects[gl_BaseInstance + gl_InstanceID];
+
+	//PVM holds the cube face's projection and view
+	gl_Position = object.PVM * vec4(Pos, 1.0);
+	FragPos = vec3(object.Model * vec4(Pos, 1.0f));
+}
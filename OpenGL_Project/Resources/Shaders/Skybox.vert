@@ -2,12 +2,13 @@
 
 layout (location = 0) in vec3 Pos;
 
-uniform mat4 PVMMat;
+#include "ObjectData.glsl"
 
 out vec3 FragTexCoords;
 
 void main() 
 {
-	gl_Position = PVMMat * vec4(Pos, 1.0f);
+	//Pushed to the far plane (depth 1), drawn last with GL_LEQUAL so only pixels nothing else covered are shaded
+	gl_Position = (Objects[gl_BaseInstance + gl_InstanceID].PVM * vec4(Pos, 1.0f)).xyww;
 	FragTexCoords = Pos;
 }
\ No newline at end of file
@@ -1,14 +1,40 @@
 #version 460 core
 
+struct Label
+{
+	vec4 Origin;
+	vec4 Colour;
+	vec4 Clip;
+	vec4 Bounce;
+};
+
+layout (std430, binding = 3) readonly buffer TextLabels
+{
+	Label Labels[];
+};
+
 in vec2 FragTexCoords;
+in float FragX;
+flat in uint FragLabel;
 
 uniform sampler2D TextTexture;
-uniform vec3 TextColor;
 
 out vec4 FinalColor;
 
 void main()
 {
-	float Alpha = texture(TextTexture, FragTexCoords).r;
-	FinalColor = vec4(TextColor, Alpha);
-}
\ No newline at end of file
+	Label label = Labels[FragLabel];
+
+	float Value = texture(TextTexture, FragTexCoords).r;
+
+	//SDF atlases hold distance to the outline (0.5 is the edge), soften over about one screen pixel
+	float Width = fwidth(Value);
+	float Alpha = (label.Colour.a != 0.0f ? smoothstep(0.5f - Width, 0.5f + Width, Value) : Value);
+
+	//Scrolling text is hidden near the ends of its range
+	if (label.Clip.z != 0.0f && (FragX < label.Clip.x + label.Clip.w || FragX > label.Clip.y - label.Clip.w)) {
+		Alpha = 0.0f;
+	}
+
+	FinalColor = vec4(label.Colour.rgb, Alpha);
+}
@@ -1,13 +1,61 @@
 #version 460 core
 
-layout (location = 0) in vec4 Vertex;
+struct Glyph
+{
+	vec4 Rect;
+	vec4 UV;
+	uvec4 Label;
+};
+
+struct Label
+{
+	vec4 Origin;
+	vec4 Colour;
+	vec4 Clip;
+	vec4 Bounce;
+};
+
+layout (std430, binding = 2) readonly buffer TextGlyphs
+{
+	Glyph Glyphs[];
+};
+
+layout (std430, binding = 3) readonly buffer TextLabels
+{
+	Label Labels[];
+};
 
 uniform mat4 ProjectionMat;
+uniform float CurrentTime;
 
 out vec2 FragTexCoords;
+out float FragX;
+flat out uint FragLabel;
 
 void main()
 {
-	gl_Position = ProjectionMat * vec4(Vertex.xy, 0.0f, 1.0f);
-	FragTexCoords = vec2(Vertex.z, Vertex.w);
-}
\ No newline at end of file
+	Glyph glyph = Glyphs[gl_BaseInstance + gl_InstanceID];
+	Label label = Labels[glyph.Label.x];
+
+	//Corner of the quad from the vertex number (triangle strip)
+	vec2 Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	vec2 Position = label.Origin.xy + glyph.Rect.xy;
+	vec2 Vertex = Position + Corner * glyph.Rect.zw;
+
+	//Bounce between 1x and 2x size around the label's centre
+	if (label.Bounce.z != 0.0f) {
+		float Scale = ((sin(CurrentTime - 1.57079633f) + 1.0f) / 2.0f) + 1.0f;
+		Vertex = label.Bounce.xy + (Vertex - label.Bounce.xy) * Scale;
+	}
+
+	//Scroll each glyph along, wrapping around the clip range
+	if (label.Clip.z != 0.0f) {
+		float Offset = mod(Position.x + CurrentTime * label.Clip.z, label.Clip.y - label.Clip.x) + label.Clip.x - Position.x;
+		Vertex.x += Offset;
+	}
+
+	gl_Position = ProjectionMat * vec4(Vertex, 0.0f, 1.0f);
+	FragTexCoords = vec2(mix(glyph.UV.x, glyph.UV.z, Corner.x), mix(glyph.UV.w, glyph.UV.y, Corner.y));
+	FragX = Vertex.x;
+	FragLabel = glyph.Label.x;
+}
@@ -0,0 +1,20 @@
+#version 460 core
+
+//Brings the HDR scene into display range, so bright highlights roll off instead of clipping
+layout (binding = 19) uniform sampler2D Source;
+
+uniform float Exposure = 1.0f;
+
+out vec4 FinalColor;
+
+//Fitted ACES filmic curve (Narkowicz)
+vec3 ACES(vec3 _colour) {
+	return clamp((_colour * (2.51f * _colour + 0.03f)) / (_colour * (2.43f * _colour + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+void main()
+{
+	vec3 colour = texelFetch(Source, ivec2(gl_FragCoord.xy), 0).rgb * Exposure;
+
+	FinalColor = vec4(ACES(colour), 1.0f);
+}
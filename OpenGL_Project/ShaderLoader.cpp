@@ -1,10 +1,13 @@
 #include "ShaderLoader.h" 
 
+#include <algorithm>
+
 ShaderLoader::ShaderLoader(void){}
 ShaderLoader::~ShaderLoader(void){}
 
 std::vector<CShader*> Globals::shaders;
 std::map<std::string, CProgram*> Globals::programs;
+std::unordered_map<GLuint, CProgram*> Globals::programIDs;
 
 /// <summary>
 /// Create program with a Vertex Shader, and a Fragment Shader
@@ -97,10 +100,15 @@ GLuint ShaderLoader::CreateProgram(std::string _name, const char* vertexShaderFi
 		return 0;
 	}
 
-	Globals::programs[_name] = (new CProgram(program, std::vector<CShader*>{vShader, fShader}));
+	CProgram* newProgram = new CProgram(program, std::vector<CShader*>{vShader, fShader});
+	newProgram->m_name = _name;
+	Globals::programs[_name] = newProgram;
+	Globals::programIDs[program] = newProgram;
+
+	ReflectProgram(newProgram);
 
 	SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 10);
-	std::cout << "--Program Created" << std::endl;
+	std::cout << "--Program Created (" << newProgram->m_uniforms.size() << " uniforms, " << newProgram->m_blocks.size() << " blocks)" << std::endl;
 	SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 15);
 	std::cout << "End Program Creation." << std::endl << std::endl;
 	return program;
@@ -111,7 +119,7 @@ GLuint ShaderLoader::CreateProgram(std::string _name, const char* vertexShaderFi
 /// </summary>
 /// <param name="_name"></param>
 /// <returns></returns>
-CProgram* ShaderLoader::GetProgram(std::string _name)
+CProgram* ShaderLoader::GetProgram(const std::string& _name)
 {
 	std::map<std::string, CProgram*>::iterator it = Globals::programs.find(_name);
 	if (it != Globals::programs.end()) {
@@ -123,6 +131,138 @@ CProgram* ShaderLoader::GetProgram(std::string _name)
 	}
 }
 
+/// <summary>
+/// Returns program with given OpenGL id
+/// </summary>
+/// <param name="_id"></param>
+/// <returns> nullptr if it was not made by the ShaderLoader</returns>
+CProgram* ShaderLoader::GetProgram(GLuint _id)
+{
+	std::unordered_map<GLuint, CProgram*>::iterator it = Globals::programIDs.find(_id);
+	if (it != Globals::programIDs.end()) {
+		return it->second;
+	}
+	return nullptr;
+}
+
+/// <summary>
+/// Looks up a uniform location in a program's table, without asking the driver
+/// </summary>
+/// <param name="_program"></param>
+/// <param name="_name"></param>
+/// <param name="_warn"> print a warning (once) if the program does not have it</param>
+/// <returns> -1 if not found</returns>
+GLint ShaderLoader::GetUniformLocation(GLuint _program, const std::string& _name, bool _warn)
+{
+	CProgram* program = GetProgram(_program);
+	if (program == nullptr) return -1;
+
+	return program->GetUniformLocation(_name, _warn);
+}
+
+/// <summary>
+/// Enumerate the active uniforms and blocks of a linked program into its tables
+/// </summary>
+/// <param name="_program"></param>
+void ShaderLoader::ReflectProgram(CProgram* _program)
+{
+	GLuint id = _program->m_id;
+
+	GLint maxNameLength = 0;
+	glGetProgramInterfaceiv(id, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+	GLint blockNameLength = 0;
+	glGetProgramInterfaceiv(id, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &blockNameLength);
+	if (blockNameLength > maxNameLength) maxNameLength = blockNameLength;
+	glGetProgramInterfaceiv(id, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &blockNameLength);
+	if (blockNameLength > maxNameLength) maxNameLength = blockNameLength;
+
+	std::vector<char> name(maxNameLength + 1);
+
+	//Plain uniforms
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv(id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+
+	const GLenum properties[4] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+	GLint nextUnit = 0;
+	for (GLint i = 0; i < uniformCount; i++) {
+		GLint values[4] = { 0 };
+		glGetProgramResourceiv(id, GL_UNIFORM, i, 4, properties, 4, NULL, values);
+
+		//Members of uniform blocks are set through the block's buffer
+		if (values[0] != -1) continue;
+
+		glGetProgramResourceName(id, GL_UNIFORM, i, (GLsizei)name.size(), NULL, name.data());
+
+		UniformInfo info;
+		info.location = values[1];
+		info.type = (GLenum)values[2];
+		info.arraySize = values[3];
+
+		std::string uniformName(name.data());
+
+		//Samplers with a layout binding already have their unit, the rest are given the next free one below the fixed units
+		if (IsSampler(info.type)) {
+			glGetUniformiv(id, info.location, &info.unit);
+
+			if (info.unit == 0) {
+				if (nextUnit >= CProgram::FIXED_UNIT_START) {
+					std::cout << "ERROR: Program " << _program->m_name << " has too many samplers, " << uniformName << " shares unit " << nextUnit - 1 << "." << std::endl;
+					nextUnit = CProgram::FIXED_UNIT_START - 1;
+				}
+
+				info.unit = nextUnit++;
+				glProgramUniform1i(id, info.location, info.unit);
+			}
+		}
+
+		_program->m_uniforms[uniformName] = info;
+
+		//Arrays are reported as "Name[0]", also allow just "Name"
+		size_t bracket = uniformName.rfind("[0]");
+		if (bracket != std::string::npos && bracket + 3 == uniformName.size()) {
+			_program->m_uniforms[uniformName.substr(0, bracket)] = info;
+		}
+	}
+
+	//Uniform and storage blocks, by their binding point
+	const GLenum blockProperty = GL_BUFFER_BINDING;
+	for (GLenum blockInterface : { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK }) {
+		GLint blockCount = 0;
+		glGetProgramInterfaceiv(id, blockInterface, GL_ACTIVE_RESOURCES, &blockCount);
+
+		for (GLint i = 0; i < blockCount; i++) {
+			GLint binding = 0;
+			glGetProgramResourceiv(id, blockInterface, i, 1, &blockProperty, 1, NULL, &binding);
+			glGetProgramResourceName(id, blockInterface, i, (GLsizei)name.size(), NULL, name.data());
+
+			_program->m_blocks[std::string(name.data())] = binding;
+		}
+	}
+}
+
+/// <summary>
+/// Is a reflected uniform type one of the sampler types the shaders use
+/// </summary>
+/// <param name="_type"></param>
+/// <returns></returns>
+bool ShaderLoader::IsSampler(GLenum _type)
+{
+	switch (_type)
+	{
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /// <summary>
 /// Create shader from file
 /// </summary>
@@ -185,11 +325,78 @@ GLuint ShaderLoader::CreateShader(GLenum shaderType, const char* shaderName, CSh
 }
 
 /// <summary>
-/// Read Shader file...
+/// Read Shader file, with any #include "file" lines replaced by that file (relative to the including file)
 /// </summary>
 /// <param name="filename"></param>
 /// <returns></returns>
 std::string ShaderLoader::ReadShaderFile(const char *filename)
+{
+	std::string shaderCode = ReadSourceFile(filename);
+	if (shaderCode.find("#include") == std::string::npos) return shaderCode;
+
+	std::string path(filename);
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = (slash == std::string::npos ? "" : path.substr(0, slash + 1));
+
+	std::vector<std::string> included;
+	return ExpandIncludes(shaderCode, directory, included);
+}
+
+/// <summary>
+/// Replace #include "file" lines with the file's source, each file is only included once
+/// </summary>
+/// <param name="_source"></param>
+/// <param name="_directory"> folder of the file the source came from, ending in a slash</param>
+/// <param name="_included"> files already included</param>
+/// <returns></returns>
+std::string ShaderLoader::ExpandIncludes(const std::string& _source, const std::string& _directory, std::vector<std::string>& _included)
+{
+	static const std::string directive = "#include \"";
+
+	std::string result;
+	size_t start = 0;
+
+	while (start < _source.size()) {
+		size_t end = _source.find('\n', start);
+		if (end == std::string::npos) end = _source.size();
+
+		std::string line = _source.substr(start, end - start);
+		size_t first = line.find_first_not_of(" \t");
+
+		if (first != std::string::npos && line.compare(first, directive.size(), directive) == 0) {
+			size_t nameEnd = line.find('"', first + directive.size());
+			std::string name = line.substr(first + directive.size(), nameEnd - first - directive.size());
+			std::string file = _directory + name;
+
+			if (nameEnd == std::string::npos) {
+				SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 12);
+				std::cout << "ERROR: Badly formed include: " << line << std::endl;
+			}
+			else if (std::find(_included.begin(), _included.end(), file) == _included.end()) {
+				_included.push_back(file);
+
+				size_t slash = file.find_last_of("/\\");
+				std::string directory = (slash == std::string::npos ? "" : file.substr(0, slash + 1));
+				result += ExpandIncludes(ReadSourceFile(file.c_str()), directory, _included);
+			}
+		}
+		else {
+			result += line;
+		}
+
+		result += '\n';
+		start = end + 1;
+	}
+
+	return result;
+}
+
+/// <summary>
+/// Read a whole file into a string
+/// </summary>
+/// <param name="filename"></param>
+/// <returns> empty if the file can't be read</returns>
+std::string ShaderLoader::ReadSourceFile(const char *filename)
 {
 	// Open the file for reading
 	std::ifstream file(filename, std::ios::in);
@@ -251,3 +458,39 @@ CProgram::CProgram(GLuint _id, std::vector<CShader*> _shaders)
 CProgram::~CProgram()
 {
 }
+
+/// <summary>
+/// Location of an active uniform, from the table built when linking
+/// </summary>
+/// <param name="_name"></param>
+/// <param name="_warn"> print a warning (once per name) if the program does not have it</param>
+/// <returns> -1 if not found, which glUniform calls ignore</returns>
+GLint CProgram::GetUniformLocation(const std::string& _name, bool _warn)
+{
+	std::unordered_map<std::string, UniformInfo>::iterator it = m_uniforms.find(_name);
+	if (it != m_uniforms.end()) {
+		return it->second.location;
+	}
+
+	if (_warn && m_missing.insert(_name).second) {
+		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 14);
+		std::cout << "WARNING: Program " << m_name << " has no active uniform named " << _name << "." << std::endl;
+		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 15);
+	}
+
+	return -1;
+}
+
+/// <summary>
+/// Type and size of an active uniform
+/// </summary>
+/// <param name="_name"></param>
+/// <returns> nullptr if not found</returns>
+const UniformInfo* CProgram::GetUniformInfo(const std::string& _name)
+{
+	std::unordered_map<std::string, UniformInfo>::iterator it = m_uniforms.find(_name);
+	if (it != m_uniforms.end()) {
+		return &it->second;
+	}
+	return nullptr;
+}
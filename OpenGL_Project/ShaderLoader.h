@@ -21,6 +21,9 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 
 /// <summary>
 /// Shader class to store info about shader
@@ -35,23 +38,53 @@ public:
 	~CShader();
 };
 
+/// <summary>
+/// Info about an active uniform, found when the program is linked
+/// </summary>
+struct UniformInfo {
+	GLint location = -1;
+	GLenum type = 0;
+	GLint arraySize = 1;
+
+	//Texture unit a sampler reads from, -1 for everything else
+	GLint unit = -1;
+};
+
 /// <summary>
 /// Program class to store info about Programs
 /// </summary>
 class CProgram {
 public:
+	//Samplers without a layout binding get consecutive units from 0, units from here up are reserved for fixed bindings (shadows, G-buffer...)
+	static const GLint FIXED_UNIT_START = 10;
+
 	GLuint m_id;
+	std::string m_name;
 
 	//list of shaders in program
 	std::vector<CShader*> m_shaders;
 
+	//Active uniforms (outside of blocks) and uniform/storage blocks by name, filled at link time
+	std::unordered_map<std::string, UniformInfo> m_uniforms;
+	std::unordered_map<std::string, GLint> m_blocks;
+
+	//Missing names already warned about, so each is only reported once
+	std::unordered_set<std::string> m_missing;
+
+	//Id of the uniform block whose values the program last received (0 for none)
+	uint64_t m_lastBlock = 0;
+
 	CProgram(GLuint _id, std::vector<CShader*> _shaders);
 	~CProgram();
+
+	GLint GetUniformLocation(const std::string& _name, bool _warn = true);
+	const UniformInfo* GetUniformInfo(const std::string& _name);
 };
 
 struct Globals {
 	static std::vector<CShader* > shaders;
 	static std::map<std::string, CProgram*> programs;
+	static std::unordered_map<GLuint, CProgram*> programIDs;
 };
 
 class ShaderLoader
@@ -59,12 +92,18 @@ class ShaderLoader
 	
 public:	
 	static GLuint CreateProgram(std::string _name, const char* VertexShaderFilename, const char* FragmentShaderFilename);
-	static CProgram* GetProgram(std::string _name);
+	static CProgram* GetProgram(const std::string& _name);
+	static CProgram* GetProgram(GLuint _id);
+	static GLint GetUniformLocation(GLuint _program, const std::string& _name, bool _warn = true);
 
 private:
 	ShaderLoader(void);
 	~ShaderLoader(void);
 	static GLuint CreateShader(GLenum shaderType, const char* shaderName, CShader ** _shaderReturn);
 	static std::string ReadShaderFile(const char *filename);
+	static std::string ReadSourceFile(const char *filename);
+	static std::string ExpandIncludes(const std::string& _source, const std::string& _directory, std::vector<std::string>& _included);
 	static void PrintErrorDetails(bool isShader, GLuint id, const char* name);
+	static void ReflectProgram(CProgram* _program);
+	static bool IsSampler(GLenum _type);
 };
@@ -26,6 +26,8 @@
 #include <Windows.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <cstdlib>
+#include <new>
 
 #include <map>
 #include <string>
@@ -41,6 +43,21 @@
 #include "Utility.h"
 #include "CObjectManager.h"
 #include "CLightManager.h"
+#include "CRenderQueue.h"
+#include "CGeometryArena.h"
+#include "CTransformRing.h"
+#include "CGLState.h"
+#include "CFontManager.h"
+#include "CTextBatcher.h"
+#include "CFrustumCuller.h"
+#include "CSceneBVH.h"
+#include "CPointShadows.h"
+#include "CCascadedShadows.h"
+#include "CLightClusters.h"
+#include "CDeferredRenderer.h"
+#include "CLightmapBaker.h"
+#include "CAmbientOcclusion.h"
+#include "CPostProcess.h"
 
 #pragma region Function Headers
 void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -65,6 +82,8 @@ void GenCubemap(GLuint& texture, std::string texPath[6]);
 
 void Update();
 void CheckInput(float _deltaTime, float _currentTime);
+void PickShape();
+void ApplyRenderPath();
 void Render();
 
 void Print(int x, int y, std::string str, int effect);
@@ -77,6 +96,28 @@ glm::vec2 utils::mousePos = glm::vec2();
 float utils::currentTime = 0.0f;
 float utils::deltaTime = 0.0f;
 float utils::previousTimeStep = 0.0f;
+std::atomic<size_t> utils::allocationCount(0);
+
+/// <summary>
+/// Counts every allocation, so frames can be checked for heap use
+/// </summary>
+/// <param name="_size"></param>
+/// <returns></returns>
+void* operator new(size_t _size)
+{
+	utils::allocationCount++;
+
+	if (void* ptr = std::malloc(_size)) return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* _ptr) noexcept
+{
+	std::free(_ptr);
+}
+
+//Allocations made while updating and drawing the scene this frame (text output not included)
+size_t g_sceneAllocations = 0;
 
 //Program render window
 GLFWwindow* g_window = nullptr;
@@ -89,6 +130,12 @@ bool doInput = false;
 
 bool cursorLocked = false;
 
+//Static shapes read their lighting from baked lightmaps (L toggles)
+bool g_useLightmaps = true;
+
+//Left click waiting to be picked on the next update (not done in the callback)
+bool g_pickRequested = false;
+
 //Textures
 GLuint Texture_Rayman;
 GLuint Texture_Awesome;
@@ -125,6 +172,9 @@ int main() {
 		Render();
 	}
 
+	//Free fonts while the context still exists
+	CFontManager::Shutdown();
+
 	//Close GLFW correctly
 	glfwTerminate();
 	return 0;
@@ -137,7 +187,9 @@ bool Startup()
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	glfwWindowHint(GLFW_SAMPLES, 4);
+
+	//Anti-aliasing happens offscreen (CPostProcess), the window itself is single sampled
+	glfwWindowHint(GLFW_SAMPLES, 0);
 
 	//Setting console cursor visibilty
 	HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -189,23 +241,29 @@ void InitialSetup()
 	glfwSetMouseButtonCallback(g_window, MouseCallback);
 
 	//Fill polygons
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	CGLState::PolygonMode(GL_FILL);
 
 	//Multi sampling
-	glEnable(GL_MULTISAMPLE);
+	CGLState::Enable(GL_MULTISAMPLE);
+
+	//Keep rasterized glyphs between runs
+	CFontManager::SetDiskCache("Resources/Fonts/Cache");
+
+	//Keep baked lightmaps between runs, they are only baked again when the scene or lights change
+	CLightmapBaker::SetDiskCache("Resources/Lightmaps");
 
 	//Cull polygons not facing
-	glCullFace(GL_BACK);
+	CGLState::CullFace(GL_BACK);
 
 	//Set winding order of verticies (for front and back facing)
 	glFrontFace(GL_CCW);
 
 	//Enable Culling
-	glEnable(GL_CULL_FACE);
-	//glDisable(GL_CULL_FACE);
+	CGLState::Enable(GL_CULL_FACE);
+	//CGLState::Disable(GL_CULL_FACE);
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
+	CGLState::Enable(GL_DEPTH_TEST);
+	CGLState::DepthFunc(GL_LESS);
 
 	//Create textures
 	TextureCreation();
@@ -221,6 +279,7 @@ void InitialSetup()
 
 	//Set up shapes
 	InitShapes();
+	ApplyRenderPath();
 
 	system("CLS");
 }
@@ -515,6 +574,7 @@ void ObjectCreation()
 
 	CObjectManager::AddShape("floor", new CShape("floor-squareNorm", glm::vec3(0.0f, -0.5f, 0.0f), 0.0f, glm::vec3(100.0f, 1.0f, 100.0f), false));
 	CObjectManager::GetShape("floor")->SetCamera(g_camera);
+	CObjectManager::GetShape("floor")->SetStatic(true);
 
 	CObjectManager::AddShape("sphere1", new CShape("sphere", glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), false));
 	CObjectManager::GetShape("sphere1")->SetCamera(g_camera);
@@ -524,9 +584,11 @@ void ObjectCreation()
 
 	CObjectManager::AddShape("water1", new CShape("squareNorm", glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(10.0f, 1.0f, 10.0f), false));
 	CObjectManager::GetShape("water1")->SetCamera(g_camera);
+	CObjectManager::GetShape("water1")->SetRenderPass(RenderPass::Transparent);
 
 	CObjectManager::AddShape("skybox", new CShape("skybox", glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, glm::vec3(2000.0f, 2000.0f, 2000.0f), false));
 	CObjectManager::GetShape("skybox")->SetCamera(g_camera);
+	CObjectManager::GetShape("skybox")->SetRenderPass(RenderPass::Background);
 }
 
 #pragma endregion
@@ -543,10 +605,31 @@ void ProgramSetup()
 	ShaderLoader::CreateProgram("clipSpaceFade", "Resources/Shaders/ClipSpace.vert", "Resources/Shaders/VertexColorFade.frag" );
 	ShaderLoader::CreateProgram("clipSpaceFractal", "Resources/Shaders/WorldSpace.vert", "Resources/Shaders/Fractal.frag" );
 	ShaderLoader::CreateProgram("text", "Resources/Shaders/Text.vert", "Resources/Shaders/Text.frag" );
-	ShaderLoader::CreateProgram("textScroll", "Resources/Shaders/TextScroll.vert", "Resources/Shaders/TextScroll.frag" );
 	ShaderLoader::CreateProgram("3DLight", "Resources/Shaders/3D_Normals.vert", "Resources/Shaders/3DLight_BlinnPhong.frag" );
 	ShaderLoader::CreateProgram("skybox", "Resources/Shaders/Skybox.vert", "Resources/Shaders/Skybox.frag" );
 	ShaderLoader::CreateProgram("solidColour", "Resources/Shaders/PositionOnly.vert", "Resources/Shaders/ColourOnly.frag");
+	ShaderLoader::CreateProgram("3DLightInstanced", "Resources/Shaders/3D_Normals_Instanced.vert", "Resources/Shaders/3DLight_BlinnPhong.frag");
+	ShaderLoader::CreateProgram("shadowCube", "Resources/Shaders/ShadowCube.vert", "Resources/Shaders/ShadowCube.frag");
+	ShaderLoader::CreateProgram("depthOnly", "Resources/Shaders/PositionOnly.vert", "Resources/Shaders/DepthOnly.frag");
+	ShaderLoader::CreateProgram("gBuffer", "Resources/Shaders/3D_Normals.vert", "Resources/Shaders/GBuffer.frag");
+	ShaderLoader::CreateProgram("gBufferInstanced", "Resources/Shaders/3D_Normals_Instanced.vert", "Resources/Shaders/GBuffer.frag");
+	ShaderLoader::CreateProgram("deferredLight", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/DeferredLight.frag");
+	ShaderLoader::CreateProgram("deferredPointLight", "Resources/Shaders/DeferredPointLight.vert", "Resources/Shaders/DeferredPointLight.frag");
+	ShaderLoader::CreateProgram("3DLightBaked", "Resources/Shaders/3D_Normals.vert", "Resources/Shaders/3DLight_Baked.frag");
+	ShaderLoader::CreateProgram("ssao", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/SSAO.frag");
+	ShaderLoader::CreateProgram("ssaoBlur", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/SSAOBlur.frag");
+	ShaderLoader::CreateProgram("postFog", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/PostFog.frag");
+	ShaderLoader::CreateProgram("postTonemap", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/Tonemap.frag");
+	ShaderLoader::CreateProgram("postFXAA", "Resources/Shaders/FullScreen.vert", "Resources/Shaders/FXAA.frag");
+
+	//Shapes sharing the lit program and textures get drawn with one multi draw indirect call
+	CRenderQueue::SetInstancedProgram(ShaderLoader::GetProgram("3DLight")->m_id, ShaderLoader::GetProgram("3DLightInstanced")->m_id);
+	CRenderQueue::SetInstancedProgram(ShaderLoader::GetProgram("gBuffer")->m_id, ShaderLoader::GetProgram("gBufferInstanced")->m_id);
+
+	//Opaque shapes go nearest first, and the lit ones write their depth first so lighting only runs on visible pixels (P toggles)
+	CRenderQueue::SetOpaqueOrder(OpaqueOrder::FrontToBack);
+	CRenderQueue::SetDepthProgram(ShaderLoader::GetProgram("depthOnly")->m_id);
+	CRenderQueue::SetPrepass(ShaderLoader::GetProgram("3DLight")->m_id, true);
 }
 
 void InitShapes()
@@ -556,74 +639,65 @@ void InitShapes()
 	//Set program and add uniforms to Rectangle
 	if (_shape = CObjectManager::GetShape("floor")) {
 		_shape->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-		_shape->AddUniform(new ImageUniform(Texture_Floor, "ImageTexture"));
-		_shape->AddUniform(new IntUniform(0, "frameCount"));
-		_shape->AddUniform(new FloatUniform(0, "offset"));
-		_shape->AddUniform(new CubemapUniform(Texture_Cubemap, "Skybox"));
-		_shape->AddUniform(new FloatUniform(0.02f, "Reflectivity"));
-		_shape->AddUniform(new BoolUniform(false, "hasRefMap"));
-		_shape->AddUniform(new FloatUniform(0, "RimExponent"));
-		_shape->AddUniform(new FloatUniform(0, "CurrentTime"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "PVMMat"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "Model"));
+		CUniformBlock& uniforms = _shape->GetUniforms();
+		uniforms.SetTexture("ImageTexture", Texture_Floor);
+		uniforms.SetInt("frameCount", 0);
+		uniforms.SetFloat("offset", 0);
+		uniforms.SetCubemap("Skybox", Texture_Cubemap);
+		uniforms.SetFloat("Reflectivity", 0.02f);
+		uniforms.SetBool("hasRefMap", false);
+		uniforms.SetFloat("RimExponent", 0);
 	}
 
 	//Set program and add uniforms to Cube
 	if (_shape = CObjectManager::GetShape("sphere1")) {
 		_shape->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-		_shape->AddUniform(new ImageUniform(Texture_Rayman, "ImageTexture"));
-		_shape->AddUniform(new IntUniform(0, "frameCount"));
-		_shape->AddUniform(new FloatUniform(0, "offset"));
-		_shape->AddUniform(new CubemapUniform(Texture_Cubemap, "Skybox"));
-		_shape->AddUniform(new FloatUniform(0.5f, "Reflectivity"));
-		_shape->AddUniform(new BoolUniform(false, "hasRefMap"));
-		_shape->AddUniform(new FloatUniform(5, "RimExponent"));
-		_shape->AddUniform(new Vec3Uniform(glm::vec3(1.0f, 0.0f, 0.0f), "RimColour"));
-		_shape->AddUniform(new Vec3Uniform(glm::vec3(1.0f, 0.0f, 0.0f), "Colour"));
-		_shape->AddUniform(new FloatUniform(0, "CurrentTime"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "PVMMat"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "Model"));
+		CUniformBlock& uniforms = _shape->GetUniforms();
+		uniforms.SetTexture("ImageTexture", Texture_Rayman);
+		uniforms.SetInt("frameCount", 0);
+		uniforms.SetFloat("offset", 0);
+		uniforms.SetCubemap("Skybox", Texture_Cubemap);
+		uniforms.SetFloat("Reflectivity", 0.5f);
+		uniforms.SetBool("hasRefMap", false);
+		uniforms.SetFloat("RimExponent", 5);
+		uniforms.SetVec3("RimColour", glm::vec3(1.0f, 0.0f, 0.0f));
+
+		//Only used by the solid colour program when drawing the outline
+		uniforms.SetVec3("Colour", glm::vec3(1.0f, 0.0f, 0.0f));
+
+		_shape->SetShadowCaster(true);
 	}
 
 	//Set program and add uniforms to Cube
 	if (_shape = CObjectManager::GetShape("cube1")) {
 		_shape->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-		_shape->AddUniform(new ImageUniform(Texture_Rayman, "ImageTexture"));
-		_shape->AddUniform(new IntUniform(0, "frameCount"));
-		_shape->AddUniform(new FloatUniform(0, "offset"));
-		_shape->AddUniform(new CubemapUniform(Texture_Cubemap, "Skybox"));
-		_shape->AddUniform(new FloatUniform(0.0f, "Reflectivity"));
-		_shape->AddUniform(new BoolUniform(false, "hasRefMap"));
-		_shape->AddUniform(new FloatUniform(5, "RimExponent"));
-		_shape->AddUniform(new Vec3Uniform(glm::vec3(1.0f, 0.0f, 0.0f), "RimColour"));
-		_shape->AddUniform(new Vec3Uniform(glm::vec3(1.0f, 0.0f, 0.0f), "Colour"));
-		_shape->AddUniform(new FloatUniform(0, "CurrentTime"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "PVMMat"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "Model"));
+		CUniformBlock& uniforms = _shape->GetUniforms();
+		uniforms.SetTexture("ImageTexture", Texture_Rayman);
+		uniforms.SetInt("frameCount", 0);
+		uniforms.SetFloat("offset", 0);
+		uniforms.SetCubemap("Skybox", Texture_Cubemap);
+		uniforms.SetFloat("Reflectivity", 0.0f);
+		uniforms.SetBool("hasRefMap", false);
+		uniforms.SetFloat("RimExponent", 5);
+		uniforms.SetVec3("RimColour", glm::vec3(1.0f, 0.0f, 0.0f));
 	}
 
 	//Set program and add uniforms to Cube
 	if (_shape = CObjectManager::GetShape("water1")) {
 		_shape->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-		_shape->AddUniform(new AnimationUniform(Texture_Water, 100, 0.1f, _shape,  "ImageTexture"));
-		_shape->AddUniform(new IntUniform(100, "frameCount"));
-		_shape->AddUniform(new FloatUniform(0, "offset"));
-		_shape->AddUniform(new CubemapUniform(Texture_Cubemap, "Skybox"));
-		_shape->AddUniform(new FloatUniform(0.1f, "Reflectivity"));
-		_shape->AddUniform(new BoolUniform(false, "hasRefMap"));
-		_shape->AddUniform(new FloatUniform(0, "RimExponent"));
-		_shape->AddUniform(new Vec3Uniform(glm::vec3(0.0f, 0.0f, 0.0f), "RimColour"));
-		_shape->AddUniform(new FloatUniform(0, "CurrentTime"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "PVMMat"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "Model"));
+		_shape->SetAnimation(Texture_Water, 100, 0.1f);
+		CUniformBlock& uniforms = _shape->GetUniforms();
+		uniforms.SetCubemap("Skybox", Texture_Cubemap);
+		uniforms.SetFloat("Reflectivity", 0.1f);
+		uniforms.SetBool("hasRefMap", false);
+		uniforms.SetFloat("RimExponent", 0);
+		uniforms.SetVec3("RimColour", glm::vec3(0.0f, 0.0f, 0.0f));
 	}
 
 	//Set program and add uniforms to skybox
 	if (_shape = CObjectManager::GetShape("skybox")) {
 		_shape->SetProgram(ShaderLoader::GetProgram("skybox")->m_id);
-		_shape->AddUniform(new CubemapUniform(Texture_Cubemap, "ImageTexture"));
-		_shape->AddUniform(new FloatUniform(0, "CurrentTime"));
-		_shape->AddUniform(new Mat4Uniform(_shape->GetPVM(), "PVMMat"));
+		_shape->GetUniforms().SetCubemap("ImageTexture", Texture_Cubemap);
 	}
 }
 #pragma endregion
@@ -647,13 +721,13 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 
 	//Change line mode (fill or line) with F
 	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
-		GLboolean isCull = glIsEnabled(GL_CULL_FACE);
+		bool isCull = CGLState::IsEnabled(GL_CULL_FACE);
 
 		if (isCull) {
-			glDisable(GL_CULL_FACE);
+			CGLState::Disable(GL_CULL_FACE);
 		}
 		else {
-			glEnable(GL_CULL_FACE);
+			CGLState::Enable(GL_CULL_FACE);
 		}
 	}
 
@@ -665,6 +739,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		ObjectCreation();
 		//Set up shapes
 		InitShapes();
+		ApplyRenderPath();
 
 		g_camera->SetCameraPos({ 0,0,0 });
 		g_camera->SetYaw(0);
@@ -674,10 +749,43 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 
 	//Change backface mode (cull or no cull) with B
 	if (key == GLFW_KEY_F && action == GLFW_PRESS) {
-		GLint polygonMode[2];
-		glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+		CGLState::PolygonMode(CGLState::GetPolygonMode() == GL_FILL ? GL_LINE : GL_FILL);
+	}
+
+	//Switch opaque lit shapes between forward and deferred shading with G
+	if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		CDeferredRenderer::SetEnabled(!CDeferredRenderer::IsEnabled());
+		ApplyRenderPath();
+	}
+
+	//Switch static shapes between baked and per pixel lighting with L
+	if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		g_useLightmaps = !g_useLightmaps;
+		ApplyRenderPath();
+	}
 
-		glPolygonMode(GL_FRONT_AND_BACK, (polygonMode[0] == GL_FILL ? GL_LINE : GL_FILL));
+	//Cycle ambient occlusion quality (off, low, high) with O
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		CAmbientOcclusion::SetQuality((AOQuality)(((int)CAmbientOcclusion::GetQuality() + 1) % 3));
+	}
+
+	//Cycle anti-aliasing (none, MSAA, FXAA) with M
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		CPostProcess::SetAntiAliasing((AntiAliasing)(((int)CPostProcess::GetAntiAliasing() + 1) % 3));
+	}
+
+	//Toggle the fog and tonemap post passes with H and T
+	if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		CPostProcess::SetPassEnabled(PostPass::Fog, !CPostProcess::IsPassEnabled(PostPass::Fog));
+	}
+	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		CPostProcess::SetPassEnabled(PostPass::Tonemap, !CPostProcess::IsPassEnabled(PostPass::Tonemap));
+	}
+
+	//Toggle the depth prepass for forward lit shapes with P
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		GLuint program = ShaderLoader::GetProgram("3DLight")->m_id;
+		CRenderQueue::SetPrepass(program, !CRenderQueue::HasPrepass(program));
 	}
 
 	//Hide or show cursor
@@ -699,116 +807,9 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 /// <param name="mods"></param>
 void MouseCallback(GLFWwindow* window, int button, int action, int mods) {
 
-	double xPos;
-	double yPos;
-	glfwGetCursorPos(g_window, &xPos, &yPos);
-	utils::mousePos = glm::vec2(xPos, utils::windowHeight - yPos);
-
-	//get mouse ray from camera
-	glm::vec3 worldRay = g_camera->GetWorldRay();
-
-	//If left clicking
+	//If left clicking, pick what is under the mouse on the next update
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-
-		//Get shape to move/compare
-		CShape* _shape = CObjectManager::GetShape("cube1");
-
-		//Make list of directions to check (supposed to get local orientation, so that the following works with roations, but not yet implimented/needed)
-		std::vector<glm::vec3> dirsToCheck = { _shape->Up() , -_shape->Up(),  _shape->Forward(), -_shape->Forward(), _shape->Right() ,-_shape->Right()};
-
-		//store bool for if intersection occurs
-		bool doesIntersect = false;
-
-		//store point of intersection
-		glm::vec3 intersectPoint = glm::vec3(0, 0, 0);
-
-		//make copy of ray to make more sense
-		glm::vec3 lineDirection = worldRay;
-
-		//Look through all directions/faces of cube, and check intersections
-		for (const glm::vec3& _dir : dirsToCheck) {
-
-			//get plane normal (face direction)
-			glm::vec3 pn = _dir;
-			//line starting point
-			glm::vec3 lpa = g_camera->GetCameraPos();
-			//line ending point
-			glm::vec3 lpb = g_camera->GetCameraPos() + lineDirection * 1000.0f;
-
-			//Get dot between line and face dir
-			float dot = glm::dot(lineDirection, pn);
-
-			//If dot is not valid (aka cannot see front of face), discard, else check collision point
-			if (dot >= 0) {
-				doesIntersect = false;
-			}
-			else {
-				//store values for later usage
-				float f1 = 0.5f;
-				float f2 = 0.5f;
-				float distScale = 0.5f;
-
-				//Check which direction it is, and assign specific values based on that info
-				if (glm::abs(_dir) == _shape->Up()) {
-					f1 = _shape->GetScale().z / 2.0f;
-					f2 = _shape->GetScale().x / 2.0f;
-					distScale = _shape->GetScale().y/2;
-				}
-				else if (glm::abs(_dir) == _shape->Forward()) {
-					f1 = _shape->GetScale().y / 2.0f;
-					f2 = _shape->GetScale().x / 2.0f;
-					distScale = _shape->GetScale().z/2;
-				}
-				else if (glm::abs(_dir) == _shape->Right()) {
-					f1 = _shape->GetScale().y / 2.0f;
-					f2 = _shape->GetScale().z / 2.0f;
-					distScale = _shape->GetScale().x/2;
-				}
-
-				//Calc distance from camera to point hit
-				float distance = glm::dot(_shape->GetPosition() + (pn * distScale) - lpa, pn) / glm::dot(lineDirection, pn);
-
-				//max hit distance
-				float lineDistance = 1000.0f;
-
-				//If distance is within max hit distance, proceed to check specific quad values
-				if (distance <= lineDistance) {
-
-					//Does intersect at some point, might not be within values of quad
-					doesIntersect = true;
-
-					//calc actual intersect point in world
-					intersectPoint = lpa + (lineDirection * distance);
-
-					//Print in console
-					Print(5, 15, "Int Position (y: " + std::to_string(intersectPoint.y) + " z:" + std::to_string(intersectPoint.z) + ")    ", 15);
-
-					//Store max value for tangent directions (e.g. if face is forward, store up and right max)
-					float v1 = 0.0f;
-					float v2 = 0.0f;
-					if (glm::abs(_dir) == _shape->Up()) {
-						v1 = abs(intersectPoint.z - _shape->GetPosition().z);
-						v2 = abs(intersectPoint.x - _shape->GetPosition().x);
-					}
-					else if (glm::abs(_dir) == _shape->Forward()) {
-						v1 = abs(intersectPoint.y - _shape->GetPosition().y);
-						v2 = abs(intersectPoint.x - _shape->GetPosition().x);
-					}
-					else if (glm::abs(_dir) == _shape->Right()){
-						v1 = abs(intersectPoint.y - _shape->GetPosition().y);
-						v2 = abs(intersectPoint.z - _shape->GetPosition().z);
-					}
-
-					//Check if point lies within max values of quad
-					if (v1 <= f1 && v2 <= f2) { _shape->SetPosition(_shape->GetPosition() - _dir); }
-				}
-				else {
-					doesIntersect = false;
-				}
-			}
-
-		}
-
+		g_pickRequested = true;
 	}
 }
 
@@ -839,7 +840,7 @@ void GenTexture(GLuint& texture, const char* texPath)
 	unsigned char* ImageData = stbi_load(texPath, &ImageWidth, &ImageHeight, &ImageComponents, 0);
 	//Gen and bind texture
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	CGLState::BindTexture(GL_TEXTURE_2D, texture);
 
 	//Check how many components in image (RGBA or RGB)
 	GLint LoadedComponents = ((ImageComponents == 4) ? GL_RGBA : GL_RGB);
@@ -854,7 +855,7 @@ void GenTexture(GLuint& texture, const char* texPath)
 
 	//Unbind and free texture and image
 	stbi_image_free(ImageData);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	CGLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 /// <summary>
@@ -873,7 +874,7 @@ void GenCubemap(GLuint& texture, std::string texPath[6])
 
 	//Gen and bind texture
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	CGLState::BindTexture(GL_TEXTURE_CUBE_MAP, texture);
 
 	for (int i = 0; i < 6; i++) {
 		std::string fullFilePath = "Resources/Textures/Cubemaps/" + texPath[i];
@@ -899,7 +900,7 @@ void GenCubemap(GLuint& texture, std::string texPath[6])
 	//Generating the mipmaps, free the memory and unbind the texture
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	CGLState::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 
@@ -917,16 +918,27 @@ void Update()
 	//CObjectManager::GetShape("sphere1")->SetPosition(glm::vec3(sin(utils::currentTime + glm::pi<float>())*2, 0, cos(utils::currentTime + glm::pi<float>())*2));
 
 	//Update all shapes
+	size_t allocations = utils::allocationCount;
 	CObjectManager::UpdateAll(utils::deltaTime, utils::currentTime);
-
-	glUseProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-	glUniform3fv(glGetUniformLocation(ShaderLoader::GetProgram("3DLight")->m_id, "CameraPos"), 1, glm::value_ptr(g_camera->GetCameraPos()));
-	glUseProgram(0);
+	g_sceneAllocations = utils::allocationCount - allocations;
 
 	//Check for input
 	CheckInput(utils::deltaTime, utils::currentTime);
 
-	CLightManager::UpdateUniforms(ShaderLoader::GetProgram("3DLight")->m_id);
+	//Update camera for the lit programs
+	static const std::string litPrograms[] = { "3DLight", "3DLightInstanced", "deferredLight", "deferredPointLight", "3DLightBaked" };
+	for (const std::string& _programName : litPrograms) {
+		GLuint program = ShaderLoader::GetProgram(_programName)->m_id;
+
+		CGLState::UseProgram(program);
+		glUniform3fv(ShaderLoader::GetUniformLocation(program, "CameraPos"), 1, glm::value_ptr(g_camera->GetCameraPos()));
+	}
+
+	//Lights are shared by all lit programs, only uploaded if they changed
+	CLightManager::Update();
+
+	//Static shapes' lighting is baked again (or loaded from disk) only when they, the static shadow casters or the lights change
+	CLightmapBaker::Update();
 }
 
 /// <summary>
@@ -990,6 +1002,55 @@ void CheckInput(float _deltaTime, float _currentTime)
 		camMovement = glm::normalize(camMovement) * camSpeed * _deltaTime;
 		g_camera->SetCameraPos(g_camera->GetCameraPos() + camMovement);
 	}
+
+	if (g_pickRequested) {
+		g_pickRequested = false;
+		PickShape();
+	}
+}
+
+/// <summary>
+/// Cast the mouse ray through the scene tree, and push the cube away from the face that was clicked
+/// </summary>
+void PickShape()
+{
+	//get mouse ray from camera
+	glm::vec3 worldRay = g_camera->GetWorldRay();
+
+	RayHit hit;
+	if (!CSceneBVH::Raycast(g_camera->GetCameraPos(), worldRay, hit)) {
+		Print(5, 15, "Int Position (none)                                        ", 15);
+		return;
+	}
+
+	Print(5, 15, "Int Position (x: " + std::to_string(hit.point.x) + " y: " + std::to_string(hit.point.y) + " z: " + std::to_string(hit.point.z) + " triangle: " + std::to_string(hit.triangle / 3) + ")    ", 15);
+
+	//Only the cube can be pushed around
+	if (hit.shape == CObjectManager::GetShape("cube1", false)) {
+		hit.shape->SetPosition(hit.shape->GetPosition() - hit.normal);
+	}
+}
+
+/// <summary>
+/// Give every opaque lit shape the program for the current lighting path, the G-buffer program when deferred.
+/// Static shapes use their baked lightmap instead while lightmaps are on
+/// </summary>
+void ApplyRenderPath()
+{
+	GLuint forward = ShaderLoader::GetProgram("3DLight")->m_id;
+	GLuint deferred = ShaderLoader::GetProgram("gBuffer")->m_id;
+	GLuint baked = ShaderLoader::GetProgram("3DLightBaked")->m_id;
+
+	GLuint lit = (CDeferredRenderer::IsEnabled() ? deferred : forward);
+
+	const std::map<std::string, CShape*>& shapes = CObjectManager::GetShapes();
+	for (std::map<std::string, CShape*>::const_iterator it = shapes.begin(); it != shapes.end(); it++) {
+		CShape* shape = it->second;
+		GLuint program = shape->GetProgram();
+		if (shape->GetRenderPass() != RenderPass::Opaque || (program != forward && program != deferred && program != baked)) continue;
+
+		shape->SetProgram((g_useLightmaps && CLightmapBaker::CanBake(shape)) ? baked : lit);
+	}
 }
 
 /// <summary>
@@ -997,34 +1058,104 @@ void CheckInput(float _deltaTime, float _currentTime)
 /// </summary>
 void Render()
 {
+	size_t allocations = utils::allocationCount;
+
+	CTransformRing::BeginFrame();
+	CRenderQueue::NewFrame();
+	CGLState::NewFrame();
+	CUniformBlock::NewFrame();
+	CFontManager::NewFrame();
+	CTextBatcher::NewFrame();
+	CFrustumCuller::NewFrame();
+	CPointShadows::NewFrame();
+	CCascadedShadows::NewFrame();
+	CDeferredRenderer::NewFrame();
+	CPostProcess::NewFrame();
+
+	//Redraw point light shadows where casters moved, before anything uses them
+	CPointShadows::Render();
+
+	//Same for the directional light's cascades, which also follow the camera
+	CCascadedShadows::Render(g_camera);
+
+	//Shapes drawn this frame are culled against the camera's view
+	g_camera->UpdatePerspective();
+	CFrustumCuller::SetFrustum(g_camera->GetProjectionViewMat());
+
+	//Point lights are only shaded in the clusters they reach
+	CLightClusters::Build(g_camera);
+
+	//Ambient occlusion from a half resolution depth pass, read by the lit shaders
+	CAmbientOcclusion::Render(g_camera);
+
 	//Enable blending for textures with opacity
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	CGLState::Enable(GL_BLEND);
+	CGLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//Scene is drawn offscreen, then post processed onto the screen
+	CPostProcess::BeginScene();
 
 	//Clear screen, and stenctils
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 	//Enable scissor to cut out top and bottom
-	glEnable(GL_SCISSOR_TEST);
+	CGLState::Enable(GL_SCISSOR_TEST);
 	glScissor(0, 100, 800, 600);
 
-	//Render normal objects
-	CObjectManager::GetShape("skybox")->Render();
-	CObjectManager::GetShape("floor")->Render();
-	CObjectManager::GetShape("cube1")->Render();
+	bool deferred = CDeferredRenderer::IsEnabled();
+	bool floorBaked = (CObjectManager::GetShape("floor")->GetProgram() == ShaderLoader::GetProgram("3DLightBaked")->m_id);
+
+	if (deferred) {
+		//Opaque lit shapes only write their surface, then every pixel is shaded once
+		CDeferredRenderer::BeginGeometry();
+
+		if (!floorBaked) CRenderQueue::Submit(CObjectManager::GetShape("floor"));
+		CRenderQueue::Submit(CObjectManager::GetShape("cube1"));
+		CRenderQueue::Flush(g_camera);
+
+		CObjectManager::GetShape("sphere1")->SetProgram(ShaderLoader::GetProgram("gBuffer")->m_id);
+		CObjectManager::GetShape("sphere1")->Render();
+
+		CDeferredRenderer::EndGeometry(g_camera);
+
+		//Baked shapes are already lit, they are drawn forward over the shaded G-buffer
+		if (floorBaked) {
+			CRenderQueue::Submit(CObjectManager::GetShape("floor"));
+			CRenderQueue::Flush(g_camera);
+		}
+	}
+	else {
+		//Render normal objects (sorted front to back)
+		CRenderQueue::Submit(CObjectManager::GetShape("floor"));
+		CRenderQueue::Submit(CObjectManager::GetShape("cube1"));
+		CRenderQueue::Flush(g_camera);
+	}
 
 	//Enable stencil, and set function
-	glEnable(GL_STENCIL_TEST);
+	CGLState::Enable(GL_STENCIL_TEST);
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
 	//Render normal sphere
 	//Also write to stencil, so that coloured sphere does not overlap
 	glStencilFunc(GL_ALWAYS, 1, 0xFF);
 	glStencilMask(0xFF);
-	CObjectManager::GetShape("sphere1")->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
-	CObjectManager::GetShape("sphere1")->UpdateUniform(new Vec3Uniform({ 1,0,0 }, "Colour"));
-	CObjectManager::GetShape("sphere1")->UpdateUniform(new Mat4Uniform(CObjectManager::GetShape("sphere1")->GetPVM(), "Model"));
-	CObjectManager::GetShape("sphere1")->Render();
+	if (deferred) {
+		//Already shaded, only its stencil is needed (the depth is the same, so it passes with LEQUAL)
+		GLenum depthFunc = CGLState::GetDepthFunc();
+		CGLState::DepthFunc(GL_LEQUAL);
+		CGLState::ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+		CObjectManager::GetShape("sphere1")->SetProgram(ShaderLoader::GetProgram("solidColour")->m_id);
+		CObjectManager::GetShape("sphere1")->Render();
+
+		CGLState::ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		CGLState::DepthFunc(depthFunc);
+	}
+	else {
+		CObjectManager::GetShape("sphere1")->SetProgram(ShaderLoader::GetProgram("3DLight")->m_id);
+		CObjectManager::GetShape("sphere1")->GetUniforms().SetVec3("Colour", { 1,0,0 });
+		CObjectManager::GetShape("sphere1")->Render();
+	}
 
 	//Render scaled up and colour only sphere
 	//Only render where stencil value is not 1 (aka where original sphere is)
@@ -1032,22 +1163,86 @@ void Render()
 	glStencilMask(0x00);
 	CObjectManager::GetShape("sphere1")->Scale(1.1f);
 	CObjectManager::GetShape("sphere1")->SetProgram(ShaderLoader::GetProgram("solidColour")->m_id);
-	CObjectManager::GetShape("sphere1")->UpdateUniform(new Vec3Uniform({ 1,0,0 }, "Colour"));
-	CObjectManager::GetShape("sphere1")->UpdateUniform(new Mat4Uniform(CObjectManager::GetShape("sphere1")->GetPVM(), "Model"));
+	CObjectManager::GetShape("sphere1")->GetUniforms().SetVec3("Colour", { 1,0,0 });
 	CObjectManager::GetShape("sphere1")->Render();
 	CObjectManager::GetShape("sphere1")->Scale(1.0f / 1.1f);
 	glStencilMask(0xFF);
-	glDisable(GL_STENCIL_TEST);
+	CGLState::Disable(GL_STENCIL_TEST);
+
+	//Skybox is drawn at the far plane after everything opaque, so it only shades the pixels left uncovered
+	CRenderQueue::Submit(CObjectManager::GetShape("skybox"));
+	CRenderQueue::Flush(g_camera);
 
 	//Render water with backface enabled
-	GLboolean cull = glIsEnabled(GL_CULL_FACE);
-	glDisable(GL_CULL_FACE);
+	bool cull = CGLState::IsEnabled(GL_CULL_FACE);
+	CGLState::Disable(GL_CULL_FACE);
 	CObjectManager::GetShape("water1")->Render();
-	if (cull) glEnable(GL_CULL_FACE);
+	if (cull) CGLState::Enable(GL_CULL_FACE);
 
 	//Disable scissor
-	glDisable(GL_SCISSOR_TEST);
+	CGLState::Disable(GL_SCISSOR_TEST);
+
+	//Fog, tonemap and FXAA onto the screen, text goes over the result untouched
+	CPostProcess::EndScene(g_camera);
+
+	//Every label rendered this frame, drawn together over the scene
+	CTextBatcher::Flush();
+
+	g_sceneAllocations += utils::allocationCount - allocations;
+
+	//Show how many state changes sorting saved this frame
+	RenderQueueStats queueStats = CRenderQueue::GetStats();
+	Print(5, 20, "Render queue (draws: " + std::to_string(queueStats.draws) + " indirect: " + std::to_string(queueStats.indirectDraws) + "/" + std::to_string(queueStats.indirectCommands) + "/" + std::to_string(queueStats.instances) + " state changes: " + std::to_string(queueStats.GetChanges()) + " saved: " + std::to_string(queueStats.GetSaved()) + " prepass: " + std::to_string(queueStats.prepassDraws) + ")    ", 15);
+
+	//Show how many state calls never reached the driver
+	GLStateStats stateStats = CGLState::GetStats();
+	Print(5, 21, "GL state (calls: " + std::to_string(stateStats.calls) + " redundant: " + std::to_string(stateStats.GetSkipped()) + " programs: " + std::to_string(stateStats.skippedPrograms) + " vaos: " + std::to_string(stateStats.skippedVertexArrays) + " textures: " + std::to_string(stateStats.skippedTextures) + " caps: " + std::to_string(stateStats.skippedCapabilities) + " queries: " + std::to_string(stateStats.queries) + ")    ", 15);
+
+	//Show uniform uploads and whether the frame touched the heap
+	UniformStats uniformStats = CUniformBlock::GetStats();
+	Print(5, 22, "Uniforms (sent: " + std::to_string(uniformStats.sent) + " skipped: " + std::to_string(uniformStats.skipped) + ") allocations: " + std::to_string(g_sceneAllocations) + "    ", 15);
+
+	//Show how many draws the text took
+	TextBatchStats textStats = CTextBatcher::GetStats();
+	Print(5, 23, "Text (labels: " + std::to_string(textStats.labels) + " glyphs: " + std::to_string(textStats.glyphs) + " draws: " + std::to_string(textStats.draws) + ")    ", 15);
+
+	//Show how many shapes were outside the view
+	CullStats cullStats = CFrustumCuller::GetStats();
+	Print(5, 24, "Culling (tested: " + std::to_string(cullStats.GetTested()) + " visible: " + std::to_string(cullStats.visible) + " culled: " + std::to_string(cullStats.culled) + ")    ", 15);
+
+	//Show how much of the point light shadows was redrawn
+	PointShadowStats shadowStats = CPointShadows::GetStats();
+	Print(5, 25, "Point shadows (static faces: " + std::to_string(shadowStats.staticFaces) + " dynamic faces: " + std::to_string(shadowStats.dynamicFaces) + " casters: " + std::to_string(shadowStats.casters) + " waiting: " + std::to_string(shadowStats.waiting) + ")    ", 15);
+
+	CascadeStats cascadeStats = CCascadedShadows::GetStats();
+	Print(5, 26, "Cascades (rendered: " + std::to_string(cascadeStats.rendered) + " casters: " + std::to_string(cascadeStats.casters) + ")    ", 15);
+
+	//Frame time for comparing the forward and deferred paths (G switches)
+	DeferredStats deferredStats = CDeferredRenderer::GetStats();
+	Print(5, 28, std::string(deferred ? "Deferred" : "Forward ") + " (frame: " + std::to_string(utils::deltaTime * 1000.0f) + "ms lighting passes: " + std::to_string(deferredStats.lightingPasses) + " light volumes: " + std::to_string(deferredStats.lightVolumes) + ")    ", 15);
+
+	ClusterStats clusterStats = CLightClusters::GetStats();
+	Print(5, 27, "Light clusters (lights: " + std::to_string(clusterStats.lights) + " assignments: " + std::to_string(clusterStats.assignments) + " busiest: " + std::to_string(clusterStats.busiest) + ")    ", 15);
+
+	//Lightmap bake, only redone when the static shapes, shadow casters or lights change (L switches)
+	LightmapStats lightmapStats = CLightmapBaker::GetStats();
+	Print(5, 29, std::string("Lightmaps ") + (g_useLightmaps ? "on " : "off") + " (shapes: " + std::to_string(lightmapStats.shapes) + " texels: " + std::to_string(lightmapStats.texels) + (lightmapStats.fromCache ? " from cache" : " baked in " + std::to_string(lightmapStats.bakeMs) + "ms") + ")    ", 15);
+
+	//GPU time of each ambient occlusion pass (O switches quality)
+	static const char* aoQualityNames[] = { "off ", "low ", "high" };
+	AOStats aoStats = CAmbientOcclusion::GetStats();
+	Print(5, 30, std::string("SSAO ") + aoQualityNames[(int)CAmbientOcclusion::GetQuality()] + " (shapes: " + std::to_string(aoStats.shapes) + " depth: " + std::to_string(aoStats.depthMs) + "ms occlusion: " + std::to_string(aoStats.occlusionMs) + "ms blur: " + std::to_string(aoStats.blurMs) + "ms)    ", 15);
+
+	//Geometry arena growth only happens while meshes load
+	ArenaStats arenaStats = CGeometryArena::GetStats();
+	Print(5, 32, "Geometry arena (grows: " + std::to_string(arenaStats.grows) + " reserved: " + std::to_string(arenaStats.capacity / 1024) + "KB)    ", 15);
+
+	//Which post passes ran (M switches anti-aliasing, H fog, T tonemap)
+	static const char* antiAliasingNames[] = { "none", "MSAA", "FXAA" };
+	PostStats postStats = CPostProcess::GetStats();
+	Print(5, 31, std::string("Post (anti-aliasing: ") + antiAliasingNames[(int)CPostProcess::GetAntiAliasing()] + " resolved: " + (postStats.resolved ? "yes" : "no ") + " fog: " + (CPostProcess::IsPassEnabled(PostPass::Fog) ? "on " : "off") + " tonemap: " + (CPostProcess::IsPassEnabled(PostPass::Tonemap) ? "on " : "off") + " passes: " + std::to_string(postStats.passes) + ")    ", 15);
 
+	CTransformRing::EndFrame();
 	glfwSwapBuffers(g_window);
 }
 
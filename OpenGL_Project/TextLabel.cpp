@@ -9,186 +9,201 @@
 /// <param name="_pos"> position on screen</param>
 /// <param name="_color"></param>
 /// <param name="_scale"></param>
+/// <param name="_mode"> SDF keeps the text sharp when scaled up (e.g. bouncing)</param>
 /// <returns></returns>
-TextLabel::TextLabel(std::string _text, std::string _font, glm::ivec2 _pixelSize, glm::vec2 _pos, glm::vec3 _color, glm::vec2 _scale):
-    m_copyPosition(_pos), m_pixelSize(_pixelSize), m_copyScale(_scale)
+TextLabel::TextLabel(std::string _text, std::string _font, glm::ivec2 _pixelSize, glm::vec2 _pos, glm::vec3 _color, glm::vec2 _scale, FontMode _mode):
+    m_pixelSize(_pixelSize)
 {
     SetText(_text);
     SetColor(_color);
     SetScale(_scale);
     SetPosition(_pos);
 
-    //Calc new ortho matrix
-    ProjectionMat = glm::ortho(0.0f, (float)utils::windowWidth, 0.0f, (float)utils::windowHeight, 0.0f, 100.0f);
-    //Bind default program
-    Program_Text = ShaderLoader::CreateProgram("text", "Resources/Shaders/Text.vert", "Resources/Shaders/Text.frag" );
-
-    FT_Library FontLibrary;
-    FT_Face FontFace;
-
-    //Init the freetype library
-    if (FT_Init_FreeType(&FontLibrary) != 0) {
-        std::cout << "FreeType Error: Could not init FreeType Library" << std::endl;
+    //Glyphs are only rasterized the first time a font and size is used
+    m_font = CFontManager::GetFont(_font, _pixelSize, _mode);
+    if (m_font == nullptr) {
         return;
     }
 
-    //Load font
-    if (FT_New_Face(FontLibrary, _font.c_str(), 0, &FontFace) != 0) {
-        std::cout << "FreeType Error: Failed to Load Font" << std::endl;
-        return;
-    }
+    //SDF glyphs are all one size, scaled to what was asked for
+    m_glyphScale = (float)_pixelSize.y / (float)m_font->GetPixelSize().y;
 
-    //Set pixel size
-    FT_Set_Pixel_Sizes(FontFace, _pixelSize.x, _pixelSize.y);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    m_initialized = true;
+}
 
-    //Create characters from font and store to map
-    for (GLubyte Glyph = 0; Glyph < fontCharacterLimit; Glyph++) {
-        if (FT_Load_Char(FontFace, Glyph, FT_LOAD_RENDER)) {
-            std::cout << "FreeType Error: Failed to Load Glyph" << (unsigned char)Glyph << std::endl;
-            continue;
-        }
+TextLabel::~TextLabel()
+{
+}
 
-        FontChar FontCharacter = {
-            GenerateTexture(FontFace),
-            glm::ivec2(FontFace->glyph->bitmap.width, FontFace->glyph->bitmap.rows),
-            glm::ivec2(FontFace->glyph->bitmap_left, FontFace->glyph->bitmap_top),
-            (GLuint)FontFace->glyph->advance.x / 64
-        };
-        CharacterMap.insert(std::pair<GLchar, FontChar>(Glyph, FontCharacter));
+/// <summary>
+/// Queue the text to be drawn with every other label when the text batcher is flushed
+/// </summary>
+void TextLabel::Render()
+{
+    if (m_initialized == false) {
+        return;
     }
 
-    FT_Done_Face(FontFace);
-    FT_Done_FreeType(FontLibrary);
+    UpdateLayout();
 
-    //gen VAO
-    glGenVertexArrays(1, &VAO_Text);
-    glBindVertexArray(VAO_Text);
-
-	//Gen EBO 
-	glGenBuffers(1, &EBO_Text);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_Text);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+    if (m_glyphs.empty()) {
+        return;
+    }
 
-	//Gen VBO 
-	glGenBuffers(1, &VBO_DynamicQuad);
-	//copy our vertices array in a buffer for OpenGL to use
-	glBindBuffer(GL_ARRAY_BUFFER, VBO_DynamicQuad);
-	glBufferData(GL_ARRAY_BUFFER, 4 * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    //Moving the label only changes its origin, the glyphs stay as laid out
+    TextLabelData label;
+    label.origin = glm::vec4(m_position, 0.0f, 0.0f);
+    label.colour = glm::vec4(m_color, (m_font->GetMode() == FontMode::SDF ? 1.0f : 0.0f));
 
-    //Set the vertex attributes pointers (How to interperet Vertex Data)
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(0);
+    //Scrolls one character height per second, hidden within one character of the ends
+    if (m_scrollText) {
+        label.clip = glm::vec4(m_scrollClip.x, m_scrollClip.y, m_pixelSize.y, m_pixelSize.y);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    //Scales around the centre of its ink
+    if (m_bounceText) {
+        glm::vec2 centre = m_position + (glm::vec2(m_bounds.x, m_bounds.y) + glm::vec2(m_bounds.z, m_bounds.w)) / 2.0f;
+        label.bounce = glm::vec4(centre, 1.0f, 0.0f);
+    }
 
-    m_initialized = true;
-}
-
-TextLabel::~TextLabel()
-{
+    m_font->Touch(m_glyphIndices);
+    CTextBatcher::Submit(m_font->GetAtlas(), m_glyphs, label);
 }
 
 /// <summary>
-/// Render the text
+/// Lay the text out if the text, scale or wrap width changed, or the font moved its glyphs
 /// </summary>
-void TextLabel::Render()
+void TextLabel::UpdateLayout()
 {
     if (m_initialized == false) {
         return;
     }
 
-    //Disable depth test for text
-    GLboolean _copyOfDepthTest = glIsEnabled(GL_DEPTH_TEST);
-    if (_copyOfDepthTest) glDisable(GL_DEPTH_TEST);
-    
-    //Set blend mode
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (m_dirty || m_font->GetVersion() != m_fontVersion) {
+        RebuildLayout();
+    }
+}
 
-    //Update uniforms
-    glUseProgram(Program_Text);
-    glUniform3fv(glGetUniformLocation(Program_Text, "TextColor"), 1, glm::value_ptr(m_color));
-    glUniformMatrix4fv(glGetUniformLocation(Program_Text, "ProjectionMat"), 1, GL_FALSE, glm::value_ptr(ProjectionMat));
-    glBindVertexArray(VAO_Text);
+/// <summary>
+/// Shape the whole string into glyph quads relative to the label's position (kerning, new lines and wrapping),
+/// and recalculate the width, height and bounds
+/// </summary>
+void TextLabel::RebuildLayout()
+{
+    m_dirty = false;
 
-    //Used for scroling text
-    glUniform2fv(glGetUniformLocation(Program_Text, "XCliping"), 1, glm::value_ptr(glm::vec2(0, 800)));
-    glUniform2fv(glGetUniformLocation(Program_Text, "CharacterSize"), 1, glm::value_ptr(m_pixelSize));
+    m_glyphs.clear();
 
-    glm::vec2 CharacterOrigin = m_position;
+    //Glyphs from an SDF font are at its own pixel size, not the label's
+    glm::vec2 Scale = m_scale * m_glyphScale;
+    float LineHeight = m_font->GetLineHeight() * Scale.y;
 
-    //Calc width and max height of text on screen
-    m_height = 0.0f;
+    //Get every glyph into the atlas in one go, before any texture coordinates are read
+    DecodeUTF8(m_text, m_codepoints);
+    m_font->Request(m_codepoints);
+    m_fontVersion = m_font->GetVersion();
+
+    m_glyphIndices.clear();
+    for (uint32_t _codepoint : m_codepoints) {
+        m_glyphIndices.push_back(m_font->GetGlyphIndex(_codepoint));
+    }
+
+    glm::vec2 CharacterOrigin = glm::vec2(0.0f, 0.0f);
+    GLuint PreviousIndex = 0;
+
+    //Where the current word starts, so it can be moved to the next line when wrapping
+    size_t WordStart = 0;
+    float WordStartX = 0.0f;
+    float WidthBeforeWord = 0.0f;
+
+    float TallestGlyph = 0.0f;
     m_width = 0.0f;
+    m_lineCount = 1;
+
+    //Make a quad for each character
+    for (uint32_t _codepoint : m_codepoints) {
+        if (_codepoint == '\n') {
+            if (CharacterOrigin.x > m_width) m_width = CharacterOrigin.x;
+
+            CharacterOrigin = glm::vec2(0.0f, CharacterOrigin.y - LineHeight);
+            PreviousIndex = 0;
+            WordStart = m_glyphs.size();
+            WordStartX = 0.0f;
+            m_lineCount++;
+            continue;
+        }
 
-    //Calc unscaled width and height
-    m_unscaledHeight = 0;
-    m_unscaledWidth = 0;
+        FontGlyph FontCharacter = m_font->GetGlyph(_codepoint);
 
-    //Used string to render each quad for each character onto screen
-    for (std::string::const_iterator TextCharacter = m_text.begin(); TextCharacter != m_text.end(); TextCharacter++) {
-        FontChar FontCharacter = CharacterMap[*TextCharacter];
-        GLfloat PosX = CharacterOrigin.x + FontCharacter.bearing.x * m_scale.x;
-        GLfloat PosY = CharacterOrigin.y - (FontCharacter.size.y - FontCharacter.bearing.y) * m_scale.y;
-        GLfloat Width = FontCharacter.size.x * m_scale.x;
-        GLfloat Height = FontCharacter.size.y * m_scale.y;
+        //Pull pairs like "AV" together
+        CharacterOrigin.x += m_font->GetKerning(PreviousIndex, FontCharacter.index) * Scale.x;
+        PreviousIndex = FontCharacter.index;
 
-        if (Height > m_height) m_height = Height;
-        if (FontCharacter.size.y > m_unscaledHeight) m_unscaledHeight = (float)FontCharacter.size.y;
+        if (_codepoint == ' ') {
+            WidthBeforeWord = CharacterOrigin.x;
+            CharacterOrigin.x += FontCharacter.advance * Scale.x;
 
-        GLfloat vertices[4][4] = {
-			{PosX, PosY + Height, 0.0, 0.0}, {PosX, PosY, 0.0, 1.0},
-			{PosX + Width, PosY, 1.0, 1.0}, {PosX + Width, PosY + Height, 1.0, 0.0}
-        };
+            WordStart = m_glyphs.size();
+            WordStartX = CharacterOrigin.x;
+            continue;
+        }
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_DynamicQuad);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        //Move the word so far down a line if this character goes past the wrap width
+        float Advance = FontCharacter.advance * Scale.x;
+        if (m_maxWidth > 0.0f && WordStartX > 0.0f && CharacterOrigin.x + Advance > m_maxWidth) {
+            if (WidthBeforeWord > m_width) m_width = WidthBeforeWord;
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, FontCharacter.textureID);
-        glUniform1i(glGetUniformLocation(Program_Text, "TextTexture"), 0);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            for (size_t i = WordStart; i < m_glyphs.size(); i++) {
+                m_glyphs[i].rect.x -= WordStartX;
+                m_glyphs[i].rect.y -= LineHeight;
+            }
 
-        CharacterOrigin.x += FontCharacter.advance * m_scale.x;
+            CharacterOrigin.x -= WordStartX;
+            CharacterOrigin.y -= LineHeight;
+            WordStartX = 0.0f;
+            m_lineCount++;
+        }
 
-        m_width += FontCharacter.advance * m_scale.x;
-        m_unscaledWidth += FontCharacter.advance;
-    }
+        GLfloat PosX = CharacterOrigin.x + FontCharacter.bearing.x * Scale.x;
+        GLfloat PosY = CharacterOrigin.y - (FontCharacter.size.y - FontCharacter.bearing.y) * Scale.y;
+        GLfloat Width = FontCharacter.size.x * Scale.x;
+        GLfloat Height = FontCharacter.size.y * Scale.y;
 
-    glUseProgram(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+        if (Height > TallestGlyph) TallestGlyph = Height;
 
-    glDisable(GL_BLEND);
+        //Spaces etc. have no quad
+        if (FontCharacter.size.x > 0 && FontCharacter.size.y > 0) {
+            TextGlyph glyph;
+            glyph.rect = glm::vec4(PosX, PosY, Width, Height);
+            glyph.uv = glm::vec4(FontCharacter.uvMin, FontCharacter.uvMax);
+            m_glyphs.push_back(glyph);
+        }
 
-    //Re enable depth testing if it was one previously
-    if (_copyOfDepthTest) glEnable(GL_DEPTH_TEST);
-}
+        CharacterOrigin.x += Advance;
+    }
 
-/// <summary>
-/// Update for text class every frame
-/// </summary>
-/// <param name="deltaTime"></param>
-/// <param name="currentTime"></param>
-void TextLabel::Update(float deltaTime, float currentTime)
-{
-    //Scales the text around it's center (even works while scrolling!)
-    if (m_bounceText) {
-        if (GetUnscaledWidth() > 0 && GetUnscaledHeight() > 0) {
-            glm::vec2 pos = GetCopyPos();
+    if (CharacterOrigin.x > m_width) m_width = CharacterOrigin.x;
+    m_height = TallestGlyph + (m_lineCount - 1) * LineHeight;
 
-            float width = GetUnscaledWidth() * GetCopyScale().x;
-            float height = GetUnscaledHeight() * GetCopyScale().y;
+    m_unscaledWidth = (m_scale.x != 0.0f ? m_width / m_scale.x : 0.0f);
+    m_unscaledHeight = (m_scale.y != 0.0f ? m_height / m_scale.y : 0.0f);
 
-            float sinVal = (((sin(currentTime - glm::half_pi<float>()) + 1) / 2)) + 1;
+    //Ink bounds
+    m_bounds = glm::vec4(0.0f);
+    for (size_t i = 0; i < m_glyphs.size(); i++) {
+        const glm::vec4& rect = m_glyphs[i].rect;
+        glm::vec4 bounds = glm::vec4(rect.x, rect.y, rect.x + rect.z, rect.y + rect.w);
 
-            SetScale(sinVal * GetCopyScale());
-            SetPosition(glm::vec2(pos.x + (width/2) - (float)(sinVal * width / 2), pos.y + (height/2) - (float)(sinVal * height / 2)));
+        if (i == 0) {
+            m_bounds = bounds;
+            continue;
         }
+
+        m_bounds = glm::vec4(glm::min(glm::vec2(m_bounds), glm::vec2(bounds)), glm::max(glm::vec2(m_bounds.z, m_bounds.w), glm::vec2(bounds.z, bounds.w)));
     }
+
+    //A glyph that failed to fit moved the others, lay out again next frame
+    if (m_font->GetVersion() != m_fontVersion) m_dirty = true;
 }
 
 std::string TextLabel::GetText()
@@ -196,29 +211,47 @@ std::string TextLabel::GetText()
     return m_text;
 }
 
-//Create font texture
-GLuint TextLabel::GenerateTexture(FT_Face _face)
+/// <summary>
+/// Split UTF-8 text into codepoints, invalid bytes become U+FFFD
+/// </summary>
+/// <param name="_text"></param>
+/// <param name="_codepoints"> cleared first</param>
+void TextLabel::DecodeUTF8(const std::string& _text, std::vector<uint32_t>& _codepoints)
 {
-    GLuint TextureID;
-    glGenTextures(1, &TextureID);
-    glBindTexture(GL_TEXTURE_2D, TextureID);
-
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RED,
-        _face->glyph->bitmap.width,
-        _face->glyph->bitmap.rows,
-        0,
-        GL_RED,
-        GL_UNSIGNED_BYTE,
-        _face->glyph->bitmap.buffer
-    );
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    return TextureID;
-}
\ No newline at end of file
+    const uint32_t replacement = 0xFFFD;
+    _codepoints.clear();
+
+    for (size_t i = 0; i < _text.size(); ) {
+        unsigned char lead = (unsigned char)_text[i];
+
+        int length = 0;
+        uint32_t codepoint = 0;
+
+        if (lead < 0x80) { length = 1; codepoint = lead; }
+        else if ((lead & 0xE0) == 0xC0) { length = 2; codepoint = lead & 0x1F; }
+        else if ((lead & 0xF0) == 0xE0) { length = 3; codepoint = lead & 0x0F; }
+        else if ((lead & 0xF8) == 0xF0) { length = 4; codepoint = lead & 0x07; }
+        else {
+            _codepoints.push_back(replacement);
+            i++;
+            continue;
+        }
+
+        //Continuation bytes must all be 10xxxxxx
+        bool valid = (i + length <= _text.size());
+        for (int j = 1; valid && j < length; j++) {
+            unsigned char next = (unsigned char)_text[i + j];
+            if ((next & 0xC0) != 0x80) valid = false;
+            else codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+
+        if (!valid) {
+            _codepoints.push_back(replacement);
+            i++;
+            continue;
+        }
+
+        _codepoints.push_back(codepoint);
+        i += length;
+    }
+}
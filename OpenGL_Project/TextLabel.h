@@ -18,61 +18,75 @@
 #include FT_FREETYPE_H
 
 #include <map>
+#include <vector>
 #include <string>
 #include <iostream>
 
 #include "ShaderLoader.h"
 
 #include "Utility.h"
+#include "CGLState.h"
+#include "CFontManager.h"
+#include "CTextBatcher.h"
 
 
 
 class TextLabel
 {
 private:
-	struct FontChar
-	{
-		GLuint textureID = 0;
-		glm::ivec2 size;
-		glm::ivec2 bearing;
-		GLuint advance = 0;
-	};
+	void RebuildLayout();
+	static void DecodeUTF8(const std::string& _text, std::vector<uint32_t>& _codepoints);
 
-	GLuint GenerateTexture(FT_Face _face);
-
-	static const int fontCharacterLimit = 128;
 	bool m_initialized = false;
 
+	//Glyphs need laying out again (text, scale or wrap width changed)
+	bool m_dirty = true;
+
 	std::string m_text;
-	glm::vec2 m_scale;
-	glm::vec3 m_color;
-	glm::vec2 m_position;
+	glm::vec2 m_scale = glm::vec2(1.0f, 1.0f);
+	glm::vec3 m_color = glm::vec3(1.0f, 1.0f, 1.0f);
+	glm::vec2 m_position = glm::vec2(0.0f, 0.0f);
 
-	glm::vec2 m_copyScale;
-	glm::vec2 m_copyPosition;
-	
+	//Lines wrap at spaces past this width (scaled pixels), 0 to only break at new lines
+	float m_maxWidth = 0.0f;
 
 	glm::vec2 m_pixelSize;
 
-	GLuint EBO_Text;
-	GLuint VAO_Text;
-	GLuint VBO_DynamicQuad;
-	GLuint Program_Text;
-	glm::mat4 ProjectionMat;
-	std::map<GLchar, FontChar> CharacterMap;
+	//Glyphs and atlas, shared with every label using the same font and size
+	CFont* m_font = nullptr;
+
+	//Size of the label's pixel size relative to the font's glyphs (not 1 for SDF fonts)
+	float m_glyphScale = 1.0f;
+
+	//Font version the glyphs were built with, glyphs may have moved in the atlas since
+	unsigned int m_fontVersion = 0;
+
+	//m_text decoded from UTF-8
+	std::vector<uint32_t> m_codepoints;
+
+	//Where each codepoint's glyph is in the font, marked as used every frame the label is drawn so it isn't evicted
+	std::vector<int> m_glyphIndices;
 
-	GLuint indices[6] = {
-		0,1,2,
-		0,2,3
-	};
+	//One quad per visible character relative to m_position, handed to the text batcher every frame
+	std::vector<TextGlyph> m_glyphs;
 
+	//Cached by the layout: widest line and height of all lines, with and without m_scale
 	float m_width = 0.0f;
 	float m_height = 0.0f;
 
 	float m_unscaledWidth = 0.0f;
 	float m_unscaledHeight = 0.0f;
+
+	int m_lineCount = 0;
+
+	//Ink bounds relative to m_position (min xy, max xy)
+	glm::vec4 m_bounds = glm::vec4(0.0f);
 	
+	//Animated on the GPU
 	bool m_bounceText = false;
+	bool m_scrollText = false;
+	glm::vec2 m_scrollClip = glm::vec2(0.0f, (float)utils::windowWidth);
+
 	bool m_alwaysDraw = true;
 
 public:
@@ -82,32 +96,35 @@ public:
 		glm::ivec2 _pixelSize,
 		glm::vec2 _pos,
 		glm::vec3 _color = glm::vec3(1.0f, 1.0f, 1.0f),
-		glm::vec2 _scale = glm::vec2(1.0f, 1.0f)
+		glm::vec2 _scale = glm::vec2(1.0f, 1.0f),
+		FontMode _mode = FontMode::Bitmap
 	);
 
 	~TextLabel();
 
 	void Render();
-	void Update(float deltaTime, float currentTime);
-	void SetText(std::string _text) { this->m_text = _text; };
+	void UpdateLayout();
+
+	void SetText(std::string _text) { if (_text != m_text) { this->m_text = _text; m_dirty = true; } };
 	void SetColor(glm::vec3 _color) { this->m_color = _color; };
-	void SetScale(glm::vec2 _scale) { this->m_scale = _scale; };
+	void SetScale(glm::vec2 _scale) { if (_scale != m_scale) { this->m_scale = _scale; m_dirty = true; } };
 	void SetPosition(glm::vec2 _pos) { this->m_position = _pos; };
-
-	void SetProgram(GLuint _program) { Program_Text = _program; };
+	void SetMaxWidth(float _width) { if (_width != m_maxWidth) { this->m_maxWidth = _width; m_dirty = true; } };
 
 	void SetBouncing(bool _doBounce) { m_bounceText = _doBounce; };
+	void SetScrolling(bool _doScroll, glm::vec2 _clip = glm::vec2(0.0f, (float)utils::windowWidth)) { m_scrollText = _doScroll; m_scrollClip = _clip; };
+
+	//Metrics lay the text out first if it changed, no draw needed
+	float GetWidth() { UpdateLayout(); return m_width; };
+	float GetHeight() { UpdateLayout(); return m_height; };
 
-	float GetWidth() { return m_width; };
-	float GetHeight() { return m_height; };
+	float GetUnscaledWidth() { UpdateLayout(); return m_unscaledWidth; };
+	float GetUnscaledHeight() { UpdateLayout(); return m_unscaledHeight; };
 
-	float GetUnscaledWidth() { return m_unscaledWidth; };
-	float GetUnscaledHeight() { return m_unscaledHeight; };
+	int GetLineCount() { UpdateLayout(); return m_lineCount; };
+	glm::vec4 GetBounds() { UpdateLayout(); return m_bounds; };
 
 	std::string GetText();
 	glm::vec2 GetPos() { return m_position; };
-	glm::vec2 GetCopyPos() { return m_copyPosition; };
-
-	glm::vec2 GetCopyScale() { return m_copyScale; };
 };
 
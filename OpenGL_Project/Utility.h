@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <atomic>
 
 namespace utils {
 	//Width and height of window
@@ -11,5 +12,8 @@ namespace utils {
 	extern float currentTime;
 	extern float deltaTime;
 	extern float previousTimeStep;
+
+	//Every heap allocation made by the program (counted by the global operator new)
+	extern std::atomic<size_t> allocationCount;
 }
 